@@ -178,6 +178,12 @@ time_t Connection_getLastAccessedTime(T C) {
 }
 
 
+void *Connection_getPool(T C) {
+        assert(C);
+        return C->parent;
+}
+
+
 /* ------------------------------------------------------------ Properties */
 
 
@@ -352,6 +358,55 @@ PreparedStatement_T Connection_prepareStatement(T C, const char *sql, ...) {
 }
 
 
+long long Connection_bulkLoad(T C, const char *table, const char *columns[], Connection_RowSource source, void *context, Connection_LoadStatistics *statistics) {
+        assert(C);
+        assert(table);
+        assert(columns && *columns);
+        assert(source);
+        if (! C->op->bulkLoad)
+                THROW(SQLException, "Bulk load is not supported by %s", C->op->name);
+        if (C->resultSet)
+                ResultSet_free(&C->resultSet);
+        Connection_LoadStatistics s = {};
+        bool success = C->op->bulkLoad(C->D, table, columns, source, context, &s);
+        if (statistics)
+                *statistics = s;
+        if (! success)
+                THROW(SQLException, "%s", Connection_getLastError(C));
+        return s.loaded;
+}
+
+
+int Connection_readBlob(T C, const char *table, const char *column, long long rowId, int offset, void *buffer, int size) {
+        assert(C);
+        assert(table);
+        assert(column);
+        assert(buffer);
+        assert(offset >= 0);
+        assert(size > 0);
+        if (! C->op->readBlob)
+                THROW(SQLException, "Blob I/O is not supported by %s", C->op->name);
+        int n = C->op->readBlob(C->D, table, column, rowId, offset, buffer, size);
+        if (n < 0)
+                THROW(SQLException, "%s", Connection_getLastError(C));
+        return n;
+}
+
+
+void Connection_writeBlob(T C, const char *table, const char *column, long long rowId, int offset, const void *buffer, int size) {
+        assert(C);
+        assert(table);
+        assert(column);
+        assert(buffer);
+        assert(offset >= 0);
+        assert(size >= 0);
+        if (! C->op->writeBlob)
+                THROW(SQLException, "Blob I/O is not supported by %s", C->op->name);
+        if (! C->op->writeBlob(C->D, table, column, rowId, offset, buffer, size))
+                THROW(SQLException, "%s", Connection_getLastError(C));
+}
+
+
 const char *Connection_getLastError(T C) {
         assert(C);
         const char *s = C->op->getLastError(C->D);
@@ -194,6 +194,37 @@ typedef enum {
 } TRANSACTION_TYPE;
 
 
+/**
+ * @brief Row source callback used by Connection_bulkLoad().
+ *
+ * The callback is called once for each row to load. It should assign the
+ * value of each column in the row to `values` as a string and may set the
+ * byte length of a value in `lengths`. A length of -1 (the default) means
+ * the value is NUL terminated. A NULL value is loaded as SQL NULL. The
+ * arrays have the same number of elements as the columns given to
+ * Connection_bulkLoad() and values are only read until the next call.
+ *
+ * @param context The context given to Connection_bulkLoad()
+ * @param values Output array for column values
+ * @param lengths Output array for column value lengths
+ * @return true if a row was produced, false when there are no more rows
+ */
+typedef bool (*Connection_RowSource)(void *context, const char **values, int *lengths);
+
+
+/**
+ * Statistics for a bulk load done by Connection_bulkLoad()
+ */
+typedef struct Connection_LoadStatistics {
+        long long rows;     /**< Number of rows produced by the row source */
+        long long bytes;    /**< Number of bytes streamed to the server */
+        long long loaded;   /**< Number of rows inserted */
+        long long skipped;  /**< Number of rows skipped by the server, e.g. duplicate keys */
+        long long warnings; /**< Number of warnings reported by the server */
+        long long elapsed;  /**< Time used for the load in milliseconds */
+} Connection_LoadStatistics;
+
+
 //<< Protected methods
 
 /**
@@ -241,6 +272,14 @@ bool Connection_isAvailable(T C) __attribute__ ((visibility("hidden")));
 time_t Connection_getLastAccessedTime(T C) __attribute__ ((visibility("hidden")));
 
 
+/**
+ * @brief Gets the ConnectionPool this Connection belongs to.
+ * @param C A Connection object
+ * @return The parent ConnectionPool_T of this Connection
+ */
+void *Connection_getPool(T C) __attribute__ ((visibility("hidden")));
+
+
 //>> End Protected methods
 
 /// @name Properties
@@ -253,6 +292,13 @@ time_t Connection_getLastAccessedTime(T C) __attribute__ ((visibility("hidden"))
  * error. The timeout is set per connection/session. Not all database
  * systems support query (SELECT) timeout. The default is no query timeout.
  *
+ * With *SQLite* the timeout limits both the time spent waiting for a
+ * database lock and the execution time of each call which runs SQL, such
+ * as Connection_execute(), PreparedStatement_execute() or ResultSet_next().
+ * A statement running past the timeout is interrupted and an SQLException
+ * with a message starting with "Query timeout" is thrown. The connection
+ * can be used again afterwards.
+ *
  * @param C A Connection object
  * @param ms The query timeout in milliseconds; zero (the default) means there
  * is no timeout limit.
@@ -552,6 +598,122 @@ ResultSet_T Connection_executeQuery(T C, const char *sql, ...) __attribute__((fo
 PreparedStatement_T Connection_prepareStatement(T C, const char *sql, ...) __attribute__((format (printf, 2, 3)));
 
 
+/**
+ * @brief Bulk load rows into a table.
+ *
+ * Rows produced by the `source` callback are streamed directly to the
+ * database server in one operation, without going through a temporary
+ * file. This is much faster than executing an INSERT statement per
+ * row and should be used for large imports. Values are sent as text and
+ * converted to the column type by the server.
+ *
+ * Only MySQL supports bulk loading, where it is implemented with
+ * `LOAD DATA LOCAL INFILE`. The URL property `local-infile=true` must
+ * be set for the Connection, and the server must allow local infile.
+ *
+ * Example:
+ * @code
+ * static bool nextRow(void *context, const char **values, int *lengths) {
+ *      Vector_T rows = context; // An application defined row source
+ *      ..
+ *      values[0] = id;
+ *      values[1] = name;
+ *      return true;
+ * }
+ * ..
+ * Connection_LoadStatistics statistics;
+ * const char *columns[] = {"id", "name", NULL};
+ * Connection_bulkLoad(con, "employees", columns, nextRow, rows, &statistics);
+ * printf("Loaded %lld rows in %lld ms\n", statistics.loaded, statistics.elapsed);
+ * @endcode
+ *
+ * @param C A Connection object
+ * @param table The name of the table to load rows into
+ * @param columns A NULL terminated array of column names to load values
+ * into. Each row produced by `source` must have this number of columns
+ * @param source A callback producing the rows to load
+ * @param context An application defined context passed to `source`
+ * @param statistics If not NULL, statistics about the load are stored here
+ * @return The number of rows inserted
+ * @exception SQLException If a database error occurs, if the row source
+ * throws an exception or if bulk load is not supported by the database
+ * @see SQLException.h
+ */
+long long Connection_bulkLoad(T C, const char *table, const char *columns[], Connection_RowSource source, void *context, Connection_LoadStatistics *statistics);
+
+
+/**
+ * @brief Read part of a blob value stored in a table.
+ *
+ * Reads up to `size` bytes at `offset` from the blob in `column` of the
+ * row with `rowId` in `table`, directly from the database without running
+ * a query. Large values can be read piece by piece with bounded memory.
+ *
+ * Only SQLite supports this, where it is implemented with incremental
+ * blob I/O and `rowId` is the row's rowid.
+ *
+ * Example:
+ * @code
+ * char buffer[65536];
+ * int n, offset = 0;
+ * while ((n = Connection_readBlob(con, "files", "data", id, offset, buffer, sizeof(buffer))) > 0) {
+ *      fwrite(buffer, 1, n, file);
+ *      offset += n;
+ * }
+ * @endcode
+ *
+ * @param C A Connection object
+ * @param table The table name
+ * @param column The blob column name
+ * @param rowId The row to read from
+ * @param offset Offset in bytes into the blob value
+ * @param buffer The buffer to read into
+ * @param size The size of buffer in bytes
+ * @return The number of bytes read, 0 if offset is at or past the end of the value
+ * @exception SQLException If the row does not exist, if a database error
+ * occurs or if blob I/O is not supported by the database
+ * @see SQLException.h
+ */
+int Connection_readBlob(T C, const char *table, const char *column, long long rowId, int offset, void *buffer, int size);
+
+
+/**
+ * @brief Write part of a blob value stored in a table.
+ *
+ * Writes `size` bytes at `offset` into the blob in `column` of the row
+ * with `rowId` in `table`. The size of a blob cannot be changed, so the
+ * value must first be created with the full size, e.g. with
+ * PreparedStatement_setZeroBlob(), and then written piece by piece.
+ *
+ * Only SQLite supports this, where it is implemented with incremental
+ * blob I/O and `rowId` is the row's rowid. Outside a transaction each
+ * write is committed by itself.
+ *
+ * Example:
+ * @code
+ * PreparedStatement_T p = Connection_prepareStatement(con, "insert into files(data) values(?);");
+ * PreparedStatement_setZeroBlob(p, 1, size);
+ * PreparedStatement_execute(p);
+ * long long id = Connection_lastRowId(con);
+ * for (int offset = 0, n; (n = fread(buffer, 1, sizeof(buffer), file)) > 0; offset += n)
+ *      Connection_writeBlob(con, "files", "data", id, offset, buffer, n);
+ * @endcode
+ *
+ * @param C A Connection object
+ * @param table The table name
+ * @param column The blob column name
+ * @param rowId The row to write to
+ * @param offset Offset in bytes into the blob value
+ * @param buffer The bytes to write
+ * @param size The number of bytes to write
+ * @exception SQLException If the row does not exist, if the write is past
+ * the end of the value, if a database error occurs or if blob I/O is not
+ * supported by the database
+ * @see SQLException.h
+ */
+void Connection_writeBlob(T C, const char *table, const char *column, long long rowId, int offset, const void *buffer, int size);
+
+
 /**
  * @brief Gets the last SQL error message.
  *
@@ -52,6 +52,9 @@ typedef struct Cop_T {
         bool (*execute)(T C, const char *sql, va_list ap);
         ResultSet_T (*executeQuery)(T C, const char *sql, va_list ap);
         PreparedStatement_T (*prepareStatement)(T C, const char *sql, va_list ap);
+        bool (*bulkLoad)(T C, const char *table, const char **columns, Connection_RowSource source, void *context, Connection_LoadStatistics *statistics);
+        int (*readBlob)(T C, const char *table, const char *column, long long rowId, int offset, void *buffer, int size);
+        bool (*writeBlob)(T C, const char *table, const char *column, long long rowId, int offset, const void *buffer, int size);
         const char *(*getLastError)(T C);
 } *Cop_T;
 
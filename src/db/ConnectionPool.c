@@ -27,6 +27,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdatomic.h>
 
 #include "URL.h"
 #include "Thread.h"
@@ -71,6 +72,17 @@ struct ConnectionPool_S {
         int connectionTimeout;
         int initialConnections;
         ConnectionPool_Type type;
+        Mutex_T sharedMutex;
+        void *sharedState;
+        void (*sharedStateFree)(void *state);
+        ConnectionPool_Statistics statistics;
+        // Not under mutex, connections may wait for a lock while the pool holds it
+        atomic_llong lockWaits;
+        atomic_llong lockWaitTime;
+        atomic_llong lockTimeouts;
+        Vector_T functions;
+        // Set and read without the mutex, it may change while connections report profiles
+        void (* _Atomic profiler)(const ConnectionPool_Profile *profile);
 };
 
 int ZBDEBUG = false;
@@ -110,6 +122,18 @@ static void _drainPool(T P) {
 }
 
 
+static void _freeSharedState(T P) {
+        LOCK(P->sharedMutex)
+        {
+                if (P->sharedState) {
+                        P->sharedStateFree(P->sharedState);
+                        P->sharedState = NULL;
+                }
+        }
+        END_LOCK;
+}
+
+
 static bool _fillPool(T P) {
         for (int i = 0; i < P->initialConnections; i++) {
                 Connection_T con = Connection_new(P, &P->error);
@@ -273,11 +297,13 @@ T ConnectionPool_new(URL_T url) {
         P->url = url;
         Sem_init(P->alarm);
         Mutex_init(P->mutex);
+        Mutex_init(P->sharedMutex);
         P->doSweep = true;
         P->type = _getType(P);
         P->sweepInterval = SQL_DEFAULT_SWEEP_INTERVAL;
         P->maxConnections = SQL_DEFAULT_MAX_CONNECTIONS;
         P->pool = Vector_new(SQL_DEFAULT_MAX_CONNECTIONS);
+        P->functions = Vector_new(4);
         P->initialConnections = SQL_DEFAULT_INIT_CONNECTIONS;
         P->connectionTimeout = SQL_DEFAULT_CONNECTION_TIMEOUT;
         return P;
@@ -291,13 +317,86 @@ void ConnectionPool_free(T *P) {
         if (! (*P)->stopped)
                 ConnectionPool_stop((*P));
         Vector_free(&pool);
+        while (! Vector_isEmpty((*P)->functions)) {
+                ConnectionPool_Function *function = Vector_pop((*P)->functions);
+                char *name = (char *)function->name;
+                FREE(name);
+                FREE(function);
+        }
+        Vector_free(&(*P)->functions);
         Mutex_destroy((*P)->mutex);
+        Mutex_destroy((*P)->sharedMutex);
         Sem_destroy((*P)->alarm);
         FREE((*P)->error);
         FREE(*P);
 }
 
 
+/* ----------------------------------------------------- Protected methods */
+
+
+void *ConnectionPool_getSharedState(T P, void *(*create)(T P, char **error), void (*destroy)(void *state), char **error) {
+        assert(P);
+        assert(create);
+        assert(destroy);
+        void *state;
+        // Not P->mutex, connections are also created while the pool holds that lock
+        LOCK(P->sharedMutex)
+        {
+                if (! P->sharedState) {
+                        P->sharedState = create(P, error);
+                        P->sharedStateFree = destroy;
+                }
+                state = P->sharedState;
+        }
+        END_LOCK;
+        return state;
+}
+
+
+void ConnectionPool_setStatistics(T P, const ConnectionPool_Statistics *statistics) {
+        assert(P);
+        assert(statistics);
+        LOCK(P->mutex)
+        {
+                P->statistics = *statistics;
+        }
+        END_LOCK;
+}
+
+
+void ConnectionPool_addLockWaits(T P, int waits, long long milliseconds, int timeouts) {
+        assert(P);
+        if (waits)
+                atomic_fetch_add(&P->lockWaits, waits);
+        if (milliseconds)
+                atomic_fetch_add(&P->lockWaitTime, milliseconds);
+        if (timeouts)
+                atomic_fetch_add(&P->lockTimeouts, timeouts);
+}
+
+
+const ConnectionPool_Function *ConnectionPool_getFunction(T P, int index) {
+        assert(P);
+        return index < Vector_size(P->functions) ? Vector_get(P->functions, index) : NULL;
+}
+
+
+bool ConnectionPool_isProfiling(T P) {
+        assert(P);
+        return atomic_load(&P->profiler) != NULL;
+}
+
+
+void ConnectionPool_profile(T P, const ConnectionPool_Profile *profile) {
+        assert(P);
+        assert(profile);
+        void (*profiler)(const ConnectionPool_Profile *profile) = atomic_load(&P->profiler);
+        if (profiler)
+                profiler(profile);
+}
+
+
 /* ------------------------------------------------------------ Properties */
 
 
@@ -366,6 +465,34 @@ void ConnectionPool_setAbortHandler(T P, void(*abortHandler)(const char *error))
 }
 
 
+void ConnectionPool_addFunction(T P, const ConnectionPool_Function *function) {
+        assert(P);
+        assert(function);
+        assert(function->name);
+        bool filled;
+        LOCK(P->mutex)
+        {
+                filled = P->filled;
+                if (! filled) {
+                        ConnectionPool_Function *f;
+                        NEW(f);
+                        *f = *function;
+                        f->name = Str_dup(function->name);
+                        Vector_push(P->functions, f);
+                }
+        }
+        END_LOCK;
+        if (filled)
+                THROW(SQLException, "Functions must be added before the pool is started");
+}
+
+
+void ConnectionPool_setProfiler(T P, void (*profiler)(const ConnectionPool_Profile *profile)) {
+        assert(P);
+        atomic_store(&P->profiler, profiler);
+}
+
+
 void ConnectionPool_setReaper(T P, int sweepInterval) {
         assert(P);
         LOCK(P->mutex)
@@ -423,6 +550,7 @@ void ConnectionPool_stop(T P) {
                 Sem_signal(P->alarm);
                 Thread_join(P->reaper);
         }
+        _freeSharedState(P);
 }
 
 
@@ -504,6 +632,20 @@ bool ConnectionPool_isFull(T P) {
 }
 
 
+void ConnectionPool_getStatistics(T P, ConnectionPool_Statistics *statistics) {
+        assert(P);
+        assert(statistics);
+        LOCK(P->mutex)
+        {
+                *statistics = P->statistics;
+        }
+        END_LOCK;
+        statistics->lockWaits = atomic_load(&P->lockWaits);
+        statistics->lockWaitTime = atomic_load(&P->lockWaitTime);
+        statistics->lockTimeouts = atomic_load(&P->lockTimeouts);
+}
+
+
 /* --------------------------------------------------------- Class methods */
 
 
@@ -123,6 +123,36 @@
  *   Using shared cache can significantly reduce database lock errors in
  *   some scenarios where two or more connections might write to the database.
  *   It is also recommended to build libsqlite and libzdb with unlock  notify.
+ * - `write-queue=true` - Serialize all writes through one writer connection
+ *   owned by the pool. Writes from all connections are queued and executed
+ *   by a writer thread which commits pending writes together in one
+ *   transaction. The pooled connections only read, using WAL mode, and
+ *   never wait for the write lock. A transaction started with
+ *   Connection_beginTransaction() runs on the writer connection and holds
+ *   it until commit or rollback, writes from other connections wait in the
+ *   queue meanwhile.
+ * - `maintenance=<seconds>` - Run a maintenance thread which checkpoints
+ *   the WAL at this interval instead of the connection which commits, as
+ *   SQLite does by default. Use with `journal_mode=wal`. Checkpoints are
+ *   passive and never wait for other connections. When no connection is in
+ *   use, a WAL which has grown past `wal_autocheckpoint` pages is truncated
+ *   and `PRAGMA optimize` and `PRAGMA incremental_vacuum` are run if the
+ *   database changed. Checkpoint duration and WAL size are available from
+ *   ConnectionPool_getStatistics().
+ * - `memory-replica=true` - Load the database file into memory when the
+ *   pool starts and let connections read from this in-memory replica,
+ *   avoiding disk I/O. Connections are read-only, unless `write-queue=true`
+ *   is also used, then writes go to the file through the write queue. With
+ *   `replica-refresh=<seconds>` the file is checked at this interval and
+ *   loaded again if it was changed. Readers wait while the new image is
+ *   copied in. Requires SQLite 3.36 or later.
+ * - `result-cache=<entries>` - Cache the results of up to this many
+ *   read-only queries run with Connection_executeQuery() per connection.
+ *   A cached result is returned only if the database has not changed
+ *   since it was read, as reported by `PRAGMA data_version`, so results
+ *   are never stale. Results larger than 1MB are not cached. Do not use
+ *   with queries calling non-deterministic functions such as `random()`
+ *   or `datetime('now')`.
  *
  * A URL for connecting to a SQLite database might look like this (with recommended pragmas):
  *
@@ -130,6 +160,14 @@
  * sqlite:///var/sqlite/test.db?synchronous=normal&foreign_keys=on&journal_mode=wal&temp_store=memory
  * ```
  *
+ * The special database name `:memory:` gives an in-memory database shared
+ * by all connections in the pool. The database exists until the pool is
+ * stopped. Requires SQLite 3.36 or later.
+ *
+ * ```
+ * sqlite:///:memory:?foreign_keys=on
+ * ```
+ *
  * ### PostgreSQL:
  *
  * The URL for connecting to a [PostgreSQL](http://www.postgresql.org/)
@@ -265,12 +303,168 @@ typedef enum {
         ConnectionPool_Oracle      /**< Oracle database connection */
 } ConnectionPool_Type;
 
+/**
+ * @brief Database maintenance and lock contention statistics for a ConnectionPool
+ *
+ * Maintenance is done by the database driver in the background. Currently
+ * only SQLite with the URL properties `maintenance` or `memory-replica`
+ * collects these. Lock waits are counted by SQLite connections which wait
+ * for a database lock held by another connection.
+ * @see ConnectionPool_getStatistics()
+ */
+typedef struct ConnectionPool_Statistics {
+        long long checkpoints;       /**< Number of WAL checkpoints run */
+        long long checkpointTime;    /**< Duration of the last checkpoint in milliseconds */
+        long long checkpointMaxTime; /**< Duration of the longest checkpoint in milliseconds */
+        long long walFrames;         /**< Number of frames in the WAL after the last checkpoint */
+        long long walSize;           /**< Size of the WAL in bytes after the last checkpoint */
+        long long optimizations;     /**< Number of times the query planner statistics were updated */
+        long long vacuumed;          /**< Number of free pages released by incremental vacuum */
+        long long refreshes;         /**< Number of times an in-memory replica was loaded */
+        long long lockWaits;         /**< Number of times a connection waited for a database lock */
+        long long lockWaitTime;      /**< Total time connections waited for a database lock in milliseconds */
+        long long lockTimeouts;      /**< Number of lock waits which timed out with a busy error */
+} ConnectionPool_Statistics;
+
+struct sqlite3_context;
+struct sqlite3_value;
+
+/**
+ * @brief A native SQL function added with ConnectionPool_addFunction()
+ *
+ * The callbacks use the [SQLite function API](https://www.sqlite.org/c3ref/create_function.html),
+ * include sqlite3.h to implement them. Set `function` for a scalar function,
+ * `step` and `final` for an aggregate function and in addition `value` and
+ * `inverse` for an aggregate window function.
+ */
+typedef struct ConnectionPool_Function {
+        const char *name; /**< Name of the function in SQL */
+        int arguments;    /**< Number of arguments or -1 for any number */
+        int flags;        /**< SQLite flags such as SQLITE_DETERMINISTIC. Text encoding defaults to SQLITE_UTF8 */
+        void *context;    /**< Application data, available from sqlite3_user_data() */
+        void (*function)(struct sqlite3_context *context, int argc, struct sqlite3_value **argv); /**< Scalar function */
+        void (*step)(struct sqlite3_context *context, int argc, struct sqlite3_value **argv);     /**< Add a row to an aggregate */
+        void (*final)(struct sqlite3_context *context);                                         /**< Return the aggregate result */
+        void (*value)(struct sqlite3_context *context);                                         /**< Return the current window result */
+        void (*inverse)(struct sqlite3_context *context, int argc, struct sqlite3_value **argv);  /**< Remove a row from a window */
+} ConnectionPool_Function;
+
+/**
+ * @brief A loop in the query plan of a profiled statement
+ *
+ * Available if SQLite was compiled with `SQLITE_ENABLE_STMT_SCANSTATUS`.
+ * @see ConnectionPool_Profile
+ */
+typedef struct ConnectionPool_Scan {
+        const char *name;    /**< Name of the table or index scanned */
+        const char *explain; /**< Query plan description of the loop */
+        long long loops;     /**< Number of times the loop was run */
+        long long rows;      /**< Number of rows visited by the loop */
+        double estimate;     /**< Rows per loop estimated by the query planner */
+} ConnectionPool_Scan;
+
+/**
+ * @brief Execution counters of a query passed to the profiler set with
+ * ConnectionPool_setProfiler()
+ *
+ * Counters cover one execution, from the query until its ResultSet was
+ * closed. Full scan steps and automatic indexes point to a query that
+ * needs an index. A query answered from the SQLite result cache is
+ * reported with `cached` set, only `sql` and `rows` are set since the
+ * query was not executed. The execution which stored the result in the
+ * cache is reported as any other.
+ */
+typedef struct ConnectionPool_Profile {
+        const char *sql;                 /**< The SQL statement, with parameter markers for a PreparedStatement */
+        long long rows;                  /**< Number of rows read from the ResultSet */
+        long long fullscanSteps;         /**< Number of forward steps in a full table scan */
+        long long sorts;                 /**< Number of sort operations */
+        long long autoindexes;           /**< Number of rows inserted into automatic indexes */
+        long long vmSteps;               /**< Number of virtual machine operations */
+        int scanCount;                   /**< Number of elements in scans */
+        const ConnectionPool_Scan *scans; /**< Query plan loops or NULL if not available */
+        bool cached;                     /**< True if the rows were read from the result cache */
+} ConnectionPool_Profile;
+
 /**
  * Library Debug flag. If set to true, emit debug output
  */
 extern int ZBDEBUG;
 
 
+//<< Protected methods
+
+/**
+ * @brief Get database driver state shared by all connections in the pool.
+ *
+ * The state is created with `create` on first use and released with
+ * `destroy` when the pool is stopped, after all connections are closed.
+ * A driver uses this for resources that are per pool rather than per
+ * connection, such as a client-side session pool.
+ *
+ * @param P A ConnectionPool object
+ * @param create Create the shared state or return NULL and set error
+ * @param destroy Release the shared state
+ * @param error Set to an error message allocated with Str_dup if create failed
+ * @return The shared state or NULL if create failed
+ */
+void *ConnectionPool_getSharedState(T P, void *(*create)(T P, char **error), void (*destroy)(void *state), char **error) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * @brief Publish database maintenance statistics for the pool.
+ *
+ * Called by a database driver doing maintenance in the background. The
+ * statistics are copied and returned by ConnectionPool_getStatistics().
+ *
+ * @param P A ConnectionPool object
+ * @param statistics The current statistics
+ */
+void ConnectionPool_setStatistics(T P, const ConnectionPool_Statistics *statistics) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * @brief Count database lock waits of a connection in the pool.
+ *
+ * Called by a database driver while a connection waits for a lock, also
+ * while the pool creates a connection. The lock wait counters are kept
+ * apart from the statistics set with ConnectionPool_setStatistics().
+ *
+ * @param P A ConnectionPool object
+ * @param waits Number of new lock waits
+ * @param milliseconds Time waited
+ * @param timeouts Number of lock waits which timed out
+ */
+void ConnectionPool_addLockWaits(T P, int waits, long long milliseconds, int timeouts) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * @brief Get a native SQL function added to the pool.
+ * @param P A ConnectionPool object
+ * @param index The first function is 0, the second is 1, ...
+ * @return The function or NULL if index is past the last function
+ */
+const ConnectionPool_Function *ConnectionPool_getFunction(T P, int index) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * @brief Check if a profiler was set for the pool.
+ * @param P A ConnectionPool object
+ * @return true if query profiles should be collected, otherwise false
+ */
+bool ConnectionPool_isProfiling(T P) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * @brief Report a query profile to the profiler set for the pool.
+ * @param P A ConnectionPool object
+ * @param profile The query profile
+ */
+void ConnectionPool_profile(T P, const ConnectionPool_Profile *profile) __attribute__ ((visibility("hidden")));
+
+//>> End Protected methods
+
+
 /**
  * @brief Create a new ConnectionPool.
  *
@@ -427,6 +621,65 @@ void ConnectionPool_setAbortHandler(T P, void(*abortHandler)(const char *error))
  */
 void ConnectionPool_setReaper(T P, int sweepInterval);
 
+
+/**
+ * @brief Add a native SQL function to all connections in the pool.
+ *
+ * Registers a C scalar, aggregate or window function with each connection
+ * the pool creates, so filtering and aggregation which cannot be expressed
+ * in SQL runs inside the query instead of on rows fetched by the client.
+ * The function is copied and must be added *before* calling
+ * ConnectionPool_start(). Only SQLite supports native functions, other
+ * databases ignore them.
+ *
+ * Example:
+ * ```c
+ * static void _rot13(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+ *         ..
+ *         sqlite3_result_text(ctx, result, -1, SQLITE_TRANSIENT);
+ * }
+ * ..
+ * ConnectionPool_addFunction(pool, &(ConnectionPool_Function){.name = "rot13", .arguments = 1, .flags = SQLITE_DETERMINISTIC, .function = _rot13});
+ * ConnectionPool_start(pool);
+ * ```
+ *
+ * @param P A ConnectionPool object
+ * @param function The function to add
+ * @exception SQLException If called after ConnectionPool_start()
+ * @see Connection.h
+ */
+void ConnectionPool_addFunction(T P, const ConnectionPool_Function *function);
+
+
+/**
+ * @brief Set a function to receive execution counters for each query.
+ *
+ * When set, a profile of a query is collected and passed to `profiler`
+ * when its ResultSet is closed. The profile tells which queries do full
+ * table scans, sorts or build automatic indexes and are candidates for an
+ * index, without attaching a profiler to the application. The profile
+ * is only valid during the call. The function is called from the thread
+ * using the Connection and must not use the Connection or throw an
+ * exception. Collecting profiles adds some overhead to each query, set
+ * `profiler` to NULL to stop. Currently only SQLite collects query
+ * profiles.
+ *
+ * Example:
+ * ```c
+ * static void _profiler(const ConnectionPool_Profile *profile) {
+ *         if (profile->fullscanSteps > 1000 || profile->autoindexes > 0)
+ *                 printf("Consider an index for: %s\n", profile->sql);
+ * }
+ * ..
+ * ConnectionPool_setProfiler(pool, _profiler);
+ * ```
+ *
+ * @param P A ConnectionPool object
+ * @param profiler The function to call with a query profile or NULL
+ * @see ConnectionPool_Profile
+ */
+void ConnectionPool_setProfiler(T P, void (*profiler)(const ConnectionPool_Profile *profile));
+
 /// @}
 /// @name Functions
 /// @{
@@ -601,6 +854,21 @@ int ConnectionPool_active(T P);
  */
 bool ConnectionPool_isFull(T P);
 
+
+/**
+ * @brief Gets database maintenance and lock contention statistics for the pool.
+ *
+ * Statistics are collected by the database driver when it does maintenance
+ * in the background, such as WAL checkpoints with the SQLite URL property
+ * `maintenance`. All values are zero if no maintenance is done. SQLite
+ * connections also count how often and how long they waited for a lock
+ * held by another connection, which shows write contention.
+ *
+ * @param P A ConnectionPool object
+ * @param statistics Set to the current statistics
+ */
+void ConnectionPool_getStatistics(T P, ConnectionPool_Statistics *statistics);
+
 /// @}
 /// @name Class functions
 /// @{
@@ -0,0 +1,581 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#include "Config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+
+#include "ResultSet.h"
+#include "system/Time.h"
+
+
+/**
+ * Implementation of the ResultSet/Delegate interface for a materialized
+ * ResultSet, created by ResultSet_materialize().
+ *
+ * The rows are read through the getters of the source ResultSet into an
+ * arena which is one allocation: a header, the offsets of the column names,
+ * a table of cells row by row and the packed values. A cell has the offset
+ * and size of its value and the native value of an integer or real. Values
+ * are stored as returned by the source and NUL terminated so the getters
+ * return pointers into the arena. The arena does not change once built and
+ * is shared, with a reference count, by each ResultSet reading it.
+ *
+ * If the memory used for rows exceeds the memory limit of the source, set
+ * with ResultSet_setMemoryLimit(), all rows are moved to an unlinked
+ * temporary file and the remaining rows are written there. The file is
+ * mapped into memory when complete and only a table of row offsets and the
+ * column names are kept in the arena. A row in the file is for each column
+ * a type byte, a 32-bit size, -1 if NULL, the native value of an integer or
+ * real and the NUL terminated value. A cursor decodes the cells of its
+ * current row so reading the file is transparent to the getters.
+ *
+ * @file
+ */
+
+
+/* ----------------------------------------------------------- Definitions */
+
+
+typedef struct cell_t {
+        int type;
+        int size; // -1 if NULL
+        size_t offset;
+        union {
+                long long i;
+                double d;
+        } value;
+} cell_t;
+
+typedef struct arena_t {
+        atomic_int refs;
+        int rows;
+        int columns;
+        size_t *names;
+        cell_t *cells;
+        size_t *offsets; // Row offsets in map if spilled, cells is then NULL
+        char *data;
+        const char *map;
+        size_t mapSize;
+} *arena_t;
+
+typedef struct builder_t {
+        int rows;
+        int allocated;
+        int columns;
+        long long limit;
+        size_t *names;
+        size_t namesLength;
+        cell_t *cells;
+        char *data;
+        size_t length;
+        size_t capacity;
+        FILE *file;
+        size_t fileSize;
+        const char *map; // Until it is moved to the arena
+        size_t *offsets;
+        int allocatedOffsets;
+} *builder_t;
+
+#define T ResultSetDelegate_T
+struct T {
+        int row;
+        arena_t arena;
+        const char *base;
+        cell_t *cells;
+        const cell_t *current;
+};
+
+
+/* ------------------------------------------------------- Private methods */
+
+
+static size_t _append(builder_t b, const void *value, int size) {
+        size_t offset = b->length;
+        if (b->length + size + 1 > b->capacity) {
+                b->capacity = (b->length + size + 1) * 2;
+                if (b->data)
+                        RESIZE(b->data, (long)b->capacity);
+                else
+                        b->data = ALLOC((long)b->capacity);
+        }
+        if (size > 0)
+                memcpy(b->data + b->length, value, size);
+        b->data[b->length + size] = 0;
+        b->length += size + 1;
+        return offset;
+}
+
+
+// A number the getter cannot convert, such as a BIGINT UNSIGNED above LLONG_MAX, is kept as text
+static void _readNumber(ResultSet_T R, int columnIndex, cell_t *cell) {
+        TRY
+        {
+                if (cell->type == ResultSet_Integer)
+                        cell->value.i = ResultSet_getLLong(R, columnIndex);
+                else
+                        cell->value.d = ResultSet_getDouble(R, columnIndex);
+        }
+        CATCH(SQLException)
+        {
+                cell->type = ResultSet_Text;
+        }
+        END_TRY;
+}
+
+
+static void _readCell(builder_t b, ResultSet_T R, int columnIndex, cell_t *cell) {
+        const void *value;
+        *cell = (cell_t){.type = ResultSet_getColumnType(R, columnIndex)};
+        if (ResultSet_isnull(R, columnIndex)) {
+                cell->size = -1;
+                return;
+        }
+        switch (cell->type) {
+                case ResultSet_Integer:
+                case ResultSet_Real:
+                        _readNumber(R, columnIndex, cell);
+                        value = ResultSet_getSString(R, columnIndex, &cell->size);
+                        break;
+                case ResultSet_Blob:
+                        value = ResultSet_getBlob(R, columnIndex, &cell->size);
+                        break;
+                default:
+                        value = ResultSet_getSString(R, columnIndex, &cell->size);
+                        break;
+        }
+        cell->offset = _append(b, value, cell->size);
+}
+
+
+static inline bool _isNumber(int type) {
+        return type == ResultSet_Integer || type == ResultSet_Real;
+}
+
+
+static void _write(builder_t b, const void *bytes, size_t size) {
+        if (fwrite(bytes, 1, size, b->file) != size)
+                THROW(SQLException, "Failed to write temporary file -- %s", System_getLastError());
+        b->fileSize += size;
+}
+
+
+static void _writeRow(builder_t b, int row, const cell_t *cells) {
+        if (row == b->allocatedOffsets) {
+                b->allocatedOffsets = b->allocatedOffsets ? b->allocatedOffsets * 2 : 1024;
+                if (b->offsets)
+                        RESIZE(b->offsets, (long)b->allocatedOffsets * sizeof(size_t));
+                else
+                        b->offsets = ALLOC((long)b->allocatedOffsets * sizeof(size_t));
+        }
+        b->offsets[row] = b->fileSize;
+        for (int i = 0; i < b->columns; i++) {
+                unsigned char type = cells[i].type;
+                int32_t size = cells[i].size;
+                _write(b, &type, 1);
+                _write(b, &size, sizeof(size));
+                if (size >= 0) {
+                        if (_isNumber(type))
+                                _write(b, &cells[i].value, sizeof(cells[i].value));
+                        _write(b, b->data + cells[i].offset, size + 1);
+                }
+        }
+}
+
+
+// Move the rows read so far to a temporary file, later rows are written there
+static void _spill(builder_t b) {
+        const char *dir = getenv("TMPDIR");
+        char path[STRLEN];
+        snprintf(path, sizeof(path), "%s/zdb-XXXXXX", STR_DEF(dir) ? dir : "/tmp");
+        int fd = mkstemp(path);
+        if (fd < 0)
+                THROW(SQLException, "Failed to create temporary file -- %s", System_getLastError());
+        unlink(path);
+        if (! (b->file = fdopen(fd, "w+"))) {
+                close(fd);
+                THROW(SQLException, "Failed to open temporary file -- %s", System_getLastError());
+        }
+        for (int row = 0; row < b->rows; row++)
+                _writeRow(b, row, b->cells + (long)row * b->columns);
+        // Keep the column names and room for one row
+        b->length = b->namesLength;
+        RESIZE(b->cells, (long)b->columns * sizeof(cell_t));
+}
+
+
+static inline size_t _memoryUsed(builder_t b) {
+        return (size_t)b->rows * b->columns * sizeof(cell_t) + b->length;
+}
+
+
+static const char *_map(builder_t b) {
+        if (fflush(b->file) != 0)
+                THROW(SQLException, "Failed to write temporary file -- %s", System_getLastError());
+        void *map = mmap(NULL, b->fileSize, PROT_READ, MAP_PRIVATE, fileno(b->file), 0);
+        if (map == MAP_FAILED)
+                THROW(SQLException, "Failed to map temporary file -- %s", System_getLastError());
+        return map;
+}
+
+
+// Copy names, the cell or row offset table and values into one allocation
+static arena_t _pack(builder_t b) {
+        size_t names = b->columns * sizeof(size_t);
+        size_t table = b->file ? (size_t)b->rows * sizeof(size_t) : (size_t)b->rows * b->columns * sizeof(cell_t);
+        arena_t arena = ALLOC((long)(sizeof(struct arena_t) + names + table + b->length));
+        *arena = (struct arena_t){.rows = b->rows, .columns = b->columns};
+        atomic_init(&arena->refs, 1);
+        arena->names = (size_t *)(arena + 1);
+        if (b->file)
+                arena->offsets = (size_t *)((char *)arena->names + names);
+        else
+                arena->cells = (cell_t *)((char *)arena->names + names);
+        arena->data = (char *)arena->names + names + table;
+        if (names)
+                memcpy(arena->names, b->names, names);
+        if (table)
+                memcpy((char *)arena->names + names, b->file ? (void *)b->offsets : (void *)b->cells, table);
+        if (b->length)
+                memcpy(arena->data, b->data, b->length);
+        return arena;
+}
+
+
+static T _newCursor(arena_t arena) {
+        T R;
+        NEW(R);
+        R->arena = arena;
+        R->base = arena->data;
+        if (arena->map) {
+                R->base = arena->map;
+                if (arena->columns > 0)
+                        R->cells = ALLOC((long)arena->columns * sizeof(cell_t));
+        }
+        return R;
+}
+
+
+static void _decodeRow(T R, int row) {
+        const char *p = R->arena->map + R->arena->offsets[row];
+        for (int i = 0; i < R->arena->columns; i++) {
+                cell_t *cell = &R->cells[i];
+                int32_t size;
+                cell->type = (unsigned char)*p++;
+                memcpy(&size, p, sizeof(size));
+                p += sizeof(size);
+                cell->size = size;
+                if (size >= 0) {
+                        if (_isNumber(cell->type)) {
+                                memcpy(&cell->value, p, sizeof(cell->value));
+                                p += sizeof(cell->value);
+                        }
+                        cell->offset = p - R->arena->map;
+                        p += size + 1;
+                }
+        }
+}
+
+
+static inline const cell_t *_cell(T R, int columnIndex) {
+        int i = checkAndSetColumnIndex(columnIndex, R->arena->columns);
+        if (! R->current)
+                THROW(SQLException, "No current row -- call ResultSet_next() first");
+        return R->current + i;
+}
+
+
+static inline const char *_value(T R, const cell_t *cell) {
+        return cell->size < 0 ? NULL : R->base + cell->offset;
+}
+
+
+/* ----------------------------------------------------- Protected methods */
+
+
+T MaterializedResultSet_new(ResultSet_T source) {
+        assert(source);
+        arena_t arena = NULL;
+        builder_t b;
+        NEW(b);
+        b->limit = ResultSet_getMemoryLimit(source);
+        TRY
+        {
+                b->columns = ResultSet_getColumnCount(source);
+                if (b->columns > 0)
+                        b->names = CALLOC(b->columns, sizeof(size_t));
+                for (int i = 0; i < b->columns; i++) {
+                        const char *name = ResultSet_getColumnName(source, i + 1);
+                        b->names[i] = _append(b, name, name ? (int)strlen(name) : 0);
+                }
+                b->namesLength = b->length;
+                while (ResultSet_next(source)) {
+                        cell_t *row = b->cells;
+                        if (! b->file) {
+                                if (b->rows == b->allocated) {
+                                        b->allocated = b->allocated ? b->allocated * 2 : 16;
+                                        if (b->cells)
+                                                RESIZE(b->cells, (long)b->allocated * b->columns * sizeof(cell_t));
+                                        else
+                                                b->cells = ALLOC((long)b->allocated * b->columns * sizeof(cell_t));
+                                }
+                                row = b->cells + (long)b->rows * b->columns;
+                        }
+                        for (int i = 0; i < b->columns; i++)
+                                _readCell(b, source, i + 1, &row[i]);
+                        if (b->file) {
+                                _writeRow(b, b->rows, row);
+                                b->length = b->namesLength;
+                        }
+                        b->rows++;
+                        if (! b->file && b->limit > 0 && _memoryUsed(b) > (size_t)b->limit)
+                                _spill(b);
+                }
+                if (b->file)
+                        b->map = _map(b);
+                arena = _pack(b);
+                if (b->map) {
+                        arena->map = b->map;
+                        arena->mapSize = b->fileSize;
+                        b->map = NULL;
+                }
+        }
+        FINALLY
+        {
+                if (b->map)
+                        munmap((void *)b->map, b->fileSize);
+                if (b->file)
+                        fclose(b->file);
+                FREE(b->names);
+                FREE(b->cells);
+                FREE(b->offsets);
+                FREE(b->data);
+                FREE(b);
+        }
+        END_TRY;
+        return _newCursor(arena);
+}
+
+
+T MaterializedResultSet_share(T R) {
+        assert(R);
+        atomic_fetch_add(&R->arena->refs, 1);
+        return _newCursor(R->arena);
+}
+
+
+/* -------------------------------------------------------- Delegate methods */
+
+
+static void _free(T *R) {
+        assert(R && *R);
+        arena_t arena = (*R)->arena;
+        if (atomic_fetch_sub(&arena->refs, 1) == 1) {
+                if (arena->map)
+                        munmap((void *)arena->map, arena->mapSize);
+                FREE(arena);
+        }
+        FREE((*R)->cells);
+        FREE(*R);
+}
+
+
+static int _getColumnCount(T R) {
+        assert(R);
+        return R->arena->columns;
+}
+
+
+static const char *_getColumnName(T R, int columnIndex) {
+        assert(R);
+        columnIndex--;
+        if (columnIndex < 0 || columnIndex >= R->arena->columns)
+                return NULL;
+        return R->arena->data + R->arena->names[columnIndex];
+}
+
+
+static long _getColumnSize(T R, int columnIndex) {
+        assert(R);
+        const cell_t *cell = _cell(R, columnIndex);
+        return cell->size < 0 ? 0 : cell->size;
+}
+
+
+static bool _seek(T R, int row) {
+        assert(R);
+        assert(row >= 0);
+        if (row > R->arena->rows)
+                row = R->arena->rows + 1;
+        R->row = row;
+        R->current = NULL;
+        if (row > 0 && row <= R->arena->rows) {
+                if (R->arena->map) {
+                        _decodeRow(R, row - 1);
+                        R->current = R->cells;
+                } else {
+                        R->current = R->arena->cells + (long)(row - 1) * R->arena->columns;
+                }
+        }
+        return R->current != NULL;
+}
+
+
+static bool _next(T R) {
+        assert(R);
+        return R->row <= R->arena->rows ? _seek(R, R->row + 1) : false;
+}
+
+
+static int _getRowCount(T R) {
+        assert(R);
+        return R->arena->rows;
+}
+
+
+static bool _isnull(T R, int columnIndex) {
+        assert(R);
+        return _cell(R, columnIndex)->size < 0;
+}
+
+
+static const char *_getString(T R, int columnIndex) {
+        assert(R);
+        return _value(R, _cell(R, columnIndex));
+}
+
+
+static const char *_getSString(T R, int columnIndex, int *size) {
+        assert(R);
+        const cell_t *cell = _cell(R, columnIndex);
+        *size = cell->size < 0 ? 0 : cell->size;
+        return _value(R, cell);
+}
+
+
+static long long _getLLong(T R, int columnIndex) {
+        assert(R);
+        const cell_t *cell = _cell(R, columnIndex);
+        if (cell->size < 0)
+                return 0;
+        switch (cell->type) {
+                case ResultSet_Integer:
+                        return cell->value.i;
+                case ResultSet_Real:
+                        return (long long)cell->value.d;
+        }
+        return Str_parseLLong(_value(R, cell));
+}
+
+
+static int _getInt(T R, int columnIndex) {
+        return (int)_getLLong(R, columnIndex);
+}
+
+
+static double _getDouble(T R, int columnIndex) {
+        assert(R);
+        const cell_t *cell = _cell(R, columnIndex);
+        if (cell->size < 0)
+                return 0.0;
+        switch (cell->type) {
+                case ResultSet_Integer:
+                        return (double)cell->value.i;
+                case ResultSet_Real:
+                        return cell->value.d;
+        }
+        return Str_parseDouble(_value(R, cell));
+}
+
+
+static int _getColumnType(T R, int columnIndex) {
+        assert(R);
+        return _cell(R, columnIndex)->type;
+}
+
+
+static const void *_getBlob(T R, int columnIndex, int *size) {
+        assert(R);
+        const cell_t *cell = _cell(R, columnIndex);
+        *size = cell->size < 0 ? 0 : cell->size;
+        return _value(R, cell);
+}
+
+
+// An integer is seconds since the epoch as with SQLite, other values are parsed
+static time_t _getTimestamp(T R, int columnIndex) {
+        assert(R);
+        const cell_t *cell = _cell(R, columnIndex);
+        if (cell->size < 0)
+                return 0;
+        if (cell->type == ResultSet_Integer)
+                return (time_t)cell->value.i;
+        return Time_toTimestamp(_value(R, cell));
+}
+
+
+static struct tm *_getDateTime(T R, int columnIndex, struct tm *tm) {
+        assert(R);
+        const cell_t *cell = _cell(R, columnIndex);
+        if (cell->size < 0)
+                return tm;
+        if (cell->type == ResultSet_Integer) {
+                time_t utc = (time_t)cell->value.i;
+                if (gmtime_r(&utc, tm)) tm->tm_year += 1900; // Use year literal
+        } else {
+                Time_toDateTime(_value(R, cell), tm);
+        }
+        return tm;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+
+const struct Rop_T materializedrops = {
+        .name           = "materialized",
+        .free           = _free,
+        .getColumnCount = _getColumnCount,
+        .getColumnName  = _getColumnName,
+        .getColumnSize  = _getColumnSize,
+        .next           = _next,
+        .seek           = _seek,
+        .getRowCount    = _getRowCount,
+        .isnull         = _isnull,
+        .getString      = _getString,
+        .getSString     = _getSString,
+        .getInt         = _getInt,
+        .getLLong       = _getLLong,
+        .getDouble      = _getDouble,
+        .getColumnType  = _getColumnType,
+        .getBlob        = _getBlob,
+        .getTimestamp   = _getTimestamp,
+        .getDateTime    = _getDateTime
+};
@@ -45,7 +45,9 @@
 #define T PreparedStatement_T
 struct PreparedStatement_S {
         Pop_T op;
+        long long batchRows;
         ResultSet_T resultSet;
+        ResultSet_Index_T index;
         PreparedStatementDelegate_T D;
 };
 
@@ -76,6 +78,8 @@ T PreparedStatement_new(PreparedStatementDelegate_T D, Pop_T op) {
 void PreparedStatement_free(T *P) {
 	assert(P && *P);
         _clearResultSet((*P));
+        if ((*P)->index)
+                ResultSet_Index_free(&(*P)->index);
         (*P)->op->free(&((*P)->D));
 	FREE(*P);
 }
@@ -122,6 +126,24 @@ void PreparedStatement_setBlob(T P, int parameterIndex, const void *x, int size)
 }
 
 
+void PreparedStatement_setBlobStream(T P, int parameterIndex, PreparedStatement_BlobSource source, void *context) {
+        assert(P);
+        assert(source);
+        if (! P->op->setBlobStream)
+                THROW(SQLException, "Blob streaming is not supported by %s", P->op->name);
+        P->op->setBlobStream(P->D, parameterIndex, source, context);
+}
+
+
+void PreparedStatement_setZeroBlob(T P, int parameterIndex, int size) {
+        assert(P);
+        assert(size >= 0);
+        if (! P->op->setZeroBlob)
+                THROW(SQLException, "Zero blobs are not supported by %s", P->op->name);
+        P->op->setZeroBlob(P->D, parameterIndex, size);
+}
+
+
 void PreparedStatement_setTimestamp(T P, int parameterIndex, time_t x) {
         assert(P);
         P->op->setTimestamp(P->D, parameterIndex, x);
@@ -150,6 +172,8 @@ ResultSet_T PreparedStatement_executeQuery(T P) {
 	P->resultSet = P->op->executeQuery(P->D);
         if (! P->resultSet)
                 THROW(SQLException, "PreparedStatement_executeQuery");
+        // Column names are the same for each execution, keep the name index
+        ResultSet_setIndex(P->resultSet, &P->index);
         return P->resultSet;
 }
 
@@ -160,6 +184,43 @@ long long PreparedStatement_rowsChanged(T P) {
 }
 
 
+void PreparedStatement_addBatch(T P) {
+        assert(P);
+        _clearResultSet(P);
+        if (P->op->addBatch) {
+                P->op->addBatch(P->D);
+        } else {
+                // No array binding, execute the row now and sum up rows changed
+                P->op->execute(P->D);
+                P->batchRows += P->op->rowsChanged(P->D);
+        }
+}
+
+
+long long PreparedStatement_executeBatch(T P) {
+        assert(P);
+        _clearResultSet(P);
+        if (P->op->executeBatch)
+                return P->op->executeBatch(P->D);
+        long long rows = P->batchRows;
+        P->batchRows = 0;
+        return rows;
+}
+
+
+int PreparedStatement_getBatchErrors(T P) {
+        assert(P);
+        return P->op->getBatchErrors ? P->op->getBatchErrors(P->D) : 0;
+}
+
+
+const char *PreparedStatement_getBatchError(T P, int index, int *row) {
+        assert(P);
+        assert(row);
+        return P->op->getBatchError ? P->op->getBatchError(P->D, index, row) : NULL;
+}
+
+
 /* ------------------------------------------------------------ Properties */
 
 
@@ -132,6 +132,20 @@
 #define T PreparedStatement_T
 typedef struct PreparedStatement_S *T;
 
+
+/**
+ * @brief Blob source callback used by PreparedStatement_setBlobStream().
+ *
+ * The callback is called repeatedly while the statement is executed and
+ * should copy the next piece of the value into `buffer`.
+ *
+ * @param context The context given to PreparedStatement_setBlobStream()
+ * @param buffer Output buffer for the next piece of the value
+ * @param size The size of buffer in bytes
+ * @return The number of bytes copied into buffer, 0 when there is no more data
+ */
+typedef int (*PreparedStatement_BlobSource)(void *context, void *buffer, int size);
+
 //<< Protected methods
 
 /**
@@ -243,6 +257,45 @@ void PreparedStatement_setDouble(T P, int parameterIndex, double x);
 void PreparedStatement_setBlob(T P, int parameterIndex, const void *x, int size);
 
 
+/**
+ * @brief Sets the *in* parameter at index `parameterIndex` to a blob value
+ * read from a callback when the statement is executed.
+ *
+ * The value is sent to the database in pieces as they are produced by
+ * `source` and is never held in memory as a whole. This is useful for
+ * inserting large LOB values. The source is read once for each execution
+ * of the statement. Currently only supported by *Oracle*.
+ *
+ * @param P A PreparedStatement object
+ * @param parameterIndex The first parameter is 1, the second is 2,..
+ * @param source The callback producing the value
+ * @param context Context pointer given to source
+ * @exception SQLException If a database access error occurs, if parameter
+ * index is out of range or if streaming is not supported by the database
+ * @see SQLException.h
+ */
+void PreparedStatement_setBlobStream(T P, int parameterIndex, PreparedStatement_BlobSource source, void *context);
+
+
+/**
+ * @brief Sets the *in* parameter at index `parameterIndex` to a blob of
+ * `size` zero bytes.
+ *
+ * Use this to reserve space for a large value which is then written in
+ * pieces with Connection_writeBlob(), without holding the whole value in
+ * memory. Currently only supported by *SQLite*.
+ *
+ * @param P A PreparedStatement object
+ * @param parameterIndex The first parameter is 1, the second is 2,..
+ * @param size The size of the blob in bytes
+ * @exception SQLException If a database access error occurs, if parameter
+ * index is out of range or if the database does not support it
+ * @see Connection_writeBlob()
+ * @see SQLException.h
+ */
+void PreparedStatement_setZeroBlob(T P, int parameterIndex, int size);
+
+
 /**
  * @brief Sets the *in* parameter at index `parameterIndex` to the
  * given Unix timestamp value.
@@ -331,6 +384,74 @@ ResultSet_T PreparedStatement_executeQuery(T P);
  */
 long long PreparedStatement_rowsChanged(T P);
 
+
+/**
+ * @brief Adds the current set of parameters to the batch of this PreparedStatement.
+ *
+ * A batch is executed with PreparedStatement_executeBatch(). On Oracle
+ * parameter values are copied into the batch and sent to the server in one
+ * array execute, which makes bulk inserts and updates much faster than
+ * one execute per row. Parameters must keep the same type for every row
+ * in a batch. Other databases do not support array binding and the
+ * statement is instead executed immediately with the current parameters.
+ *
+ * @code
+ * PreparedStatement_T p = Connection_prepareStatement(con, "INSERT INTO employee(id, name) VALUES(?, ?)");
+ * for (int i = 0; employees[i]; i++) {
+ *         PreparedStatement_setInt(p, 1, employees[i].id);
+ *         PreparedStatement_setString(p, 2, employees[i].name);
+ *         PreparedStatement_addBatch(p);
+ * }
+ * long long rows = PreparedStatement_executeBatch(p);
+ * for (int i = 0; i < PreparedStatement_getBatchErrors(p); i++) {
+ *         int row;
+ *         const char *error = PreparedStatement_getBatchError(p, i, &row);
+ *         printf("Row %d failed: %s\n", row, error);
+ * }
+ * @endcode
+ *
+ * @param P A PreparedStatement object
+ * @exception SQLException If a database error occurs or a parameter
+ * changed type within the batch
+ * @see SQLException.h
+ */
+void PreparedStatement_addBatch(T P);
+
+
+/**
+ * @brief Executes the batch of parameter sets added with PreparedStatement_addBatch().
+ *
+ * Rows that fail do not stop the batch. Use PreparedStatement_getBatchErrors()
+ * and PreparedStatement_getBatchError() to find out which rows failed and why.
+ * The batch is empty after this call and parameters must be set again
+ * before the PreparedStatement is executed.
+ *
+ * @param P A PreparedStatement object
+ * @return The number of rows changed by the batch
+ * @exception SQLException If the batch as a whole could not be executed
+ * @see SQLException.h
+ */
+long long PreparedStatement_executeBatch(T P);
+
+
+/**
+ * @brief Gets the number of rows that failed in the last batch.
+ * @param P A PreparedStatement object
+ * @return The number of rows in the last PreparedStatement_executeBatch()
+ * that failed
+ */
+int PreparedStatement_getBatchErrors(T P);
+
+
+/**
+ * @brief Gets a row error from the last batch.
+ * @param P A PreparedStatement object
+ * @param index The error to get, 0 <= index < PreparedStatement_getBatchErrors()
+ * @param row Set to the row in the batch that failed. The first row added is 1
+ * @return The error message of the failed row or NULL if index is out of range
+ */
+const char *PreparedStatement_getBatchError(T P, int index, int *row);
+
 /// @}
 /// @name Properties
 /// @{
@@ -45,8 +45,14 @@ typedef struct Pop_T {
         void (*setDouble)(T P, int parameterIndex, double x);
         void (*setTimestamp)(T P, int parameterIndex, time_t timestamp);
         void (*setBlob)(T P, int parameterIndex, const void *x, int size);
+        void (*setBlobStream)(T P, int parameterIndex, int (*source)(void *context, void *buffer, int size), void *context);
+        void (*setZeroBlob)(T P, int parameterIndex, int size);
         void (*execute)(T P);
         ResultSet_T (*executeQuery)(T P);
+        void (*addBatch)(T P);
+        long long (*executeBatch)(T P);
+        int (*getBatchErrors)(T P);
+        const char *(*getBatchError)(T P, int index, int *row);
         long long (*rowsChanged)(T P);
         int (*parameterCount)(T P);
 } *Pop_T;
@@ -26,6 +26,8 @@
 #include "Config.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
 
 #include "ResultSet.h"
 #include "system/Time.h"
@@ -41,27 +43,491 @@
 /* ----------------------------------------------------------- Definitions */
 
 
+extern const struct Rop_T materializedrops;
+
+
 #define T ResultSet_T
 struct ResultSet_S {
         Rop_T op;
         ResultSetDelegate_T D;
         int fetchSize;
+        bool reading;
+        int readColumns;
+        int *readOffsets; // Offset per column of ResultSet_readBlob() in the current row
+        long long memoryLimit;
+        bool indexBuilt;
+        ResultSet_Index_T *index;
+        ResultSet_Index_T ownIndex;
+        ResultSet_Batch_T batch;
+        int batchColumns;
+        ResultSet_ColumnType *batchTypes; // Type per column kept for the batches of the current result
+};
+
+/* A hash index of column names, built on the first access by name. A slot
+ holds a column number and the hash of its name. A found name is compared
+ with the column name from the delegate, so an index can be reused by the
+ next ResultSet of a PreparedStatement */
+typedef struct slot_t {
+        unsigned int hash;
+        int column;
+} slot_t;
+
+struct ResultSet_Index_S {
+        int columns;
+        unsigned int mask;
+        slot_t *slots;
+};
+
+
+/* A column of a batch. Buffers are kept between batches and grow to the
+ largest batch. The values and offsets buffers hold capacity rows when
+ allocated, the data buffer dataCapacity bytes */
+typedef struct column_t {
+        ResultSet_Column column;
+        int capacity;
+        int size;
+        int dataCapacity;
+        uint8_t *validity;
+        void *values;
+        int32_t *offsets;
+        char *data;
+} column_t;
+
+/* The batch is shared by the ResultSet and, after export, by the Arrow
+ array and each of its children which may be released separately */
+struct ResultSet_Batch_S {
+        int rows;
+        int columns;
+        bool ready;
+        atomic_int refs;
+        column_t *column;
 };
 
 
 /* ------------------------------------------------------- Private methods */
 
 
+// FNV-1a
+static inline unsigned int _hash(const char *name) {
+        unsigned int h = 2166136261u;
+        while (*name)
+                h = (h ^ (unsigned char)*name++) * 16777619u;
+        return h;
+}
+
+
+static ResultSet_Index_T _buildIndex(T R, int columns) {
+        ResultSet_Index_T index;
+        NEW(index);
+        index->columns = columns;
+        unsigned int size = 8;
+        while (size < 2 * (unsigned int)columns)
+                size <<= 1;
+        index->mask = size - 1;
+        index->slots = CALLOC(size, sizeof(slot_t));
+        // Columns are added in order so the first of duplicate names is found first
+        for (int i = 1; i <= columns; i++) {
+                const char *name = ResultSet_getColumnName(R, i);
+                if (name) {
+                        unsigned int h = _hash(name), s = h & index->mask;
+                        while (index->slots[s].column)
+                                s = (s + 1) & index->mask;
+                        index->slots[s] = (slot_t){.hash = h, .column = i};
+                }
+        }
+        return index;
+}
+
+
+static inline int _lookup(T R, ResultSet_Index_T index, const char *name) {
+        unsigned int h = _hash(name);
+        for (unsigned int s = h & index->mask; index->slots[s].column; s = (s + 1) & index->mask)
+                if (index->slots[s].hash == h && Str_isByteEqual(name, ResultSet_getColumnName(R, index->slots[s].column)))
+                        return index->slots[s].column;
+        return 0;
+}
+
+
 static inline int _getIndex(T R, const char *name) {
-        int columns = ResultSet_getColumnCount(R);
-        for (int i = 1; i <= columns; i++)
-                if (Str_isByteEqual(name, ResultSet_getColumnName(R, i)))
+        if (name) {
+                int columns = ResultSet_getColumnCount(R);
+                if (*R->index && (*R->index)->columns != columns)
+                        ResultSet_Index_free(R->index);
+                if (! *R->index) {
+                        *R->index = _buildIndex(R, columns);
+                        R->indexBuilt = true;
+                }
+                int i = _lookup(R, *R->index, name);
+                if (i)
                         return i;
+                // An index reused from a previous ResultSet may have other column names
+                if (! R->indexBuilt) {
+                        ResultSet_Index_free(R->index);
+                        *R->index = _buildIndex(R, columns);
+                        R->indexBuilt = true;
+                        if ((i = _lookup(R, *R->index, name)))
+                                return i;
+                }
+        }
         THROW(SQLException, "Invalid column name '%s'", name ? name : "null");
         return -1;
 }
 
 
+/* --------------------------------------------------------- Batch columns */
+
+
+static inline bool _isFixed(ResultSet_ColumnType type) {
+        return type == ResultSet_Integer || type == ResultSet_Real;
+}
+
+
+static inline bool _isVariable(ResultSet_ColumnType type) {
+        return type == ResultSet_Text || type == ResultSet_Blob;
+}
+
+
+static ResultSet_Batch_T _newBatch(int columns) {
+        ResultSet_Batch_T B;
+        NEW(B);
+        B->columns = columns;
+        B->column = CALLOC(columns, sizeof(column_t));
+        for (int i = 0; i < columns; i++)
+                B->column[i].column.type = ResultSet_Null;
+        atomic_init(&B->refs, 1);
+        return B;
+}
+
+
+static void _unrefBatch(ResultSet_Batch_T *B) {
+        assert(B && *B);
+        if (atomic_fetch_sub(&(*B)->refs, 1) == 1) {
+                for (int i = 0; i < (*B)->columns; i++) {
+                        column_t *c = &(*B)->column[i];
+                        FREE(c->validity);
+                        FREE(c->values);
+                        FREE(c->offsets);
+                        FREE(c->data);
+                }
+                FREE((*B)->column);
+                FREE(*B);
+        }
+        *B = NULL;
+}
+
+
+static inline column_t *_getColumn(ResultSet_Batch_T B, int columnIndex) {
+        assert(B);
+        return &B->column[checkAndSetColumnIndex(columnIndex, B->columns)];
+}
+
+
+static inline void *_resize(void *p, long size) {
+        if (p)
+                return RESIZE(p, size);
+        return ALLOC(size);
+}
+
+
+// Make room for one more row in the buffers allocated so far
+static void _grow(column_t *c) {
+        if (c->column.length < c->capacity)
+                return;
+        int capacity = c->capacity ? c->capacity * 2 : 64;
+        int bytes = (c->capacity + 7) / 8;
+        c->validity = _resize(c->validity, (capacity + 7) / 8);
+        memset(c->validity + bytes, 0, (capacity + 7) / 8 - bytes);
+        if (c->values)
+                c->values = _resize(c->values, (long)capacity * 8);
+        if (c->offsets)
+                c->offsets = _resize(c->offsets, (long)(capacity + 1) * sizeof(int32_t));
+        c->capacity = capacity;
+}
+
+
+// Set the type of a column where all rows so far are NULL
+static void _setType(column_t *c, ResultSet_ColumnType type) {
+        c->column.type = type;
+        if (_isFixed(type)) {
+                if (! c->values)
+                        c->values = ALLOC((long)c->capacity * 8);
+                memset(c->values, 0, (long)c->column.length * 8);
+        } else {
+                if (! c->offsets)
+                        c->offsets = ALLOC((long)(c->capacity + 1) * sizeof(int32_t));
+                memset(c->offsets, 0, (long)(c->column.length + 1) * sizeof(int32_t));
+        }
+}
+
+
+// Empty the batch, columns start with the type of the previous batches so all batches of a result have the same type
+static void _resetBatch(ResultSet_Batch_T B, const ResultSet_ColumnType *types) {
+        B->rows = 0;
+        B->ready = false;
+        for (int i = 0; i < B->columns; i++) {
+                column_t *c = &B->column[i];
+                if (c->validity)
+                        memset(c->validity, 0, (c->capacity + 7) / 8);
+                c->column = (ResultSet_Column){.type = ResultSet_Null};
+                c->size = 0;
+                if (types[i] != ResultSet_Null) {
+                        _grow(c);
+                        _setType(c, types[i]);
+                }
+        }
+}
+
+
+static void _appendData(column_t *c, const void *bytes, int size) {
+        if (size > INT32_MAX - c->size)
+                THROW(SQLException, "Batch column exceeds 2GB");
+        if (c->size + size > c->dataCapacity) {
+                long long capacity = c->dataCapacity ? c->dataCapacity : 1024;
+                while (capacity < (long long)c->size + size)
+                        capacity *= 2;
+                c->dataCapacity = (int)(capacity > INT32_MAX ? INT32_MAX : capacity);
+                c->data = _resize(c->data, c->dataCapacity);
+        }
+        if (size > 0)
+                memcpy(c->data + c->size, bytes, size);
+        c->size += size;
+        c->offsets[c->column.length + 1] = c->size;
+}
+
+
+static inline void _setValid(column_t *c) {
+        c->validity[c->column.length >> 3] |= 1 << (c->column.length & 7);
+}
+
+
+static inline bool _isValid(column_t *c, int row) {
+        return c->validity[row >> 3] & (1 << (row & 7));
+}
+
+
+static int _format(char buffer[static 32], ResultSet_ColumnType type, const void *value) {
+        if (type == ResultSet_Integer) {
+                int64_t v;
+                memcpy(&v, value, sizeof(v));
+                return snprintf(buffer, 32, "%lld", (long long)v);
+        }
+        double v;
+        memcpy(&v, value, sizeof(v));
+        return snprintf(buffer, 32, "%.17g", v);
+}
+
+
+static void _toReal(column_t *c) {
+        for (int i = 0; i < c->column.length; i++) {
+                int64_t v;
+                memcpy(&v, (char*)c->values + i * 8, sizeof(v));
+                double d = (double)v;
+                memcpy((char*)c->values + i * 8, &d, sizeof(d));
+        }
+        c->column.type = ResultSet_Real;
+}
+
+
+// Convert a column of numbers to text. The current row is not yet added
+static void _toText(column_t *c) {
+        ResultSet_ColumnType type = c->column.type;
+        int length = c->column.length;
+        if (! c->offsets)
+                c->offsets = ALLOC((long)(c->capacity + 1) * sizeof(int32_t));
+        c->offsets[0] = 0;
+        c->size = 0;
+        for (c->column.length = 0; c->column.length < length; c->column.length++) {
+                char buffer[32];
+                int n = _isValid(c, c->column.length) ? _format(buffer, type, (char*)c->values + c->column.length * 8) : 0;
+                _appendData(c, buffer, n);
+        }
+        c->column.type = ResultSet_Text;
+}
+
+
+static void _publishBatch(ResultSet_Batch_T B, int rows) {
+        B->rows = rows;
+        for (int i = 0; i < B->columns; i++) {
+                column_t *c = &B->column[i];
+                assert(c->column.length == rows);
+                bool variable = _isVariable(c->column.type);
+                c->column.validity = c->column.nullCount ? c->validity : NULL;
+                c->column.values = _isFixed(c->column.type) ? c->values : NULL;
+                c->column.offsets = variable ? c->offsets : NULL;
+                c->column.data = variable ? (c->data ? c->data : "") : NULL;
+        }
+        B->ready = true;
+}
+
+
+// Add a number or return false if the getter cannot convert the value, such as a BIGINT UNSIGNED above LLONG_MAX
+static bool _addNumber(T R, ResultSet_Batch_T B, int columnIndex, ResultSet_ColumnType type) {
+        volatile bool added = false;
+        TRY
+        {
+                if (type == ResultSet_Integer)
+                        ResultSet_Batch_addLLong(B, columnIndex, ResultSet_getLLong(R, columnIndex));
+                else
+                        ResultSet_Batch_addDouble(B, columnIndex, ResultSet_getDouble(R, columnIndex));
+                added = true;
+        }
+        CATCH(SQLException)
+        {
+                // The caller adds the value as text
+        }
+        END_TRY;
+        return added;
+}
+
+
+// Fill a batch from the getter methods for a delegate without fetchBatch
+static int _fetchBatch(T R, int rows, ResultSet_Batch_T B) {
+        int n = 0;
+        while (n < rows && R->op->next(R->D)) {
+                for (int i = 1; i <= B->columns; i++) {
+                        if (R->op->isnull(R->D, i)) {
+                                ResultSet_Batch_addNull(B, i);
+                                continue;
+                        }
+                        int size;
+                        ResultSet_ColumnType type = ResultSet_getColumnType(R, i);
+                        if (_isFixed(type) && _addNumber(R, B, i, type))
+                                continue;
+                        if (type == ResultSet_Blob) {
+                                const void *blob = ResultSet_getBlob(R, i, &size);
+                                ResultSet_Batch_addBytes(B, i, ResultSet_Blob, blob, size);
+                        } else {
+                                const char *text = ResultSet_getSString(R, i, &size);
+                                ResultSet_Batch_addBytes(B, i, ResultSet_Text, text, size);
+                        }
+                }
+                n++;
+        }
+        return n;
+}
+
+
+/* ---------------------------------------------------------- Arrow export */
+
+
+static const char *_arrowFormat(ResultSet_ColumnType type) {
+        switch (type) {
+                case ResultSet_Integer: return "l";
+                case ResultSet_Real: return "g";
+                case ResultSet_Text: return "u";
+                case ResultSet_Blob: return "z";
+                default: return "n";
+        }
+}
+
+
+static void _releaseChildSchema(struct ArrowSchema *schema) {
+        char *name = (char *)schema->name;
+        FREE(name);
+        schema->release = NULL;
+}
+
+
+static void _releaseSchema(struct ArrowSchema *schema) {
+        for (int i = 0; i < schema->n_children; i++)
+                if (schema->children[i]->release)
+                        schema->children[i]->release(schema->children[i]);
+        // The child structs are allocated in one block after the pointers
+        FREE(schema->children);
+        schema->release = NULL;
+}
+
+
+static void _releaseChildArray(struct ArrowArray *array) {
+        ResultSet_Batch_T B = array->private_data;
+        FREE(array->buffers);
+        _unrefBatch(&B);
+        array->release = NULL;
+}
+
+
+static void _releaseArray(struct ArrowArray *array) {
+        ResultSet_Batch_T B = array->private_data;
+        for (int i = 0; i < array->n_children; i++)
+                if (array->children[i]->release)
+                        array->children[i]->release(array->children[i]);
+        FREE(array->children);
+        FREE(array->buffers);
+        _unrefBatch(&B);
+        array->release = NULL;
+}
+
+
+static void _exportSchema(T R, ResultSet_Batch_T B, struct ArrowSchema *schema) {
+        struct ArrowSchema **children = ALLOC(B->columns * (sizeof(struct ArrowSchema *) + sizeof(struct ArrowSchema)));
+        struct ArrowSchema *child = (struct ArrowSchema *)(children + B->columns);
+        for (int i = 0; i < B->columns; i++) {
+                const char *name = ResultSet_getColumnName(R, i + 1);
+                child[i] = (struct ArrowSchema){
+                        .format = _arrowFormat(B->column[i].column.type),
+                        .name = Str_dup(name ? name : ""),
+                        .flags = ARROW_FLAG_NULLABLE,
+                        .release = _releaseChildSchema
+                };
+                children[i] = &child[i];
+        }
+        *schema = (struct ArrowSchema){
+                .format = "+s",
+                .name = "",
+                .n_children = B->columns,
+                .children = children,
+                .release = _releaseSchema
+        };
+}
+
+
+static void _exportArray(ResultSet_Batch_T B, struct ArrowArray *array) {
+        struct ArrowArray **children = ALLOC(B->columns * (sizeof(struct ArrowArray *) + sizeof(struct ArrowArray)));
+        struct ArrowArray *child = (struct ArrowArray *)(children + B->columns);
+        for (int i = 0; i < B->columns; i++) {
+                ResultSet_Column *c = &B->column[i].column;
+                int n = _isFixed(c->type) ? 2 : _isVariable(c->type) ? 3 : 0;
+                const void **buffers = n ? ALLOC(n * sizeof(void *)) : NULL;
+                if (n) {
+                        buffers[0] = c->validity;
+                        buffers[1] = n == 2 ? c->values : (const void *)c->offsets;
+                        if (n == 3)
+                                buffers[2] = c->data;
+                }
+                atomic_fetch_add(&B->refs, 1);
+                child[i] = (struct ArrowArray){
+                        .length = c->length,
+                        .null_count = c->nullCount,
+                        .n_buffers = n,
+                        .buffers = buffers,
+                        .release = _releaseChildArray,
+                        .private_data = B
+                };
+                children[i] = &child[i];
+        }
+        const void **buffers = ALLOC(sizeof(void *));
+        buffers[0] = NULL;
+        *array = (struct ArrowArray){
+                .length = B->rows,
+                .n_buffers = 1,
+                .n_children = B->columns,
+                .buffers = buffers,
+                .children = children,
+                .release = _releaseArray,
+                .private_data = B
+        };
+}
+
+
+// The current row changed, ResultSet_readBlob() starts from the beginning of each value
+static inline void _resetRead(T R) {
+        if (R->reading) {
+                memset(R->readOffsets, 0, R->readColumns * sizeof(int));
+                R->reading = false;
+        }
+}
+
+
 /* ----------------------------------------------------- Protected methods */
 
 
@@ -72,6 +538,7 @@ T ResultSet_new(ResultSetDelegate_T D, Rop_T op) {
 	NEW(R);
 	R->D = D;
 	R->op = op;
+        R->index = &R->ownIndex;
 	return R;
 }
 
@@ -79,10 +546,112 @@ T ResultSet_new(ResultSetDelegate_T D, Rop_T op) {
 void ResultSet_free(T *R) {
 	assert(R && *R);
         (*R)->op->free(&((*R)->D));
+        if ((*R)->ownIndex)
+                ResultSet_Index_free(&(*R)->ownIndex);
+        if ((*R)->batch)
+                _unrefBatch(&(*R)->batch);
+        FREE((*R)->readOffsets);
+        FREE((*R)->batchTypes);
 	FREE(*R);
 }
 
 
+void ResultSet_setIndex(T R, ResultSet_Index_T *index) {
+        assert(R);
+        assert(index);
+        if (R->ownIndex)
+                ResultSet_Index_free(&R->ownIndex);
+        R->index = index;
+        R->indexBuilt = false;
+}
+
+
+void ResultSet_Index_free(ResultSet_Index_T *index) {
+        assert(index && *index);
+        FREE((*index)->slots);
+        FREE(*index);
+}
+
+
+void ResultSet_Batch_addNull(ResultSet_Batch_T B, int columnIndex) {
+        column_t *c = _getColumn(B, columnIndex);
+        _grow(c);
+        if (_isFixed(c->column.type))
+                memset((char*)c->values + c->column.length * 8, 0, 8);
+        else if (_isVariable(c->column.type))
+                c->offsets[c->column.length + 1] = c->size;
+        c->column.nullCount++;
+        c->column.length++;
+}
+
+
+void ResultSet_Batch_addLLong(ResultSet_Batch_T B, int columnIndex, long long value) {
+        column_t *c = _getColumn(B, columnIndex);
+        _grow(c);
+        switch (c->column.type) {
+                case ResultSet_Null:
+                        _setType(c, ResultSet_Integer);
+                        // fall through
+                case ResultSet_Integer:
+                        ((int64_t*)c->values)[c->column.length] = value;
+                        break;
+                case ResultSet_Real:
+                        ((double*)c->values)[c->column.length] = (double)value;
+                        break;
+                default:
+                {
+                        char buffer[32];
+                        int64_t v = value;
+                        _appendData(c, buffer, _format(buffer, ResultSet_Integer, &v));
+                }
+                        break;
+        }
+        _setValid(c);
+        c->column.length++;
+}
+
+
+void ResultSet_Batch_addDouble(ResultSet_Batch_T B, int columnIndex, double value) {
+        column_t *c = _getColumn(B, columnIndex);
+        _grow(c);
+        switch (c->column.type) {
+                case ResultSet_Null:
+                        _setType(c, ResultSet_Real);
+                        break;
+                case ResultSet_Integer:
+                        _toReal(c);
+                        break;
+                default:
+                        break;
+        }
+        if (c->column.type == ResultSet_Real) {
+                ((double*)c->values)[c->column.length] = value;
+        } else {
+                char buffer[32];
+                _appendData(c, buffer, _format(buffer, ResultSet_Real, &value));
+        }
+        _setValid(c);
+        c->column.length++;
+}
+
+
+void ResultSet_Batch_addBytes(ResultSet_Batch_T B, int columnIndex, ResultSet_ColumnType type, const void *bytes, int size) {
+        column_t *c = _getColumn(B, columnIndex);
+        _grow(c);
+        type = type == ResultSet_Blob ? ResultSet_Blob : ResultSet_Text;
+        if (c->column.type == ResultSet_Null)
+                _setType(c, type);
+        else if (_isFixed(c->column.type))
+                _toText(c);
+        // Binary holds text but not the other way around
+        if (type == ResultSet_Blob)
+                c->column.type = ResultSet_Blob;
+        _appendData(c, bytes, size);
+        _setValid(c);
+        c->column.length++;
+}
+
+
 /* ------------------------------------------------------------ Properties */
 
 
@@ -104,6 +673,15 @@ long ResultSet_getColumnSize(T R, int columnIndex) {
 }
 
 
+ResultSet_ColumnType ResultSet_getColumnType(T R, int columnIndex) {
+        assert(R);
+        if (R->op->getColumnType)
+                return R->op->getColumnType(R->D, columnIndex);
+        checkAndSetColumnIndex(columnIndex, R->op->getColumnCount(R->D));
+        return ResultSet_Unknown;
+}
+
+
 void ResultSet_setFetchSize(T R, int rows) {
         assert(R);
         assert(rows > 0);
@@ -118,11 +696,39 @@ int ResultSet_getFetchSize(T R) {
 }
 
 
+void ResultSet_setMemoryLimit(T R, long long bytes) {
+        assert(R);
+        assert(bytes >= 0);
+        R->memoryLimit = bytes;
+}
+
+
+long long ResultSet_getMemoryLimit(T R) {
+        assert(R);
+        return R->memoryLimit;
+}
+
+
 /* -------------------------------------------------------- Public methods */
 
 
 bool ResultSet_next(T R) {
-        return R ? R->op->next(R->D) : false;
+        if (! R)
+                return false;
+        _resetRead(R);
+        return R->op->next(R->D);
+}
+
+
+bool ResultSet_nextResult(T R) {
+        assert(R);
+        _resetRead(R);
+        // The next result may have other column names and types
+        if (*R->index)
+                ResultSet_Index_free(R->index);
+        R->batchColumns = 0;
+        R->indexBuilt = false;
+        return R->op->nextResult ? R->op->nextResult(R->D) : false;
 }
 
 
@@ -132,6 +738,43 @@ bool ResultSet_isnull(T R, int columnIndex) {
 }
 
 
+T ResultSet_materialize(T R) {
+        assert(R);
+        _resetRead(R);
+        if (R->op == &materializedrops)
+                return ResultSet_new(MaterializedResultSet_share(R->D), (Rop_T)&materializedrops);
+        return ResultSet_new(MaterializedResultSet_new(R), (Rop_T)&materializedrops);
+}
+
+
+void ResultSet_close(T *R) {
+        assert(R && *R);
+        assert((*R)->op == &materializedrops);
+        ResultSet_free(R);
+}
+
+
+bool ResultSet_seek(T R, int row) {
+        assert(R);
+        assert(row >= 0);
+        if (! R->op->seek)
+                THROW(SQLException, "Seek is not supported by %s -- use ResultSet_materialize()", R->op->name);
+        _resetRead(R);
+        return R->op->seek(R->D, row);
+}
+
+
+void ResultSet_rewind(T R) {
+        ResultSet_seek(R, 0);
+}
+
+
+int ResultSet_getRowCount(T R) {
+        assert(R);
+        return R->op->getRowCount ? R->op->getRowCount(R->D) : -1;
+}
+
+
 /* --------------------------------------------------------------- Columns */
 
 
@@ -147,8 +790,28 @@ const char *ResultSet_getStringByName(T R, const char *columnName) {
 }
 
 
+const char *ResultSet_getSString(T R, int columnIndex, int *size) {
+        assert(R);
+        assert(size);
+        if (R->op->getSString)
+                return R->op->getSString(R->D, columnIndex, size);
+        const char *s = R->op->getString(R->D, columnIndex);
+        *size = s ? (int)strlen(s) : 0;
+        return s;
+}
+
+
+const char *ResultSet_getSStringByName(T R, const char *columnName, int *size) {
+        assert(R);
+        return ResultSet_getSString(R, _getIndex(R, columnName), size);
+}
+
+
+// Numbers are read natively if the delegate can, otherwise the value is parsed from its string
 int ResultSet_getInt(T R, int columnIndex) {
 	assert(R);
+        if (R->op->getInt)
+                return R->op->getInt(R->D, columnIndex);
         const char *s = R->op->getString(R->D, columnIndex);
 	return s ? Str_parseInt(s) : 0;
 }
@@ -162,6 +825,8 @@ int ResultSet_getIntByName(T R, const char *columnName) {
 
 long long ResultSet_getLLong(T R, int columnIndex) {
 	assert(R);
+        if (R->op->getLLong)
+                return R->op->getLLong(R->D, columnIndex);
         const char *s = R->op->getString(R->D, columnIndex);
 	return s ? Str_parseLLong(s) : 0;
 }
@@ -175,6 +840,8 @@ long long ResultSet_getLLongByName(T R, const char *columnName) {
 
 double ResultSet_getDouble(T R, int columnIndex) {
 	assert(R);
+        if (R->op->getDouble)
+                return R->op->getDouble(R->D, columnIndex);
         const char *s = R->op->getString(R->D, columnIndex);
 	return s ? Str_parseDouble(s) : 0.0;
 }
@@ -201,6 +868,36 @@ const void *ResultSet_getBlobByName(T R, const char *columnName, int *size) {
 }
 
 
+int ResultSet_readBlob(T R, int columnIndex, void *buffer, int size) {
+        assert(R);
+        assert(buffer);
+        assert(size > 0);
+        if (R->op->readBlob)
+                return R->op->readBlob(R->D, columnIndex, buffer, size);
+        int columns = R->op->getColumnCount(R->D);
+        int i = checkAndSetColumnIndex(columnIndex, columns);
+        if (columns > R->readColumns) {
+                if (R->readOffsets)
+                        RESIZE(R->readOffsets, columns * sizeof(int));
+                else
+                        R->readOffsets = ALLOC(columns * sizeof(int));
+                memset(R->readOffsets + R->readColumns, 0, (columns - R->readColumns) * sizeof(int));
+                R->readColumns = columns;
+        }
+        int length = 0;
+        const char *blob = ResultSet_getBlob(R, columnIndex, &length);
+        int n = length - R->readOffsets[i];
+        if (! blob || n <= 0)
+                return 0;
+        if (n > size)
+                n = size;
+        memcpy(buffer, blob + R->readOffsets[i], n);
+        R->readOffsets[i] += n;
+        R->reading = true;
+        return n;
+}
+
+
 /* --------------------------------------------------------- Date and Time */
 
 
@@ -243,3 +940,52 @@ struct tm ResultSet_getDateTimeByName(T R, const char *columnName) {
         return ResultSet_getDateTime(R, _getIndex(R, columnName));
 }
 
+
+/* --------------------------------------------------------------- Batches */
+
+
+int ResultSet_fetchBatch(T R, int rows) {
+        assert(R);
+        assert(rows > 0);
+        _resetRead(R);
+        int columns = R->op->getColumnCount(R->D);
+        if (R->batchColumns != columns) {
+                FREE(R->batchTypes);
+                R->batchTypes = CALLOC(columns, sizeof(ResultSet_ColumnType));
+                for (int i = 0; i < columns; i++)
+                        R->batchTypes[i] = ResultSet_Null;
+                R->batchColumns = columns;
+        }
+        if (R->batch && R->batch->columns != columns)
+                _unrefBatch(&R->batch);
+        if (! R->batch)
+                R->batch = _newBatch(columns);
+        _resetBatch(R->batch, R->batchTypes);
+        int n = R->op->fetchBatch ? R->op->fetchBatch(R->D, rows, R->batch) : _fetchBatch(R, rows, R->batch);
+        _publishBatch(R->batch, n);
+        // The type is set by the first value which is not NULL and only changes if a later value does not fit
+        for (int i = 0; i < columns; i++)
+                R->batchTypes[i] = R->batch->column[i].column.type;
+        return n;
+}
+
+
+const ResultSet_Column *ResultSet_getBatchColumn(T R, int columnIndex) {
+        assert(R);
+        if (! R->batch || ! R->batch->ready)
+                THROW(SQLException, "No batch fetched");
+        return &_getColumn(R->batch, columnIndex)->column;
+}
+
+
+void ResultSet_exportBatch(T R, struct ArrowSchema *schema, struct ArrowArray *array) {
+        assert(R);
+        assert(schema);
+        assert(array);
+        if (! R->batch || ! R->batch->ready)
+                THROW(SQLException, "No batch fetched");
+        _exportSchema(R, R->batch, schema);
+        // The reference of the ResultSet is moved to the array
+        _exportArray(R->batch, array);
+        R->batch = NULL;
+}
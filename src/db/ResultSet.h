@@ -26,6 +26,7 @@
 #ifndef RESULTSET_INCLUDED
 #define RESULTSET_INCLUDED
 #include <time.h>
+#include <stdint.h>
 //<< Protected methods
 #include "ResultSetDelegate.h"
 //>> End Protected methods
@@ -43,7 +44,9 @@
  * it returns false when there are no more rows, it can be used in a while
  * loop to iterate through the result set. A ResultSet is not updatable and
  * has a cursor that moves forward only. Thus, you can iterate through it
- * only once and only from the first row to the last row.
+ * only once and only from the first row to the last row. Use
+ * ResultSet_materialize() to copy the rows into a ResultSet which can be
+ * read in any order and outlives the Connection.
  *
  * The ResultSet interface provides getter methods for retrieving
  * column values from the current row. Values can be retrieved using
@@ -135,6 +138,79 @@
 
 #define T ResultSet_T
 typedef struct ResultSet_S *T;
+typedef struct ResultSet_Index_S *ResultSet_Index_T;
+
+/**
+ * @brief Enumerates the column types returned by ResultSet_getColumnType()
+ */
+typedef enum {
+        ResultSet_Unknown = 0, /**< The type is not known or not one of the types below */
+        ResultSet_Null,        /**< SQL NULL. Only SQLite, where a value rather than a column has a type */
+        ResultSet_Integer,     /**< Integer number */
+        ResultSet_Real,        /**< Floating point number */
+        ResultSet_Text,        /**< Character string or exact decimal number */
+        ResultSet_Blob,        /**< Binary data */
+        ResultSet_Temporal     /**< Date, time or timestamp */
+} ResultSet_ColumnType;
+
+
+/**
+ * @brief A column of rows fetched by ResultSet_fetchBatch()
+ *
+ * Values are stored contiguously in the layout of the Apache Arrow columnar
+ * format. A ResultSet_Integer column has `int64_t` values and a ResultSet_Real
+ * column `double` values. ResultSet_Text and ResultSet_Blob columns have
+ * `length + 1` offsets and the value of row i is the bytes from `offsets[i]`
+ * to `offsets[i + 1]` in `data`. Text is not NUL terminated. A column where
+ * all rows so far are SQL NULL has type ResultSet_Null and no values. Temporal
+ * and unknown column types are returned as text.
+ */
+typedef struct ResultSet_Column {
+        ResultSet_ColumnType type; /**< The column type */
+        int length;                /**< The number of rows */
+        int nullCount;             /**< The number of SQL NULL values */
+        const uint8_t *validity;   /**< Bit i, least significant bit first, is set if row i is not NULL. NULL if nullCount is 0 */
+        const void *values;        /**< Values of a ResultSet_Integer or ResultSet_Real column */
+        const int32_t *offsets;    /**< Offsets into data of a ResultSet_Text or ResultSet_Blob column */
+        const char *data;          /**< Bytes of a ResultSet_Text or ResultSet_Blob column */
+} ResultSet_Column;
+
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+/*
+ * The Arrow C Data Interface, as specified at
+ * https://arrow.apache.org/docs/format/CDataInterface.html
+ */
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+        const char *format;
+        const char *name;
+        const char *metadata;
+        int64_t flags;
+        int64_t n_children;
+        struct ArrowSchema **children;
+        struct ArrowSchema *dictionary;
+        void (*release)(struct ArrowSchema *);
+        void *private_data;
+};
+
+struct ArrowArray {
+        int64_t length;
+        int64_t null_count;
+        int64_t offset;
+        int64_t n_buffers;
+        int64_t n_children;
+        const void **buffers;
+        struct ArrowArray **children;
+        struct ArrowArray *dictionary;
+        void (*release)(struct ArrowArray *);
+        void *private_data;
+};
+#endif
 
 
 //<< Protected methods
@@ -154,6 +230,90 @@ T ResultSet_new(ResultSetDelegate_T D, Rop_T op) __attribute__ ((visibility("hid
  */
 void ResultSet_free(T *R) __attribute__ ((visibility("hidden")));
 
+
+/**
+ * @brief Use a column name index owned by the caller.
+ *
+ * The by-name getters look up columns in a hash index which is built on
+ * first use. A PreparedStatement keeps the index so the next ResultSet of
+ * the statement does not build it again. The index is rebuilt if the
+ * columns changed.
+ *
+ * @param R A ResultSet object
+ * @param index The index, may point to NULL. Released by the caller with
+ * ResultSet_Index_free()
+ */
+void ResultSet_setIndex(T R, ResultSet_Index_T *index) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * @brief Destroy a column name index.
+ * @param index A column name index reference
+ */
+void ResultSet_Index_free(ResultSet_Index_T *index) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * @brief Read the remaining rows of a ResultSet into a new materialized
+ * delegate which is independent of the Connection.
+ * @param source The ResultSet to read
+ * @return A delegate for materializedrops
+ * @exception SQLException If a database access error occurs
+ */
+ResultSetDelegate_T MaterializedResultSet_new(T source) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * @brief Create a delegate reading the same rows as a materialized delegate.
+ * @param D A delegate created by MaterializedResultSet_new()
+ * @return A new delegate positioned before the first row
+ */
+ResultSetDelegate_T MaterializedResultSet_share(ResultSetDelegate_T D) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * @brief Add a SQL NULL to a column of a batch.
+ *
+ * A delegate implementing fetchBatch adds one value to each column for
+ * every row. The column type is set by the first value which is not NULL.
+ * A later value of another type converts the column, integers to real if
+ * a real is added and numbers to text if text is added.
+ *
+ * @param B A batch
+ * @param columnIndex The first column is 1, the second is 2, ...
+ */
+void ResultSet_Batch_addNull(ResultSet_Batch_T B, int columnIndex) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * @brief Add an integer to a column of a batch.
+ * @param B A batch
+ * @param columnIndex The first column is 1, the second is 2, ...
+ * @param value The value
+ */
+void ResultSet_Batch_addLLong(ResultSet_Batch_T B, int columnIndex, long long value) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * @brief Add a real to a column of a batch.
+ * @param B A batch
+ * @param columnIndex The first column is 1, the second is 2, ...
+ * @param value The value
+ */
+void ResultSet_Batch_addDouble(ResultSet_Batch_T B, int columnIndex, double value) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * @brief Add text or a blob to a column of a batch.
+ * @param B A batch
+ * @param columnIndex The first column is 1, the second is 2, ...
+ * @param type ResultSet_Text or ResultSet_Blob
+ * @param bytes The value, copied into the batch
+ * @param size The number of bytes in value
+ * @exception SQLException If the column would exceed 2GB
+ */
+void ResultSet_Batch_addBytes(ResultSet_Batch_T B, int columnIndex, ResultSet_ColumnType type, const void *bytes, int size) __attribute__ ((visibility("hidden")));
+
 //>> End Protected methods
 
 /// @name Properties
@@ -195,6 +355,25 @@ const char *ResultSet_getColumnName(T R, int columnIndex);
 long ResultSet_getColumnSize(T R, int columnIndex);
 
 
+/**
+ * @brief Gets the designated column's SQL type.
+ *
+ * Use the type to select a getter for a query where the column types are
+ * not known in advance. With SQLite the type is the storage class of the
+ * value in the current row, other databases return the type of the column.
+ * An exact decimal column, such as DECIMAL or NUMERIC, is ResultSet_Text
+ * since a double cannot hold its value.
+ *
+ * @param R A ResultSet object
+ * @param columnIndex The first column is 1, the second is 2, ...
+ * @return The column type or ResultSet_Unknown if the database does not
+ * report the type
+ * @exception SQLException If columnIndex is outside the valid range
+ * @see SQLException.h
+ */
+ResultSet_ColumnType ResultSet_getColumnType(T R, int columnIndex);
+
+
 /**
  * @brief Sets the number of rows to fetch from the database.
  *
@@ -223,6 +402,40 @@ void ResultSet_setFetchSize(T R, int rows);
  */
 int ResultSet_getFetchSize(T R);
 
+
+/**
+ * @brief Sets the memory limit for a materialized copy of this ResultSet.
+ *
+ * If the rows copied by ResultSet_materialize() take more than `bytes` of
+ * memory, the rows are moved to a temporary file and the remaining rows
+ * are written there. The file is mapped into memory and read transparently
+ * by the materialized ResultSet, so the operating system pages the rows in
+ * and out as needed. The file is deleted when created and takes no space
+ * once the materialized ResultSet is closed. The file is created in the
+ * directory named by the environment variable TMPDIR or in /tmp.
+ *
+ * @code
+ * ResultSet_T r = Connection_executeQuery(con, "SELECT * FROM orders");
+ * ResultSet_setMemoryLimit(r, 64 * 1024 * 1024);
+ * ResultSet_T report = ResultSet_materialize(r);
+ * @endcode
+ *
+ * @param R A ResultSet object
+ * @param bytes The memory limit in bytes. 0, the default, means no limit
+ * @exception AssertException If `bytes` is negative
+ * @see ResultSet_materialize
+ */
+void ResultSet_setMemoryLimit(T R, long long bytes);
+
+
+/**
+ * @brief Gets the memory limit for a materialized copy of this ResultSet.
+ * @param R A ResultSet object
+ * @return The memory limit in bytes or 0 if there is no limit
+ * @see ResultSet_setMemoryLimit
+ */
+long long ResultSet_getMemoryLimit(T R);
+
 /// @}
 /// @name Functions
 /// @{
@@ -243,6 +456,119 @@ int ResultSet_getFetchSize(T R);
  */
 bool ResultSet_next(T R);
 
+
+/**
+ * @brief Moves to the next result of a query that returned several results.
+ *
+ * A query may produce more than one result, for instance a Postgres query
+ * string with several SELECT statements separated by semicolons or a MySQL
+ * stored procedure that executes several SELECT statements. All results are
+ * returned from the server in one round trip and this method advances the
+ * ResultSet to the next one. Results without rows, such as from an INSERT
+ * or the status result of a MySQL CALL, are skipped. On success the cursor
+ * is positioned before the first row of the new result, and the number and
+ * names of columns are those of the new result. Values obtained from the
+ * previous result are no longer valid.
+ *
+ * @code
+ * ResultSet_T r = Connection_executeQuery(con, "SELECT name FROM employees; SELECT name FROM departments");
+ * do {
+ *     while (ResultSet_next(r))
+ *         printf("%s\n", ResultSet_getString(r, 1));
+ * } while (ResultSet_nextResult(r));
+ * @endcode
+ *
+ * @param R A ResultSet object
+ * @return true if the ResultSet was advanced to the next result; false if
+ * there are no more results or the database does not support multiple results
+ * @exception SQLException If a database access error occurs
+ */
+bool ResultSet_nextResult(T R);
+
+
+/**
+ * @brief Reads the remaining rows into a new ResultSet owned by the caller.
+ *
+ * The rows not yet read are copied from `R` into one compact memory arena
+ * which does not depend on the Connection. The Connection can be returned
+ * to the pool immediately while the materialized ResultSet is still used.
+ * A materialized ResultSet also supports ResultSet_seek(),
+ * ResultSet_rewind() and ResultSet_getRowCount(), so rows can be read
+ * more than once and in any order.
+ *
+ * The arena is not modified once built. Calling this method on a
+ * materialized ResultSet does not copy the rows but returns a new
+ * ResultSet, with its own cursor, reading the same arena. Give each thread
+ * its own ResultSet this way to read the rows concurrently. The arena is
+ * freed when the last ResultSet reading it is closed. Use
+ * ResultSet_setMemoryLimit() before this method to move large results to
+ * a temporary file instead of memory.
+ *
+ * @code
+ * Connection_T con = ConnectionPool_getConnection(pool);
+ * ResultSet_T r = ResultSet_materialize(Connection_executeQuery(con, "SELECT name FROM employees"));
+ * Connection_close(con);
+ * while (ResultSet_next(r))
+ *     printf("%s\n", ResultSet_getString(r, 1));
+ * ResultSet_rewind(r);
+ * ...
+ * ResultSet_close(&r);
+ * @endcode
+ *
+ * @param R A ResultSet object
+ * @return A materialized ResultSet positioned before the first row. The
+ * caller must close it with ResultSet_close()
+ * @exception SQLException If a database access error occurs
+ * @see ResultSet_close
+ */
+T ResultSet_materialize(T R);
+
+
+/**
+ * @brief Closes a ResultSet returned by ResultSet_materialize().
+ *
+ * Other ResultSets are owned by their Connection or PreparedStatement and
+ * are closed by them.
+ *
+ * @param R A reference to a materialized ResultSet object
+ * @exception AssertException If R was not returned by ResultSet_materialize()
+ */
+void ResultSet_close(T *R);
+
+
+/**
+ * @brief Moves the cursor to a row of a materialized ResultSet.
+ * @param R A ResultSet object
+ * @param row The first row is 1, the second is 2, ... Use 0 to position
+ * the cursor before the first row
+ * @return true if the cursor is on a valid row; false if `row` is 0 or
+ * beyond the last row, the cursor is then before the first or after the
+ * last row
+ * @exception SQLException If the ResultSet is not materialized
+ * @exception AssertException If `row` is negative
+ * @see ResultSet_materialize
+ */
+bool ResultSet_seek(T R, int row);
+
+
+/**
+ * @brief Moves the cursor of a materialized ResultSet before the first row.
+ * @param R A ResultSet object
+ * @exception SQLException If the ResultSet is not materialized
+ * @see ResultSet_materialize
+ */
+void ResultSet_rewind(T R);
+
+
+/**
+ * @brief Gets the number of rows in a materialized ResultSet.
+ * @param R A ResultSet object
+ * @return The number of rows or -1 if the ResultSet is not materialized
+ * and the number of rows is not known
+ * @see ResultSet_materialize
+ */
+int ResultSet_getRowCount(T R);
+
 /// @}
 /// @name Columns
 /// @{
@@ -300,6 +626,39 @@ const char *ResultSet_getString(T R, int columnIndex);
 const char *ResultSet_getStringByName(T R, const char *columnName);
 
 
+/**
+ * @brief Gets the designated column's value as a C-string and its length.
+ *
+ * Same as ResultSet_getString(), but also returns the length of the string
+ * which the database already knows, so the caller does not have to count
+ * it with strlen(3).
+ *
+ * @param R A ResultSet object
+ * @param columnIndex The first column is 1, the second is 2, ...
+ * @param size The length of the string is stored in size, 0 for SQL NULL
+ * @return The column value; if the value is SQL NULL, the value
+ * returned is NULL
+ * @exception SQLException If a database access error occurs or
+ * columnIndex is outside the valid range
+ * @see SQLException.h
+ */
+const char *ResultSet_getSString(T R, int columnIndex, int *size);
+
+
+/**
+ * @brief Gets the designated column's value as a C-string and its length.
+ * @param R A ResultSet object
+ * @param columnName The SQL name of the column. *case-sensitive*
+ * @param size The length of the string is stored in size, 0 for SQL NULL
+ * @return The column value; if the value is SQL NULL, the value
+ * returned is NULL
+ * @exception SQLException If a database access error occurs or
+ * columnName does not exist
+ * @see SQLException.h
+ */
+const char *ResultSet_getSStringByName(T R, const char *columnName, int *size);
+
+
 /**
  * @brief Gets the designated column's value as an int.
  * @param R A ResultSet object
@@ -415,6 +774,39 @@ const void *ResultSet_getBlob(T R, int columnIndex, int *size);
  */
 const void *ResultSet_getBlobByName(T R, const char *columnName, int *size);
 
+
+/**
+ * @brief Reads the next piece of the designated column's blob value into
+ * a buffer provided by the caller.
+ *
+ * Use this method to stream a large value in pieces instead of getting it
+ * whole with ResultSet_getBlob(). Each call continues where the previous
+ * call on the same column stopped and reading starts from the beginning
+ * of the value again after ResultSet_next(). With *Oracle*, LOB values are
+ * read directly from the database and are never held in memory as a whole.
+ * Other databases copy the pieces from the value returned by
+ * ResultSet_getBlob().
+ *
+ * Example:
+ * ```c
+ * char buffer[65536];
+ * int n;
+ * while ((n = ResultSet_readBlob(r, 1, buffer, sizeof(buffer))) > 0)
+ *         fwrite(buffer, 1, n, file);
+ * ```
+ *
+ * @param R A ResultSet object
+ * @param columnIndex The first column is 1, the second is 2, ...
+ * @param buffer The buffer to read into
+ * @param size The size of buffer in bytes
+ * @return The number of bytes read into buffer. 0 is returned when the
+ * whole value has been read or if the value is SQL NULL
+ * @exception SQLException If a database access error occurs or
+ * columnIndex is outside the valid range
+ * @see SQLException.h
+ */
+int ResultSet_readBlob(T R, int columnIndex, void *buffer, int size);
+
 /// @}
 /// @name Date and Time
 /// @{
@@ -545,6 +937,91 @@ struct tm ResultSet_getDateTime(T R, int columnIndex);
  */
 struct tm ResultSet_getDateTimeByName(T R, const char *columnName);
 
+/// @}
+/// @name Batches
+/// @{
+
+/**
+ * @brief Fetches the next rows into contiguous column buffers.
+ *
+ * Instead of moving through rows one at a time with ResultSet_next() and
+ * reading values with the getter methods, this method fetches up to `rows`
+ * rows at once and stores the values of each column in one array. Use
+ * ResultSet_getBatchColumn() to access a column. SQLite and PostgreSQL fill
+ * the batch directly from the statement or result. Other databases fill it
+ * from the getter methods using ResultSet_getColumnType() to select a
+ * getter. The batch is valid until the next call to this method or until
+ * the ResultSet is closed. The type of a column is set by its first value
+ * which is not NULL and kept for the next batches of the result. It only
+ * changes if a later value does not fit, an integer column becomes real and
+ * a number column becomes text.
+ *
+ * After this method the cursor is positioned on the last row fetched and
+ * batches and calls to ResultSet_next() can be mixed.
+ *
+ * @code
+ * ResultSet_T r = Connection_executeQuery(con, "SELECT id, price FROM items");
+ * int n;
+ * while ((n = ResultSet_fetchBatch(r, 1024)) > 0) {
+ *     const ResultSet_Column *price = ResultSet_getBatchColumn(r, 2);
+ *     for (int i = 0; i < n; i++)
+ *         total += price->type == ResultSet_Real ? ((double*)price->values)[i] : 0;
+ * }
+ * @endcode
+ *
+ * @param R A ResultSet object
+ * @param rows The maximum number of rows to fetch (1..INT_MAX)
+ * @return The number of rows fetched. 0 if there are no more rows
+ * @exception SQLException If a database access error occurs
+ * @exception AssertException If `rows` is less than 1
+ * @see SQLException.h
+ */
+int ResultSet_fetchBatch(T R, int rows);
+
+
+/**
+ * @brief Gets a column of the batch fetched by ResultSet_fetchBatch().
+ * @param R A ResultSet object
+ * @param columnIndex The first column is 1, the second is 2, ...
+ * @return The column. The column is valid until the next batch is fetched
+ * @exception SQLException If columnIndex is outside the valid range or if
+ * no batch was fetched
+ * @see SQLException.h
+ */
+const ResultSet_Column *ResultSet_getBatchColumn(T R, int columnIndex);
+
+
+/**
+ * @brief Exports the batch fetched by ResultSet_fetchBatch() through the
+ * Arrow C Data Interface.
+ *
+ * The batch is exported as a struct array with one child per column and a
+ * schema where children are named by the column names. Columns are mapped
+ * to the Arrow types int64, float64, utf8, binary and null. The buffers are
+ * not copied but moved to `array` and the ResultSet allocates new buffers
+ * for the next batch. Any consumer of the C Data Interface, such as
+ * pyarrow or DuckDB, can import the batch without depending on libzdb.
+ * The caller must call the release callback of both `schema` and `array`
+ * when done.
+ *
+ * @code
+ * struct ArrowSchema schema;
+ * struct ArrowArray array;
+ * while (ResultSet_fetchBatch(r, 65536) > 0) {
+ *     ResultSet_exportBatch(r, &schema, &array);
+ *     consume(&schema, &array); // Calls release
+ * }
+ * @endcode
+ *
+ * @param R A ResultSet object
+ * @param schema Set to the schema of the batch
+ * @param array Set to the data of the batch
+ * @exception SQLException If no batch was fetched or if the batch was
+ * already exported
+ * @see SQLException.h
+ */
+void ResultSet_exportBatch(T R, struct ArrowSchema *schema, struct ArrowArray *array);
+
 /// @}
 
 #undef T
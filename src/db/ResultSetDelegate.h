@@ -36,6 +36,7 @@
 
 #define T ResultSetDelegate_T
 typedef struct T *T;
+typedef struct ResultSet_Batch_S *ResultSet_Batch_T;
 
 typedef struct Rop_T {
         const char *name;
@@ -46,11 +47,21 @@ typedef struct Rop_T {
         void (*setFetchSize)(T R, int rows);
         int (*getFetchSize)(T R);
         bool (*next)(T R);
+        bool (*seek)(T R, int row);
+        int (*getRowCount)(T R);
+        bool (*nextResult)(T R);
         bool (*isnull)(T R, int columnIndex);
         const char *(*getString)(T R, int columnIndex);
+        const char *(*getSString)(T R, int columnIndex, int *size);
+        int (*getInt)(T R, int columnIndex);
+        long long (*getLLong)(T R, int columnIndex);
+        double (*getDouble)(T R, int columnIndex);
+        int (*getColumnType)(T R, int columnIndex); // A ResultSet_ColumnType
         const void *(*getBlob)(T R, int columnIndex, int *size);
+        int (*readBlob)(T R, int columnIndex, void *buffer, int size);
         time_t (*getTimestamp)(T R, int columnIndex);
         struct tm *(*getDateTime)(T R, int columnIndex, struct tm *tm);
+        int (*fetchBatch)(T R, int rows, ResultSet_Batch_T batch);
 } *Rop_T;
 
 /**
@@ -29,7 +29,12 @@
 #include <stdbool.h>
 #include "zdb.h"
 
-ResultSetDelegate_T MysqlResultSet_new(Connection_T delegator, MYSQL_STMT *stmt, int keep) __attribute__ ((visibility("hidden")));
+/* Result metadata, binds and column buffers of a statement. A prepared statement
+ owns one and lends it to each result set it produces so they are reused across
+ executions. If cache is NULL the result set owns both its columns and the stmt */
+typedef struct MysqlColumns_T *MysqlColumns_T;
+ResultSetDelegate_T MysqlResultSet_new(Connection_T delegator, MYSQL_STMT *stmt, MysqlColumns_T *cache) __attribute__ ((visibility("hidden")));
+void MysqlResultSet_freeColumns(MysqlColumns_T *columns) __attribute__ ((visibility("hidden")));
 PreparedStatementDelegate_T MysqlPreparedStatement_new(Connection_T delegator, MYSQL_STMT *stmt) __attribute__ ((visibility("hidden")));
 
 #endif
@@ -31,6 +31,7 @@
 #include <ctype.h>
 
 #include "MysqlAdapter.h"
+#include "system/Time.h"
 #include "StringBuffer.h"
 #include "ConnectionDelegate.h"
 
@@ -45,14 +46,30 @@
 /* ------------------------------------------------------------- Definitions */
 
 
+typedef struct load_t {
+        void *context;
+        int columnCount;
+        int *lengths;
+        const char **values;
+        Connection_RowSource source;
+        Connection_LoadStatistics *statistics;
+        char *row;              // Current CSV encoded row
+        int rowLength;
+        int rowOffset;
+        int rowCapacity;
+        bool done;
+        char error[STRLEN];
+} *load_t;
 #define T ConnectionDelegate_T
 struct T {
         MYSQL *db;
         int lastError;
+        load_t load;
         StringBuffer_T sb;
         Connection_T delegator;
 };
 #define MYSQL_OK 0
+#define LOCAL_INFILE_NAME "libzdb-bulk-load"
 extern const struct Rop_T mysqlrops;
 extern const struct Pop_T mysqlpops;
 
@@ -121,6 +138,10 @@ static MYSQL *_doConnect(Connection_T delegator, char **error) {
         if (timeout)
                 connectTimeout = Str_parseInt(timeout);
         mysql_options(db, MYSQL_OPT_CONNECT_TIMEOUT, (const char*)&connectTimeout);
+        if (IS(URL_getParameter(url, "local-infile"), "true")) {
+                unsigned int localInfile = 1;
+                mysql_options(db, MYSQL_OPT_LOCAL_INFILE, &localInfile);
+        }
         const char *charset = URL_getParameter(url, "charset");
         if (charset)
                 mysql_options(db, MYSQL_SET_CHARSET_NAME, charset);
@@ -161,6 +182,123 @@ static bool _prepare(T C, const char *sql, int len, MYSQL_STMT **stmt) {
 }
 
 
+/*
+ * LOAD DATA LOCAL INFILE handler. Rows are pulled from the row source and CSV
+ * encoded on the fly into the buffer provided by the mysql client library, so
+ * no temporary file is used. The handler is installed on every connection and
+ * only serves data during Connection_bulkLoad(), any other LOCAL INFILE request
+ * from the server is refused, so local files can never be read by the server.
+ */
+
+
+static inline void _appendRow(load_t L, const char *s, int n) {
+        if (L->rowLength + n > L->rowCapacity) {
+                L->rowCapacity = (L->rowLength + n) * 2;
+                RESIZE(L->row, L->rowCapacity);
+        }
+        memcpy(L->row + L->rowLength, s, n);
+        L->rowLength += n;
+}
+
+
+static void _encodeRow(load_t L) {
+        L->rowLength = L->rowOffset = 0;
+        for (int i = 0; i < L->columnCount; i++) {
+                if (i > 0)
+                        _appendRow(L, ",", 1);
+                const char *value = L->values[i];
+                if (! value) {
+                        _appendRow(L, "\\N", 2);
+                        continue;
+                }
+                int length = L->lengths[i] < 0 ? (int)strlen(value) : L->lengths[i];
+                _appendRow(L, "\"", 1);
+                for (int j = 0, k = 0; j <= length; j++) {
+                        // Flush safe runs and escape the enclosing quote, escape char and NUL
+                        if (j == length || value[j] == '"' || value[j] == '\\' || value[j] == 0) {
+                                _appendRow(L, value + k, j - k);
+                                if (j < length)
+                                        _appendRow(L, value[j] ? (char[]){'\\', value[j]} : "\\0", 2);
+                                k = j + 1;
+                        }
+                }
+                _appendRow(L, "\"", 1);
+        }
+        _appendRow(L, "\n", 1);
+}
+
+
+static bool _nextRow(load_t L) {
+        volatile bool more = false;
+        for (int i = 0; i < L->columnCount; i++) {
+                L->values[i] = NULL;
+                L->lengths[i] = -1;
+        }
+        // Exceptions cannot propagate through the mysql client library
+        TRY
+                more = L->source(L->context, L->values, L->lengths);
+        ELSE
+                snprintf(L->error, STRLEN, "%s", Exception_frame.message);
+                more = false;
+        END_TRY;
+        if (more) {
+                _encodeRow(L);
+                L->statistics->rows++;
+        }
+        return more;
+}
+
+
+static int _localInfileInit(void **ptr, const char *filename, void *userdata) {
+        T C = userdata;
+        *ptr = C;
+        return (C->load && Str_isEqual(filename, LOCAL_INFILE_NAME)) ? 0 : 1;
+}
+
+
+static int _localInfileRead(void *ptr, char *buf, unsigned int buf_len) {
+        T C = ptr;
+        load_t L = C->load;
+        if (! L)
+                return -1;
+        unsigned int n = 0;
+        while (n < buf_len) {
+                if (L->rowOffset == L->rowLength) {
+                        if (L->done || ! _nextRow(L)) {
+                                L->done = true;
+                                break;
+                        }
+                }
+                int chunk = L->rowLength - L->rowOffset;
+                if (chunk > (int)(buf_len - n))
+                        chunk = buf_len - n;
+                memcpy(buf + n, L->row + L->rowOffset, chunk);
+                L->rowOffset += chunk;
+                n += chunk;
+        }
+        if (*L->error)
+                return -1;
+        L->statistics->bytes += n;
+        return n;
+}
+
+
+static void _localInfileEnd(void *ptr) {
+        // Load state is owned and released by _bulkLoad
+        (void)ptr;
+}
+
+
+static int _localInfileError(void *ptr, char *error_msg, unsigned int error_msg_len) {
+        T C = ptr;
+        if (C && C->load && *C->load->error)
+                snprintf(error_msg, error_msg_len, "%s", C->load->error);
+        else
+                snprintf(error_msg, error_msg_len, "LOCAL INFILE is only supported via Connection_bulkLoad()");
+        return CR_UNKNOWN_ERROR;
+}
+
+
 /* -------------------------------------------------------- Delegate Methods */
 
 
@@ -175,6 +313,7 @@ static T _new(Connection_T delegator, char **error) {
         C->db = db;
         C->delegator = delegator;
         C->sb = StringBuffer_create(STRLEN);
+        mysql_set_local_infile_handler(C->db, _localInfileInit, _localInfileRead, _localInfileEnd, _localInfileError, C);
         return C;
 }
 
@@ -279,7 +418,7 @@ static ResultSet_T _executeQuery(T C, const char *sql, va_list ap) {
                         StringBuffer_set(C->sb, "%s", mysql_stmt_error(stmt));
                         mysql_stmt_close(stmt);
                 } else
-                        return ResultSet_new(MysqlResultSet_new(C->delegator, stmt, false), (Rop_T)&mysqlrops);
+                        return ResultSet_new(MysqlResultSet_new(C->delegator, stmt, NULL), (Rop_T)&mysqlrops);
         }
         return NULL;
 }
@@ -299,6 +438,41 @@ static PreparedStatement_T _prepareStatement(T C, const char *sql, va_list ap) {
 }
 
 
+static bool _bulkLoad(T C, const char *table, const char **columns, Connection_RowSource source, void *context, Connection_LoadStatistics *statistics) {
+        assert(C);
+        struct load_t load = {.source = source, .context = context, .statistics = statistics};
+        StringBuffer_set(C->sb, "LOAD DATA LOCAL INFILE '" LOCAL_INFILE_NAME "' INTO TABLE %s "
+                         "FIELDS TERMINATED BY ',' OPTIONALLY ENCLOSED BY '\"' ESCAPED BY '\\\\' "
+                         "LINES TERMINATED BY '\\n' (", table);
+        for (; columns[load.columnCount]; load.columnCount++)
+                StringBuffer_append(C->sb, "%s%s", load.columnCount ? ", " : "", columns[load.columnCount]);
+        StringBuffer_append(C->sb, ")");
+        load.values = CALLOC(load.columnCount, sizeof(char *));
+        load.lengths = CALLOC(load.columnCount, sizeof(int));
+        load.rowCapacity = STRLEN;
+        load.row = ALLOC(load.rowCapacity);
+        long long start = Time_milli();
+        C->load = &load;
+        C->lastError = mysql_real_query(C->db, StringBuffer_toString(C->sb), StringBuffer_length(C->sb));
+        C->load = NULL;
+        statistics->elapsed = Time_milli() - start;
+        if (C->lastError == MYSQL_OK) {
+                statistics->loaded = (long long)mysql_affected_rows(C->db);
+                statistics->warnings = mysql_warning_count(C->db);
+                const char *info = mysql_info(C->db);
+                long long records = 0, deleted = 0;
+                if (info)
+                        sscanf(info, "Records: %lld Deleted: %lld Skipped: %lld", &records, &deleted, &statistics->skipped);
+        } else if (*load.error) {
+                StringBuffer_set(C->sb, "%s", load.error);
+        }
+        FREE(load.row);
+        FREE(load.values);
+        FREE(load.lengths);
+        return (C->lastError == MYSQL_OK);
+}
+
+
 static const char *_getLastError(T C) {
         assert(C);
         if (mysql_errno(C->db))
@@ -324,6 +498,7 @@ const struct Cop_T mysqlcops = {
         .execute	        = _execute,
         .executeQuery           = _executeQuery,
         .prepareStatement       = _prepareStatement,
+        .bulkLoad               = _bulkLoad,
         .getLastError           = _getLastError
 };
 
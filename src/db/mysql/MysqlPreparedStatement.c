@@ -54,10 +54,14 @@ typedef struct param_t {
 #define T PreparedStatementDelegate_T
 struct T {
         int lastError;
+        bool needRebind;
+        bool needReset;
         param_t params;
         MYSQL_STMT *stmt;
         MYSQL_BIND *bind;
+        MysqlColumns_T columns;
         int parameterCount;
+        unsigned long cursorType;
         Connection_T delegator;
 };
 #if MYSQL_VERSION_ID < 80000 || MARIADB_VERSION_ID
@@ -68,6 +72,53 @@ static bool yes = true;
 extern const struct Rop_T mysqlrops;
 
 
+/* --------------------------------------------------------- Private methods */
+
+
+/* Update a parameter binding. mysql_stmt_bind_param() is only called again if
+ the layout (type, buffer or null indicator) of a parameter changed, values are
+ read from the bound buffers at execute time */
+static inline void _bind(T P, int i, enum enum_field_types type, void *buffer, void *is_null) {
+        MYSQL_BIND *b = &P->bind[i];
+        if (b->buffer_type != type || b->buffer != buffer || (void*)b->is_null != is_null) {
+                b->buffer_type = type;
+                b->buffer = buffer;
+                b->is_null = is_null;
+                P->needRebind = true;
+        }
+}
+
+
+/* Only set the cursor type statement attribute if it differs from the current */
+static inline void _setCursorType(T P, bool readOnly) {
+#if MYSQL_VERSION_ID >= 50002
+        unsigned long cursorType = readOnly ? CURSOR_TYPE_READ_ONLY : CURSOR_TYPE_NO_CURSOR;
+        if (P->cursorType != cursorType) {
+                if ((P->lastError = mysql_stmt_attr_set(P->stmt, STMT_ATTR_CURSOR_TYPE, &cursorType)))
+                        THROW(SQLException, "%s", mysql_stmt_error(P->stmt));
+                P->cursorType = cursorType;
+        }
+#endif
+}
+
+
+/* Prepare the statement for execution. A COM_STMT_RESET round trip to the server
+ is only done if the statement was left in an unknown state by a previous error */
+static void _prepareExecute(T P, bool readOnlyCursor) {
+        if (P->needReset) {
+                if ((P->lastError = mysql_stmt_reset(P->stmt)))
+                        THROW(SQLException, "%s", mysql_stmt_error(P->stmt));
+                P->needReset = false;
+        }
+        if (P->needRebind) {
+                if ((P->lastError = mysql_stmt_bind_param(P->stmt, P->bind)))
+                        THROW(SQLException, "%s", mysql_stmt_error(P->stmt));
+                P->needRebind = false;
+        }
+        _setCursorType(P, readOnlyCursor);
+}
+
+
 /* ------------------------------------------------------------- Constructor */
 
 
@@ -82,7 +133,13 @@ T MysqlPreparedStatement_new(Connection_T delegator, MYSQL_STMT *stmt) {
         if (P->parameterCount > 0) {
                 P->params = CALLOC(P->parameterCount, sizeof(struct param_t));
                 P->bind = CALLOC(P->parameterCount, sizeof(MYSQL_BIND));
+                for (int i = 0; i < P->parameterCount; i++)
+                        P->bind[i].length = &P->params[i].length;
+                P->needRebind = true;
         }
+#if MYSQL_VERSION_ID >= 50002
+        P->cursorType = CURSOR_TYPE_NO_CURSOR; // Server default for a new statement
+#endif
         P->lastError = MYSQL_OK;
         return P;
 }
@@ -94,6 +151,7 @@ T MysqlPreparedStatement_new(Connection_T delegator, MYSQL_STMT *stmt) {
 static void _free(T *P) {
 	assert(P && *P);
         FREE((*P)->bind);
+        MysqlResultSet_freeColumns(&(*P)->columns);
         mysql_stmt_free_result((*P)->stmt);
 #if MYSQL_VERSION_ID >= 50503
         /* In case the statement returns multiple result sets or in a stored procedure case,
@@ -109,16 +167,8 @@ static void _free(T *P) {
 static void _setString(T P, int parameterIndex, const char *x, int size) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
-        P->bind[i].buffer_type = MYSQL_TYPE_STRING;
-        P->bind[i].buffer = (char*)x;
-        if (size > 0) {
-                P->params[i].length = size;
-                P->bind[i].is_null = 0;
-        } else {
-                P->params[i].length = 0;
-                P->bind[i].is_null = &yes;
-        }
-        P->bind[i].length = &P->params[i].length;
+        P->params[i].length = size > 0 ? size : 0;
+        _bind(P, i, MYSQL_TYPE_STRING, (char*)x, size > 0 ? NULL : &yes);
 }
 
 
@@ -126,9 +176,7 @@ static void _setInt(T P, int parameterIndex, int x) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
         P->params[i].type.integer = x;
-        P->bind[i].buffer_type = MYSQL_TYPE_LONG;
-        P->bind[i].buffer = &P->params[i].type.integer;
-        P->bind[i].is_null = 0;
+        _bind(P, i, MYSQL_TYPE_LONG, &P->params[i].type.integer, NULL);
 }
 
 
@@ -136,9 +184,7 @@ static void _setLLong(T P, int parameterIndex, long long x) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
         P->params[i].type.llong = x;
-        P->bind[i].buffer_type = MYSQL_TYPE_LONGLONG;
-        P->bind[i].buffer = &P->params[i].type.llong;
-        P->bind[i].is_null = 0;
+        _bind(P, i, MYSQL_TYPE_LONGLONG, &P->params[i].type.llong, NULL);
 }
 
 
@@ -146,9 +192,7 @@ static void _setDouble(T P, int parameterIndex, double x) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
         P->params[i].type.real = x;
-        P->bind[i].buffer_type = MYSQL_TYPE_DOUBLE;
-        P->bind[i].buffer = &P->params[i].type.real;
-        P->bind[i].is_null = 0;
+        _bind(P, i, MYSQL_TYPE_DOUBLE, &P->params[i].type.real, NULL);
 }
 
 
@@ -163,61 +207,38 @@ static void _setTimestamp(T P, int parameterIndex, time_t x) {
         P->params[i].type.timestamp.hour = ts.tm_hour;
         P->params[i].type.timestamp.minute = ts.tm_min;
         P->params[i].type.timestamp.second = ts.tm_sec;
-        P->bind[i].buffer_type = MYSQL_TYPE_TIMESTAMP;
-        P->bind[i].buffer = &P->params[i].type.timestamp;
-        P->bind[i].is_null = 0;
+        _bind(P, i, MYSQL_TYPE_TIMESTAMP, &P->params[i].type.timestamp, NULL);
 }
 
 
 static void _setBlob(T P, int parameterIndex, const void *x, int size) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
-        P->bind[i].buffer_type = MYSQL_TYPE_BLOB;
-        P->bind[i].buffer = (void*)x;
-        if (size > 0) {
-                P->params[i].length = size;
-                P->bind[i].is_null = 0;
-        } else {
-                P->params[i].length = 0;
-                P->bind[i].is_null = &yes;
-        }
-        P->bind[i].length = &P->params[i].length;
+        P->params[i].length = size > 0 ? size : 0;
+        _bind(P, i, MYSQL_TYPE_BLOB, (void*)x, size > 0 ? NULL : &yes);
 }
 
 
 static void _execute(T P) {
         assert(P);
-        if (P->parameterCount > 0) {
-                if ((P->lastError = mysql_stmt_bind_param(P->stmt, P->bind)))
-                        THROW(SQLException, "%s", mysql_stmt_error(P->stmt));
-        }
-#if MYSQL_VERSION_ID >= 50002
-        unsigned long cursor = CURSOR_TYPE_NO_CURSOR;
-        mysql_stmt_attr_set(P->stmt, STMT_ATTR_CURSOR_TYPE, &cursor);
-#endif
-        if ((P->lastError = mysql_stmt_execute(P->stmt)))
+        _prepareExecute(P, false);
+        if ((P->lastError = mysql_stmt_execute(P->stmt))) {
+                P->needReset = true;
                 THROW(SQLException, "%s", mysql_stmt_error(P->stmt));
-        if (P->lastError == MYSQL_OK) {
-                /* Discard prepared param data in client/server */
-                P->lastError = mysql_stmt_reset(P->stmt);
         }
+        /* If the statement produced a result set (e.g. a stored procedure), discard
+         it client side so the statement can be executed again without a reset */
+        if (mysql_stmt_field_count(P->stmt) > 0)
+                mysql_stmt_free_result(P->stmt);
 }
 
 
 static ResultSet_T _executeQuery(T P) {
         assert(P);
-        if (P->parameterCount > 0) {
-                if ((P->lastError = mysql_stmt_bind_param(P->stmt, P->bind)))
-                        THROW(SQLException, "%s", mysql_stmt_error(P->stmt));
-        }
-#if MYSQL_VERSION_ID >= 50002
-        unsigned long cursor = CURSOR_TYPE_READ_ONLY;
-        mysql_stmt_attr_set(P->stmt, STMT_ATTR_CURSOR_TYPE, &cursor);
-#endif
-        if ((P->lastError = mysql_stmt_execute(P->stmt)))
-                THROW(SQLException, "%s", mysql_stmt_error(P->stmt));
-        if (P->lastError == MYSQL_OK)
-                return ResultSet_new(MysqlResultSet_new(P->delegator, P->stmt, true), (Rop_T)&mysqlrops);
+        _prepareExecute(P, true);
+        if ((P->lastError = mysql_stmt_execute(P->stmt)) == MYSQL_OK)
+                return ResultSet_new(MysqlResultSet_new(P->delegator, P->stmt, &P->columns), (Rop_T)&mysqlrops);
+        P->needReset = true;
         THROW(SQLException, "%s", mysql_stmt_error(P->stmt));
         return NULL;
 }
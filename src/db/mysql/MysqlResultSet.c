@@ -54,6 +54,12 @@ typedef struct column_t {
         MYSQL_FIELD *field;
         unsigned long real_length;
 } *column_t;
+struct MysqlColumns_T {
+        int columnCount;
+        MYSQL_RES *meta;
+        MYSQL_BIND *bind;
+        column_t columns;
+};
 #define T ResultSetDelegate_T
 struct T {
         int stop;
@@ -68,6 +74,8 @@ struct T {
         MYSQL_BIND *bind;
         MYSQL_STMT *stmt;
         column_t columns;
+        bool ownsColumns;
+        MysqlColumns_T cache;
         Connection_T delegator;
 };
 
@@ -89,38 +97,88 @@ static inline void _ensureCapacity(T R, int i) {
 static void _setFetchSize(T R, int rows);
 
 
+static MysqlColumns_T _newColumns(MYSQL_RES *meta, int columnCount) {
+        if (! meta)
+                return NULL;
+        MysqlColumns_T C;
+        NEW(C);
+        C->meta = meta;
+        C->columnCount = columnCount;
+        C->bind = CALLOC(columnCount, sizeof (MYSQL_BIND));
+        C->columns = CALLOC(columnCount, sizeof (struct column_t));
+        for (int i = 0; i < columnCount; i++) {
+                C->columns[i].buffer = ALLOC(STRLEN + 1);
+                C->bind[i].buffer_type = MYSQL_TYPE_STRING;
+                C->bind[i].buffer = C->columns[i].buffer;
+                C->bind[i].buffer_length = STRLEN;
+                C->bind[i].is_null = &C->columns[i].is_null;
+                C->bind[i].length = &C->columns[i].real_length;
+                C->columns[i].field = mysql_fetch_field_direct(meta, i);
+        }
+        return C;
+}
+
+
+/* Cached columns are valid if the result metadata has the same column names and
+ types. The metadata changes if the statement was re-prepared after a schema change */
+static bool _isValid(MysqlColumns_T C, MYSQL_RES *meta, int columnCount) {
+        if (! C || ! meta || C->columnCount != columnCount || (int)mysql_num_fields(meta) != columnCount)
+                return false;
+        for (int i = 0; i < columnCount; i++) {
+                MYSQL_FIELD *field = mysql_fetch_field_direct(meta, i);
+                MYSQL_FIELD *cached = C->columns[i].field;
+                if (field->type != cached->type || field->flags != cached->flags || ! Str_isByteEqual(field->name, cached->name))
+                        return false;
+        }
+        return true;
+}
+
+
+/* Bind result buffers of R->cache. Binding is client side only and is redone for
+ each result as a previous execution or result may have altered the stmt */
+static void _bindColumns(T R) {
+        if (! R->cache) {
+                DEBUG("Warning: column error - %s\n", mysql_stmt_error(R->stmt));
+                R->stop = true;
+        } else {
+                R->meta = R->cache->meta;
+                R->bind = R->cache->bind;
+                R->columns = R->cache->columns;
+                if ((R->lastError = mysql_stmt_bind_result(R->stmt, R->bind))) {
+                        DEBUG("Error: bind - %s\n", mysql_stmt_error(R->stmt));
+                        R->stop = true;
+                }
+        }
+}
+
+
 /* ------------------------------------------------------------- Constructor */
 
 
-T MysqlResultSet_new(Connection_T delegator, MYSQL_STMT *stmt, int keep) {
+T MysqlResultSet_new(Connection_T delegator, MYSQL_STMT *stmt, MysqlColumns_T *cache) {
         T R;
         assert(stmt);
         NEW(R);
         R->stmt = stmt;
-        R->keep = keep;
+        R->keep = (cache != NULL);
         R->delegator = delegator;
         R->maxRows = Connection_getMaxRows(R->delegator);
         R->columnCount = mysql_stmt_field_count(R->stmt);
-        if ((R->columnCount <= 0) || ! (R->meta = mysql_stmt_result_metadata(R->stmt))) {
-                DEBUG("Warning: column error - %s\n", mysql_stmt_error(stmt));
-                R->stop = true;
-        } else {
-                R->bind = CALLOC(R->columnCount, sizeof (MYSQL_BIND));
-                R->columns = CALLOC(R->columnCount, sizeof (struct column_t));
-                for (int i = 0; i < R->columnCount; i++) {
-                        R->columns[i].buffer = ALLOC(STRLEN + 1);
-                        R->bind[i].buffer_type = MYSQL_TYPE_STRING;
-                        R->bind[i].buffer = R->columns[i].buffer;
-                        R->bind[i].buffer_length = STRLEN;
-                        R->bind[i].is_null = &R->columns[i].is_null;
-                        R->bind[i].length = &R->columns[i].real_length;
-                        R->columns[i].field = mysql_fetch_field_direct(R->meta, i);
-                }
-                if ((R->lastError = mysql_stmt_bind_result(R->stmt, R->bind))) {
-                        DEBUG("Error: bind - %s\n", mysql_stmt_error(stmt));
-                        R->stop = true;
+        if (R->columnCount > 0) {
+                MYSQL_RES *meta = mysql_stmt_result_metadata(stmt);
+                if (cache && _isValid(*cache, meta, R->columnCount)) {
+                        mysql_free_result(meta);
+                        R->cache = *cache;
+                } else {
+                        R->cache = _newColumns(meta, R->columnCount);
+                        if (cache) {
+                                MysqlResultSet_freeColumns(cache);
+                                *cache = R->cache;
+                        }
                 }
         }
+        R->ownsColumns = (cache == NULL);
+        _bindColumns(R);
         if (!R->stop) {
                 _setFetchSize(R, Connection_getFetchSize(R->delegator));
         }
@@ -128,20 +186,36 @@ T MysqlResultSet_new(Connection_T delegator, MYSQL_STMT *stmt, int keep) {
 }
 
 
+void MysqlResultSet_freeColumns(MysqlColumns_T *C) {
+        assert(C);
+        if (*C) {
+                for (int i = 0; i < (*C)->columnCount; i++)
+                        FREE((*C)->columns[i].buffer);
+                if ((*C)->meta)
+                        mysql_free_result((*C)->meta);
+                FREE((*C)->columns);
+                FREE((*C)->bind);
+                FREE(*C);
+        }
+}
+
+
 /* -------------------------------------------------------- Delegate Methods */
 
 
 static void _free(T *R) {
 	assert(R && *R);
-        for (int i = 0; i < (*R)->columnCount; i++)
-                FREE((*R)->columns[i].buffer);
         mysql_stmt_free_result((*R)->stmt);
+#if MYSQL_VERSION_ID >= 50503
+        // Discard results not visited with nextResult so the stmt can be executed again
+        while (mysql_stmt_next_result((*R)->stmt) == 0)
+                mysql_stmt_free_result((*R)->stmt);
+#endif
+        // Columns of the first result are owned by the prepared statement if kept
+        if ((*R)->ownsColumns)
+                MysqlResultSet_freeColumns(&(*R)->cache);
         if ((*R)->keep == false)
                 mysql_stmt_close((*R)->stmt);
-        if ((*R)->meta)
-                mysql_free_result((*R)->meta);
-        FREE((*R)->columns);
-        FREE((*R)->bind);
 	FREE(*R);
 }
 
@@ -229,6 +303,58 @@ static const char *_getString(T R, int columnIndex) {
 }
 
 
+static const char *_getSString(T R, int columnIndex, int *size) {
+        const char *s = _getString(R, columnIndex);
+        *size = s ? (int)R->columns[columnIndex - 1].real_length : 0;
+        return s;
+}
+
+
+static int _getColumnType(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        MYSQL_FIELD *field = R->columns[i].field;
+        switch (field->type) {
+                case MYSQL_TYPE_TINY:
+                case MYSQL_TYPE_SHORT:
+                case MYSQL_TYPE_INT24:
+                case MYSQL_TYPE_LONG:
+                case MYSQL_TYPE_YEAR:
+                        return ResultSet_Integer;
+                case MYSQL_TYPE_LONGLONG:
+                        // BIGINT UNSIGNED may exceed LLONG_MAX
+                        return field->flags & UNSIGNED_FLAG ? ResultSet_Text : ResultSet_Integer;
+                case MYSQL_TYPE_FLOAT:
+                case MYSQL_TYPE_DOUBLE:
+                        return ResultSet_Real;
+                case MYSQL_TYPE_DECIMAL:
+                case MYSQL_TYPE_NEWDECIMAL:
+                        // Exact and may not fit a double
+                        return ResultSet_Text;
+                case MYSQL_TYPE_DATE:
+                case MYSQL_TYPE_TIME:
+                case MYSQL_TYPE_DATETIME:
+                case MYSQL_TYPE_TIMESTAMP:
+                        return ResultSet_Temporal;
+                case MYSQL_TYPE_NULL:
+                        return ResultSet_Null;
+                case MYSQL_TYPE_BIT:
+                        return ResultSet_Blob;
+                case MYSQL_TYPE_TINY_BLOB:
+                case MYSQL_TYPE_MEDIUM_BLOB:
+                case MYSQL_TYPE_LONG_BLOB:
+                case MYSQL_TYPE_BLOB:
+                case MYSQL_TYPE_STRING:
+                case MYSQL_TYPE_VAR_STRING:
+                case MYSQL_TYPE_VARCHAR:
+                        // Binary strings and blobs have the binary character set
+                        return field->charsetnr == 63 ? ResultSet_Blob : ResultSet_Text;
+                default:
+                        return ResultSet_Unknown;
+        }
+}
+
+
 static const void *_getBlob(T R, int columnIndex, int *size) {
         assert(R);
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
@@ -240,6 +366,35 @@ static const void *_getBlob(T R, int columnIndex, int *size) {
 }
 
 
+static bool _nextResult(T R) {
+        assert(R);
+#if MYSQL_VERSION_ID >= 50503
+        int status;
+        mysql_stmt_free_result(R->stmt);
+        while ((status = mysql_stmt_next_result(R->stmt)) == 0) {
+                int columnCount = mysql_stmt_field_count(R->stmt);
+                // Skip results without columns, such as the status result of a CALL
+                if (columnCount > 0) {
+                        if (R->ownsColumns)
+                                MysqlResultSet_freeColumns(&R->cache);
+                        R->cache = _newColumns(mysql_stmt_result_metadata(R->stmt), columnCount);
+                        R->ownsColumns = true;
+                        R->columnCount = columnCount;
+                        R->currentRow = 0;
+                        R->needRebind = false;
+                        R->stop = false;
+                        _bindColumns(R);
+                        return ! R->stop;
+                }
+        }
+        R->stop = true;
+        if (status > 0)
+                THROW(SQLException, "mysql_stmt_next_result -- %s", mysql_stmt_error(R->stmt));
+#endif
+        return false;
+}
+
+
 /* ------------------------------------------------------------------------- */
 
 
@@ -252,8 +407,11 @@ const struct Rop_T mysqlrops = {
         .setFetchSize   = _setFetchSize,
         .getFetchSize   = _getFetchSize,
         .next           = _next,
+        .nextResult     = _nextResult,
         .isnull         = _isnull,
         .getString      = _getString,
+        .getSString     = _getSString,
+        .getColumnType  = _getColumnType,
         .getBlob        = _getBlob
         // getTimestamp and getDateTime is handled in ResultSet
 };
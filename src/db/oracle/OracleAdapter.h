@@ -49,7 +49,10 @@ static void *FUNCNAME(void *args) {       \
 
 const char *OraclePreparedStatement_getLastError(int err, OCIError *errhp) __attribute__ ((visibility("hidden")));
 
-ResultSetDelegate_T OracleResultSet_new(Connection_T delegator, OCIStmt *stmt, OCIEnv *env, OCISession* usr, OCIError *err, OCISvcCtx *svc, int need_free) __attribute__ ((visibility("hidden")));
+typedef struct OracleColumns_T *OracleColumns_T;
+
+ResultSetDelegate_T OracleResultSet_new(Connection_T delegator, OCIStmt *stmt, OCIEnv *env, OCISession* usr, OCIError *err, OCISvcCtx *svc, int need_free, OracleColumns_T *cache) __attribute__ ((visibility("hidden")));
+void OracleResultSet_freeColumns(OracleColumns_T *columns) __attribute__ ((visibility("hidden")));
 PreparedStatementDelegate_T OraclePreparedStatement_new(Connection_T delegator, OCIStmt *stmt, OCIEnv *env, OCISession* usr, OCIError *err, OCISvcCtx *svc) __attribute__ ((visibility("hidden")));
 
 #endif
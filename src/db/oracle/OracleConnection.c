@@ -47,10 +47,19 @@
 
 
 #define ERB_SIZE 152
+#define STATEMENT_CACHE_SIZE 20
 #define ORACLE_TRANSACTION_PERIOD 10 // 10-second timeout (though not used with OCI_TRANS_NEW)
+typedef struct spool_t {
+        OCIEnv*        env;
+        OCIError*      err;
+        OCISPool*      spool;
+        OraText*       name;
+        ub4            nameLength;
+} *spool_t;
 #define T ConnectionDelegate_T
 struct T {
         Connection_T   delegator;
+        spool_t        spool;
         OCIEnv*        env;
         OCIError*      err;
         OCISvcCtx*     svc;
@@ -109,13 +118,142 @@ static const char *_getErrorDescription(T C) {
 }
 
 
+/* Build the Oracle connect string on the form: //host[:port]/service name */
+static void _connectString(URL_T url, StringBuffer_T sb) {
+        const char *servicename = URL_getPath(url) + 1;
+        StringBuffer_clear(sb);
+        if (URL_getHost(url)) {
+                StringBuffer_append(sb, "//%s", URL_getHost(url));
+                if (URL_getPort(url) > 0)
+                        StringBuffer_append(sb, ":%d", URL_getPort(url));
+                StringBuffer_append(sb, "/%s", servicename);
+        } else /* Or just service name */
+                StringBuffer_append(sb, "%s", servicename);
+}
+
+
+static void _freeSessionPool(void *state) {
+        spool_t S = state;
+        if (S->spool) {
+                OCISessionPoolDestroy(S->spool, S->err, OCI_SPD_FORCE);
+                OCIHandleFree(S->spool, OCI_HTYPE_SPOOL);
+        }
+        if (S->env)
+                OCIHandleFree(S->env, OCI_HTYPE_ENV);
+        FREE(S);
+}
+
+
+/* Create the OCI environment and session pool shared by all connections in the
+ libzdb pool. The session pool is sized after the libzdb pool */
+static void *_newSessionPool(ConnectionPool_T pool, char **error) {
+        spool_t S;
+        sword status;
+        StringBuffer_T sb;
+        URL_T url = ConnectionPool_getURL(pool);
+        const char *username = URL_getUser(url) ? URL_getUser(url) : URL_getParameter(url, "user");
+        const char *password = URL_getPassword(url) ? URL_getPassword(url) : URL_getParameter(url, "password");
+        NEW(S);
+        if (OCIEnvCreate(&S->env, OCI_THREADED | OCI_OBJECT | OCI_NCHAR_LITERAL_REPLACE_ON, 0, 0, 0, 0, 0, 0)) {
+                *error = Str_dup("Create a OCI environment failed");
+                goto error;
+        }
+        if (OCI_SUCCESS != OCIHandleAlloc(S->env, (dvoid**)&S->err, OCI_HTYPE_ERROR, 0, 0)) {
+                *error = Str_dup("Allocating error handler failed");
+                goto error;
+        }
+        if (OCI_SUCCESS != OCIHandleAlloc(S->env, (dvoid**)&S->spool, OCI_HTYPE_SPOOL, 0, 0)) {
+                *error = Str_dup("Allocating session pool handle failed");
+                goto error;
+        }
+        sb = StringBuffer_create(STRLEN);
+        _connectString(url, sb);
+        status = OCISessionPoolCreate(S->env, S->err, S->spool, &S->name, &S->nameLength,
+                                      (const OraText *)StringBuffer_toString(sb), StringBuffer_length(sb),
+                                      ConnectionPool_getInitialConnections(pool), ConnectionPool_getMaxConnections(pool), 1,
+                                      (OraText *)username, (ub4)strlen(username), (OraText *)password, (ub4)strlen(password),
+                                      OCI_SPC_HOMOGENEOUS);
+        StringBuffer_free(&sb);
+        if (status != OCI_SUCCESS && status != OCI_SUCCESS_WITH_INFO) {
+                *error = Str_dup(OraclePreparedStatement_getLastError(status, S->err));
+                OCIHandleFree(S->spool, OCI_HTYPE_SPOOL);
+                S->spool = NULL;
+                goto error;
+        }
+        return S;
+error:
+        _freeSessionPool(S);
+        return NULL;
+}
+
+
+/* Enable the OCI client-side statement cache of the session. A statement prepared
+ with OCIStmtPrepare2 is then found in the cache by its SQL text and not parsed again */
+static bool _setStatementCache(T C, char **error) {
+        URL_T url = Connection_getURL(C->delegator);
+        ub4 size = STATEMENT_CACHE_SIZE;
+        const char *cacheSize = URL_getParameter(url, "statement-cache");
+        if (cacheSize) {
+                int n = Str_parseInt(cacheSize);
+                if (n < 0) {
+                        *error = Str_dup("invalid statement-cache size");
+                        return false;
+                }
+                size = n;
+        }
+        C->lastError = OCIAttrSet(C->svc, OCI_HTYPE_SVCCTX, &size, 0, OCI_ATTR_STMTCACHESIZE, C->err);
+        if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO) {
+                *error = Str_dup(_getErrorDescription(C));
+                return false;
+        }
+        return true;
+}
+
+
+/* Prepare the SQL statement in C->sb, from the statement cache if found there */
+static OCIStmt *_prepare(T C) {
+        OCIStmt *stmtp = NULL;
+        C->lastError = OCIStmtPrepare2(C->svc, &stmtp, C->err, (const OraText *)StringBuffer_toString(C->sb), StringBuffer_length(C->sb), NULL, 0, OCI_NTV_SYNTAX, OCI_DEFAULT);
+        if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO) {
+                // Do not keep a statement that failed to prepare in the cache
+                if (stmtp)
+                        OCIStmtRelease(stmtp, C->err, NULL, 0, OCI_STRLS_CACHE_DELETE);
+                return NULL;
+        }
+        return stmtp;
+}
+
+
+/* Get a session from the shared OCI session pool instead of attaching to the
+ server and beginning a session of our own */
+static bool _doConnectFromPool(T C, char **error) {
+#define ERROR(e) do {*error = Str_dup(e); return false;} while (0)
+#define ORAERROR(e) do{ *error = Str_dup(_getErrorDescription(e)); return false;} while(0)
+        C->spool = ConnectionPool_getSharedState(Connection_getPool(C->delegator), _newSessionPool, _freeSessionPool, error);
+        if (! C->spool)
+                return false;
+        C->env = C->spool->env;
+        if (OCI_SUCCESS != OCIHandleAlloc(C->env, (dvoid**)&C->err, OCI_HTYPE_ERROR, 0, 0))
+                ERROR("Allocating error handler failed");
+        C->lastError = OCISessionGet(C->env, C->err, &C->svc, NULL, C->spool->name, C->spool->nameLength, NULL, 0, NULL, NULL, NULL, OCI_SESSGET_SPOOL);
+        if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO) {
+                C->svc = NULL;
+                ORAERROR(C);
+        }
+        C->lastError = OCIAttrGet(C->svc, OCI_HTYPE_SVCCTX, &C->usr, NULL, OCI_ATTR_SESSION, C->err);
+        if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO)
+                ORAERROR(C);
+        return _setStatementCache(C, error);
+#undef ERROR
+#undef ORAERROR
+}
+
+
 static bool _doConnect(T C, char**  error) {
 #define ERROR(e) do {*error = Str_dup(e); return false;} while (0)
 #define ORAERROR(e) do{ *error = Str_dup(_getErrorDescription(e)); return false;} while(0)
         URL_T url = Connection_getURL(C->delegator);
         const char *servicename, *username, *password;
-        const char *host = URL_getHost(url);
-        int port = URL_getPort(url);
         if (! (username = URL_getUser(url)))
                 if (! (username = URL_getParameter(url, "user")))
                         ERROR("no username specified in URL");
@@ -125,6 +263,19 @@ static bool _doConnect(T C, char**  error) {
         if (! (servicename = URL_getPath(url)))
                 ERROR("no Service Name specified in URL");
         ++servicename;
+        // Set Connection ResultSet fetch size if found in URL
+        const char *fetchSize = URL_getParameter(url, "fetch-size");
+        if (fetchSize) {
+                int rows = Str_parseInt(fetchSize);
+                if (rows < 1)
+                        ERROR("invalid fetch-size");
+                Connection_setFetchSize(C->delegator, rows);
+        }
+        if (IS(URL_getParameter(url, "session-pool"), "true")) {
+                if (IS(URL_getParameter(url, "sysdba"), "true"))
+                        ERROR("sysdba cannot be used with session-pool");
+                return _doConnectFromPool(C, error);
+        }
         /* Create a thread-safe OCI environment with N' substitution turned on. */
         if (OCIEnvCreate(&C->env, OCI_THREADED | OCI_OBJECT | OCI_NCHAR_LITERAL_REPLACE_ON, 0, 0, 0, 0, 0, 0))
                 ERROR("Create a OCI environment failed");
@@ -137,23 +288,7 @@ static bool _doConnect(T C, char**  error) {
         /* allocate a service handle */
         if (OCI_SUCCESS != OCIHandleAlloc(C->env, (dvoid**)&C->svc, OCI_HTYPE_SVCCTX, 0, 0))
                 ERROR("Allocating service handle failed");
-        StringBuffer_clear(C->sb);
-        /* Oracle connect string is on the form: //host[:port]/service name */
-        if (host) {
-                StringBuffer_append(C->sb, "//%s", host);
-                if (port > 0)
-                        StringBuffer_append(C->sb, ":%d", port);
-                StringBuffer_append(C->sb, "/%s", servicename);
-        } else /* Or just service name */
-                StringBuffer_append(C->sb, "%s", servicename);
-        // Set Connection ResultSet fetch size if found in URL
-        const char *fetchSize = URL_getParameter(url, "fetch-size");
-        if (fetchSize) {
-                int rows = Str_parseInt(fetchSize);
-                if (rows < 1)
-                        ERROR("invalid fetch-size");
-                Connection_setFetchSize(C->delegator, rows);
-        }
+        _connectString(url, C->sb);
         /* Create a server context */
         C->lastError = OCIServerAttach(C->srv, C->err, StringBuffer_toString(C->sb), StringBuffer_length(C->sb), OCI_DEFAULT);
         if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO)
@@ -179,7 +314,7 @@ static bool _doConnect(T C, char**  error) {
         if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO)
                 ORAERROR(C);
         OCIAttrSet(C->svc, OCI_HTYPE_SVCCTX, C->usr, 0, OCI_ATTR_SESSION, C->err);
-        return true;
+        return _setStatementCache(C, error);
 }
 
 
@@ -195,6 +330,23 @@ static const char *_getLastError(T C) {
 
 static void _free(T* C) {
         assert(C && *C);
+        if ((*C)->spool) {
+                // Return the session to the shared pool. The environment is owned by the pool
+                if ((*C)->svc) {
+                        OCISvcCtx *svc = (*C)->svc;
+                        (*C)->svc = NULL;
+                        if ((*C)->watchdog)
+                                Thread_join((*C)->watchdog);
+                        OCISessionRelease(svc, (*C)->err, NULL, 0, OCI_DEFAULT);
+                }
+                if ((*C)->txnhp)
+                        OCIHandleFree((*C)->txnhp, OCI_HTYPE_TRANS);
+                if ((*C)->err)
+                        OCIHandleFree((*C)->err, OCI_HTYPE_ERROR);
+                StringBuffer_free(&((*C)->sb));
+                FREE(*C);
+                return;
+        }
         if ((*C)->svc) {
                 OCISessionEnd((*C)->svc, (*C)->err, (*C)->usr, OCI_DEFAULT);
                 (*C)->svc = NULL;
@@ -349,14 +501,8 @@ static bool _execute(T C, const char *sql, va_list ap) {
         va_end(ap_copy);
         StringBuffer_trim(C->sb);
         /* Build statement */
-        C->lastError = OCIHandleAlloc(C->env, (void **)&stmtp, OCI_HTYPE_STMT, 0, NULL);
-        if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO)
-                return false;
-        C->lastError = OCIStmtPrepare(stmtp, C->err, StringBuffer_toString(C->sb), StringBuffer_length(C->sb), OCI_NTV_SYNTAX, OCI_DEFAULT);
-        if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO) {
-                OCIHandleFree(stmtp, OCI_HTYPE_STMT);
+        if (! (stmtp = _prepare(C)))
                 return false;
-        }
         /* Execute */
         if (C->timeout > 0) {
                 C->countdown = C->timeout;
@@ -368,13 +514,13 @@ static bool _execute(T C, const char *sql, va_list ap) {
                 ub4 parmcnt = 0;
                 OCIAttrGet(stmtp, OCI_HTYPE_STMT, &parmcnt, NULL, OCI_ATTR_PARSE_ERROR_OFFSET, C->err);
                 DEBUG("Error occured in StmtExecute %d (%s), offset is %d\n", C->lastError, _getLastError(C), parmcnt);
-                OCIHandleFree(stmtp, OCI_HTYPE_STMT);
+                OCIStmtRelease(stmtp, C->err, NULL, 0, OCI_DEFAULT);
                 return false;
         }
         C->lastError = OCIAttrGet(stmtp, OCI_HTYPE_STMT, &C->rowsChanged, 0, OCI_ATTR_ROW_COUNT, C->err);
         if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO)
                 DEBUG("OracleConnection_execute: Error in OCIAttrGet %d (%s)\n", C->lastError, _getLastError(C));
-        OCIHandleFree(stmtp, OCI_HTYPE_STMT);
+        OCIStmtRelease(stmtp, C->err, NULL, 0, OCI_DEFAULT);
         return C->lastError == OCI_SUCCESS;
 }
 
@@ -389,14 +535,8 @@ static ResultSet_T _executeQuery(T C, const char *sql, va_list ap) {
         va_end(ap_copy);
         StringBuffer_trim(C->sb);
         /* Build statement */
-        C->lastError = OCIHandleAlloc(C->env, (void **)&stmtp, OCI_HTYPE_STMT, 0, NULL);
-        if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO)
-                return NULL;
-        C->lastError = OCIStmtPrepare(stmtp, C->err, StringBuffer_toString(C->sb), StringBuffer_length(C->sb), OCI_NTV_SYNTAX, OCI_DEFAULT);
-        if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO) {
-                OCIHandleFree(stmtp, OCI_HTYPE_STMT);
+        if (! (stmtp = _prepare(C)))
                 return NULL;
-        }
         /* Execute and create Result Set */
         if (C->timeout > 0) {
                 C->countdown = C->timeout;
@@ -408,13 +548,13 @@ static ResultSet_T _executeQuery(T C, const char *sql, va_list ap) {
                 ub4 parmcnt = 0;
                 OCIAttrGet(stmtp, OCI_HTYPE_STMT, &parmcnt, NULL, OCI_ATTR_PARSE_ERROR_OFFSET, C->err);
                 DEBUG("Error occured in StmtExecute %d (%s), offset is %d\n", C->lastError, _getLastError(C), parmcnt);
-                OCIHandleFree(stmtp, OCI_HTYPE_STMT);
+                OCIStmtRelease(stmtp, C->err, NULL, 0, OCI_DEFAULT);
                 return NULL;
         }
         C->lastError = OCIAttrGet(stmtp, OCI_HTYPE_STMT, &C->rowsChanged, 0, OCI_ATTR_ROW_COUNT, C->err);
         if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO)
                 DEBUG("OracleConnection_execute: Error in OCIAttrGet %d (%s)\n", C->lastError, _getLastError(C));
-        return ResultSet_new(OracleResultSet_new(C->delegator, stmtp, C->env, C->usr, C->err, C->svc, true), (Rop_T)&oraclerops);
+        return ResultSet_new(OracleResultSet_new(C->delegator, stmtp, C->env, C->usr, C->err, C->svc, true, NULL), (Rop_T)&oraclerops);
 }
 
 
@@ -428,14 +568,8 @@ static PreparedStatement_T _prepareStatement(T C, const char *sql, va_list ap) {
         StringBuffer_trim(C->sb);
         StringBuffer_prepare4oracle(C->sb);
         /* Build statement */
-        C->lastError = OCIHandleAlloc(C->env, (void **)&stmtp, OCI_HTYPE_STMT, 0, 0);
-        if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO)
+        if (! (stmtp = _prepare(C)))
                 return NULL;
-        C->lastError = OCIStmtPrepare(stmtp, C->err, StringBuffer_toString(C->sb), StringBuffer_length(C->sb), OCI_NTV_SYNTAX, OCI_DEFAULT);
-        if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO) {
-                OCIHandleFree(stmtp, OCI_HTYPE_STMT);
-                return NULL;
-        }
         return PreparedStatement_new(OraclePreparedStatement_new(C->delegator, stmtp, C->env, C->usr, C->err, C->svc), (Pop_T)&oraclepops);
 }
 
@@ -58,8 +58,20 @@ typedef struct param_t {
         } type;
         OCIInd is_null;
         int length;
+        ub2 dty;
+        time_t time;
         OCIBind* bind;
+        PreparedStatement_BlobSource source;
+        void *context;
+        char *chunk;
+        long long streamed;
 } *param_t;
+typedef struct batch_t {
+        ub2 dty;
+        OCIInd is_null;
+        ub4 length;
+        void *value;
+} *batch_t;
 #define T PreparedStatementDelegate_T
 struct T {
         int         timeout;
@@ -75,6 +87,13 @@ struct T {
         Thread_T    watchdog;
         char        running;
         ub4         rowsChanged;
+        OracleColumns_T columns;
+        batch_t     batch;
+        int         batchRows;
+        int         batchCapacity;
+        int         batchErrors;
+        int        *errorRows;
+        char      **errorMessages;
         Connection_T delegator;
 };
 extern const struct Rop_T oraclerops;
@@ -84,6 +103,113 @@ extern const struct Rop_T oraclerops;
 
 
 WATCHDOG(watchdog, T)
+#define STREAM_CHUNK_SIZE 65536
+
+
+/* OCI in-bind callback sending a streamed parameter value piece by piece
+ while the statement executes */
+static sb4 _readStream(dvoid *ictxp, OCIBind *bindp, ub4 iter, ub4 index, dvoid **bufpp, ub4 *alenp, ub1 *piecep, dvoid **indp) {
+        param_t p = ictxp;
+        int n = p->source(p->context, p->chunk, STREAM_CHUNK_SIZE);
+        if (n < 0)
+                n = 0;
+        *bufpp = p->chunk;
+        *alenp = n;
+        *indp = &p->is_null;
+        if (n > 0) {
+                *piecep = p->streamed ? OCI_NEXT_PIECE : OCI_FIRST_PIECE;
+                p->streamed += n;
+        } else {
+                *piecep = p->streamed ? OCI_LAST_PIECE : OCI_ONE_PIECE;
+                p->streamed = 0;
+        }
+        return OCI_CONTINUE;
+}
+
+
+static void _clearBatch(T P) {
+        for (int i = 0; i < P->batchRows * (int)P->parameterCount; i++)
+                FREE(P->batch[i].value);
+        P->batchRows = 0;
+}
+
+
+static void _clearBatchErrors(T P) {
+        for (int i = 0; i < P->batchErrors; i++)
+                FREE(P->errorMessages[i]);
+        FREE(P->errorMessages);
+        FREE(P->errorRows);
+        P->batchErrors = 0;
+}
+
+
+/* Collect the errors of rows that failed in an OCI_BATCH_ERRORS execute */
+static void _collectBatchErrors(T P) {
+        ub4 count = 0;
+        OCIError *rowError = NULL;
+        OCIAttrGet(P->stmt, OCI_HTYPE_STMT, &count, NULL, OCI_ATTR_NUM_DML_ERRORS, P->err);
+        if (count == 0)
+                return;
+        if (OCIHandleAlloc(P->env, (void **)&rowError, OCI_HTYPE_ERROR, 0, NULL) != OCI_SUCCESS)
+                THROW(SQLException, "Allocating error handler failed");
+        P->errorRows = CALLOC(count, sizeof(int));
+        P->errorMessages = CALLOC(count, sizeof(char *));
+        for (ub4 j = 0; j < count; j++) {
+                ub4 offset = 0;
+                sb4 errcode = 0;
+                char message[STRLEN] = {};
+                if (OCIParamGet(P->err, OCI_HTYPE_ERROR, P->err, (void **)&rowError, j) == OCI_SUCCESS) {
+                        OCIAttrGet(rowError, OCI_HTYPE_ERROR, &offset, NULL, OCI_ATTR_DML_ROW_OFFSET, P->err);
+                        OCIErrorGet(rowError, 1, NULL, &errcode, (OraText *)message, sizeof(message), OCI_HTYPE_ERROR);
+                }
+                P->errorRows[j] = offset + 1;
+                P->errorMessages[j] = Str_dup(message);
+        }
+        P->batchErrors = count;
+        OCIHandleFree(rowError, OCI_HTYPE_ERROR);
+}
+
+
+/* Bind all rows of the batch for parameter i as one array. Values are laid out
+ with a fixed element size, the largest value of the parameter in the batch */
+static void _bindBatch(T P, int i, char **values, OCIInd **indicators, ub4 **lengths, OCIDateTime ***dates) {
+        ub2 dty = P->params[i].dty;
+        ub4 size = 1;
+        for (int r = 0; r < P->batchRows; r++) {
+                ub4 length = P->batch[r * P->parameterCount + i].length;
+                size = length > size ? length : size;
+        }
+        *indicators = CALLOC(P->batchRows, sizeof(OCIInd));
+        *lengths = CALLOC(P->batchRows, sizeof(ub4));
+        if (dty == SQLT_TIMESTAMP) {
+                size = sizeof(OCIDateTime *);
+                *dates = CALLOC(P->batchRows, sizeof(OCIDateTime *));
+        } else {
+                *values = ALLOC(P->batchRows * size);
+        }
+        for (int r = 0; r < P->batchRows; r++) {
+                batch_t b = &P->batch[r * P->parameterCount + i];
+                (*indicators)[r] = b->is_null;
+                (*lengths)[r] = b->length;
+                if (dty == SQLT_TIMESTAMP) {
+                        struct tm ts = {.tm_isdst = -1};
+                        gmtime_r((time_t *)b->value, &ts);
+                        P->lastError = OCIDescriptorAlloc((dvoid *)P->env, (dvoid **)&(*dates)[r], (ub4)OCI_DTYPE_TIMESTAMP, (size_t)0, (dvoid **)0);
+                        if (P->lastError != OCI_SUCCESS && P->lastError != OCI_SUCCESS_WITH_INFO)
+                                THROW(SQLException, "%s", OraclePreparedStatement_getLastError(P->lastError, P->err));
+                        OCIDateTimeConstruct(P->usr, P->err, (*dates)[r], ts.tm_year+1900, ts.tm_mon+1, ts.tm_mday, ts.tm_hour, ts.tm_min, ts.tm_sec, 0, (OraText*)0, 0);
+                        (*lengths)[r] = size;
+                } else if (b->length > 0) {
+                        memcpy(*values + (r * size), b->value, b->length);
+                }
+        }
+        P->lastError = OCIBindByPos2(P->stmt, &P->params[i].bind, P->err, i + 1, dty == SQLT_TIMESTAMP ? (void *)*dates : (void *)*values,
+                                     size, dty, *indicators, *lengths, 0, 0, 0, OCI_DEFAULT);
+        if (P->lastError == OCI_SUCCESS || P->lastError == OCI_SUCCESS_WITH_INFO)
+                P->lastError = OCIBindArrayOfStruct(P->params[i].bind, P->err, size, sizeof(OCIInd), sizeof(ub4), 0);
+        if (P->lastError != OCI_SUCCESS && P->lastError != OCI_SUCCESS_WITH_INFO)
+                THROW(SQLException, "%s", OraclePreparedStatement_getLastError(P->lastError, P->err));
+}
 
 
 /* ------------------------------------------------------------- Constructor */
@@ -124,9 +250,16 @@ T OraclePreparedStatement_new(Connection_T delegator, OCIStmt *stmt, OCIEnv *env
 
 static void _free(T *P) {
         assert(P && *P);
-        OCIHandleFree((*P)->stmt, OCI_HTYPE_STMT);
+        _clearBatch(*P);
+        _clearBatchErrors(*P);
+        FREE((*P)->batch);
+        OracleResultSet_freeColumns(&(*P)->columns);
+        // Return the statement to the session's statement cache
+        OCIStmtRelease((*P)->stmt, (*P)->err, NULL, 0, OCI_DEFAULT);
         if ((*P)->params) {
-                // (*P)->params[i].bind is freed implicitly when the statement handle is deallocated
+                // (*P)->params[i].bind is freed implicitly with the statement handle
+                for (ub4 i = 0; i < (*P)->parameterCount; i++)
+                        FREE((*P)->params[i].chunk);
                 FREE((*P)->params);
         }
         (*P)->svc = NULL;
@@ -147,6 +280,7 @@ static void _setString(T P, int parameterIndex, const char *x, int size) {
                 P->params[i].length = 0;
                 P->params[i].is_null = OCI_IND_NULL;
         }
+        P->params[i].dty = SQLT_CHR;
         P->lastError = OCIBindByPos(P->stmt, &P->params[i].bind, P->err, parameterIndex, (char *)P->params[i].type.string,
                                     (int)P->params[i].length, SQLT_CHR, &P->params[i].is_null, 0, 0, 0, 0, OCI_DEFAULT);
         if (P->lastError != OCI_SUCCESS && P->lastError != OCI_SUCCESS_WITH_INFO)
@@ -180,6 +314,8 @@ static void _setTimestamp(T P, int parameterIndex, time_t time) {
         }
 
         P->params[i].length = sizeof(OCIDateTime *);
+        P->params[i].dty = SQLT_TIMESTAMP;
+        P->params[i].time = time;
 
         P->lastError = OCIBindByPos(P->stmt, &P->params[i].bind, P->err, parameterIndex, &P->params[i].type.date, 
                                     P->params[i].length, SQLT_TIMESTAMP, 0, 0, 0, 0, 0, OCI_DEFAULT);
@@ -193,6 +329,7 @@ static void _setInt(T P, int parameterIndex, int x) {
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
         P->params[i].type.integer = x;
         P->params[i].length = sizeof(x);
+        P->params[i].dty = SQLT_INT;
         P->lastError = OCIBindByPos(P->stmt, &P->params[i].bind, P->err, parameterIndex, &P->params[i].type.integer,
                                     (int)P->params[i].length, SQLT_INT, 0, 0, 0, 0, 0, OCI_DEFAULT);
         if (P->lastError != OCI_SUCCESS && P->lastError != OCI_SUCCESS_WITH_INFO)
@@ -204,6 +341,7 @@ static void _setLLong(T P, int parameterIndex, long long x) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
         P->params[i].length = sizeof(P->params[i].type.number);
+        P->params[i].dty = SQLT_VNU;
         P->lastError = OCINumberFromInt(P->err, &x, sizeof(x), OCI_NUMBER_SIGNED, &P->params[i].type.number);
         if (P->lastError != OCI_SUCCESS)
                 THROW(SQLException, "%s", OraclePreparedStatement_getLastError(P->lastError, P->err));
@@ -219,6 +357,7 @@ static void _setDouble(T P, int parameterIndex, double x) {
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
         P->params[i].type.real = x;
         P->params[i].length = sizeof(x);
+        P->params[i].dty = SQLT_FLT;
         P->lastError = OCIBindByPos(P->stmt, &P->params[i].bind, P->err, parameterIndex, &P->params[i].type.real, 
                                     (int)P->params[i].length, SQLT_FLT, 0, 0, 0, 0, 0, OCI_DEFAULT);
         if (P->lastError != OCI_SUCCESS && P->lastError != OCI_SUCCESS_WITH_INFO)
@@ -237,6 +376,7 @@ static void _setBlob(T P, int parameterIndex, const void *x, int size) {
                 P->params[i].length = 0;
                 P->params[i].is_null = OCI_IND_NULL;
         }
+        P->params[i].dty = SQLT_LNG;
         P->lastError = OCIBindByPos2(P->stmt, &P->params[i].bind, P->err, parameterIndex, (void *)P->params[i].type.blob,
                                     (int)P->params[i].length, SQLT_LNG, &P->params[i].is_null, 0, 0, 0, 0, OCI_DEFAULT);
         if (P->lastError != OCI_SUCCESS && P->lastError != OCI_SUCCESS_WITH_INFO)
@@ -244,6 +384,25 @@ static void _setBlob(T P, int parameterIndex, const void *x, int size) {
 }
 
 
+static void _setBlobStream(T P, int parameterIndex, PreparedStatement_BlobSource source, void *context) {
+        assert(P);
+        int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
+        param_t p = &P->params[i];
+        if (! p->chunk)
+                p->chunk = ALLOC(STREAM_CHUNK_SIZE);
+        p->source = source;
+        p->context = context;
+        p->streamed = 0;
+        p->is_null = OCI_IND_NOTNULL;
+        p->dty = 0; // Not available for batches
+        P->lastError = OCIBindByPos(P->stmt, &p->bind, P->err, parameterIndex, NULL, SB4MAXVAL, SQLT_LNG, NULL, NULL, NULL, 0, NULL, OCI_DATA_AT_EXEC);
+        if (P->lastError == OCI_SUCCESS || P->lastError == OCI_SUCCESS_WITH_INFO)
+                P->lastError = OCIBindDynamic(p->bind, P->err, p, _readStream, NULL, NULL);
+        if (P->lastError != OCI_SUCCESS && P->lastError != OCI_SUCCESS_WITH_INFO)
+                THROW(SQLException, "%s", OraclePreparedStatement_getLastError(P->lastError, P->err));
+}
+
+
 static void _execute(T P) {
         assert(P);
         P->rowsChanged = 0;
@@ -271,12 +430,126 @@ static ResultSet_T _executeQuery(T P) {
         P->lastError = OCIStmtExecute(P->svc, P->stmt, P->err, 0, 0, NULL, NULL, OCI_DEFAULT);
         P->running = false;
         if (P->lastError == OCI_SUCCESS || P->lastError == OCI_SUCCESS_WITH_INFO)
-                return ResultSet_new(OracleResultSet_new(P->delegator, P->stmt, P->env, P->usr, P->err, P->svc, false), (Rop_T)&oraclerops);
+                return ResultSet_new(OracleResultSet_new(P->delegator, P->stmt, P->env, P->usr, P->err, P->svc, false, &P->columns), (Rop_T)&oraclerops);
         THROW(SQLException, "%s", OraclePreparedStatement_getLastError(P->lastError, P->err));
         return NULL;
 }
 
 
+/* Copy the current parameter values into the batch */
+static void _addBatch(T P) {
+        assert(P);
+        if (P->parameterCount == 0)
+                THROW(SQLException, "Statement has no parameters to batch");
+        if (P->batchRows == P->batchCapacity) {
+                P->batchCapacity = P->batchCapacity ? P->batchCapacity * 2 : 64;
+                if (P->batch)
+                        RESIZE(P->batch, P->batchCapacity * P->parameterCount * sizeof(struct batch_t));
+                else
+                        P->batch = ALLOC(P->batchCapacity * P->parameterCount * sizeof(struct batch_t));
+        }
+        // Check all parameters before values are copied so a failed row allocates nothing
+        for (ub4 i = 0; i < P->parameterCount; i++) {
+                if (! P->params[i].dty)
+                        THROW(SQLException, "Parameter %d is not set or cannot be batched", i + 1);
+                if (P->batchRows > 0 && P->params[i].dty != P->batch[i].dty)
+                        THROW(SQLException, "Parameter %d changed type within the batch", i + 1);
+        }
+        batch_t row = &P->batch[P->batchRows * P->parameterCount];
+        for (ub4 i = 0; i < P->parameterCount; i++) {
+                param_t p = &P->params[i];
+                const void *value = NULL;
+                ub4 length = p->length;
+                int integer = (int)p->type.integer;
+                switch (p->dty) {
+                        case SQLT_CHR: value = p->type.string; break;
+                        case SQLT_LNG: value = p->type.blob; break;
+                        case SQLT_INT: value = &integer; break;
+                        case SQLT_VNU: value = &p->type.number; break;
+                        case SQLT_FLT: value = &p->type.real; break;
+                        case SQLT_TIMESTAMP: value = &p->time; length = sizeof(time_t); break;
+                }
+                row[i].dty = p->dty;
+                row[i].is_null = (p->dty == SQLT_CHR || p->dty == SQLT_LNG) ? p->is_null : OCI_IND_NOTNULL;
+                row[i].length = row[i].is_null == OCI_IND_NULL ? 0 : length;
+                row[i].value = row[i].length ? ALLOC(row[i].length) : NULL;
+                if (row[i].length)
+                        memcpy(row[i].value, value, row[i].length);
+        }
+        P->batchRows++;
+}
+
+
+static long long _executeBatch(T P) {
+        assert(P);
+        int rows = P->batchRows;
+        char *values[P->parameterCount];
+        OCIInd *indicators[P->parameterCount];
+        ub4 *lengths[P->parameterCount];
+        OCIDateTime **dates[P->parameterCount];
+        _clearBatchErrors(P);
+        P->rowsChanged = 0;
+        if (rows == 0)
+                return 0;
+        memset(values, 0, sizeof(values));
+        memset(indicators, 0, sizeof(indicators));
+        memset(lengths, 0, sizeof(lengths));
+        memset(dates, 0, sizeof(dates));
+        TRY
+        {
+                for (ub4 i = 0; i < P->parameterCount; i++)
+                        _bindBatch(P, i, &values[i], &indicators[i], &lengths[i], &dates[i]);
+                if (P->timeout > 0) {
+                        P->countdown = P->timeout;
+                        P->running = true;
+                }
+                P->lastError = OCIStmtExecute(P->svc, P->stmt, P->err, rows, 0, NULL, NULL, OCI_BATCH_ERRORS);
+                P->running = false;
+                if (P->lastError == OCI_SUCCESS || P->lastError == OCI_SUCCESS_WITH_INFO || P->lastError == OCI_ERROR) {
+                        // Failed rows are reported with OCI_SUCCESS_WITH_INFO or OCI_ERROR, the other rows are executed
+                        sword status = P->lastError;
+                        _collectBatchErrors(P);
+                        if (status == OCI_ERROR && P->batchErrors == 0)
+                                THROW(SQLException, "%s", OraclePreparedStatement_getLastError(status, P->err));
+                        OCIAttrGet(P->stmt, OCI_HTYPE_STMT, &P->rowsChanged, 0, OCI_ATTR_ROW_COUNT, P->err);
+                } else {
+                        THROW(SQLException, "%s", OraclePreparedStatement_getLastError(P->lastError, P->err));
+                }
+        }
+        FINALLY
+        {
+                for (ub4 i = 0; i < P->parameterCount; i++) {
+                        if (dates[i])
+                                for (int r = 0; r < rows; r++)
+                                        if (dates[i][r])
+                                                OCIDescriptorFree((dvoid *)dates[i][r], OCI_DTYPE_TIMESTAMP);
+                        FREE(dates[i]);
+                        FREE(values[i]);
+                        FREE(indicators[i]);
+                        FREE(lengths[i]);
+                }
+                _clearBatch(P);
+        }
+        END_TRY;
+        return P->rowsChanged;
+}
+
+
+static int _getBatchErrors(T P) {
+        assert(P);
+        return P->batchErrors;
+}
+
+
+static const char *_getBatchError(T P, int index, int *row) {
+        assert(P);
+        if (index < 0 || index >= P->batchErrors)
+                return NULL;
+        *row = P->errorRows[index];
+        return P->errorMessages[index];
+}
+
+
 static long long _rowsChanged(T P) {
         assert(P);
         return P->rowsChanged;
@@ -301,8 +574,13 @@ const struct Pop_T oraclepops = {
         .setDouble      = _setDouble,
         .setTimestamp   = _setTimestamp,
         .setBlob        = _setBlob,
+        .setBlobStream  = _setBlobStream,
         .execute        = _execute,
         .executeQuery   = _executeQuery,
+        .addBatch       = _addBatch,
+        .executeBatch   = _executeBatch,
+        .getBatchErrors = _getBatchErrors,
+        .getBatchError  = _getBatchError,
         .rowsChanged    = _rowsChanged,
         .parameterCount = _parameterCount
 };
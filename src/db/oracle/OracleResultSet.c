@@ -45,25 +45,49 @@
 
 typedef struct column_t {
         OCIDefine *def;
-        int isNull;
+        ub2 type;
+        sb2 *isNull;
         char *buffer;
-        char *name;
+        const char *name;
         unsigned long length;
-        OCILobLocator *lob_loc;
-        OCIDateTime   *date;
+        unsigned long capacity;
+        ub4 size;
+        ub4 rows;
+        int readRow;
+        oraub8 offset;
+        OCILobLocator **lob_loc;
+        OCIDateTime   **date;
 } *column_t;
+struct OracleColumns_T {
+        int columnCount;
+        struct column_meta_t {
+                char *name;
+                ub2 type;
+                ub4 size;
+                long width;
+                ub2 dataType; // As described, to validate the cache
+                int dataSize;
+        } *meta;
+};
 #define T ResultSetDelegate_T
 struct T {
         int         columnCount;
         int         currentRow;
         int         fetchSize;
         ub4         maxRows;
+        ub4         lobPrefetch;
+        ub4         row;
+        ub4         rows;
+        ub4         batchSize;
+        bool        lastBatch;
         OCIStmt*    stmt;
         OCIEnv*     env;
         OCISession* usr;
         OCIError*   err;
         OCISvcCtx*  svc;
         column_t    columns;
+        OracleColumns_T meta;
+        OracleColumns_T *cache;
         sword       lastError;
         int         freeStatement;
         Connection_T delegator;
@@ -71,74 +95,72 @@ struct T {
 #ifndef ORACLE_COLUMN_NAME_LOWERCASE
 #define ORACLE_COLUMN_NAME_LOWERCASE 2
 #endif
-#define LOB_CHUNK_SIZE  2000
+#define LOB_CHUNK_SIZE  65536
+#define LOB_PREFETCH_SIZE 4000
 #define DATE_STR_BUF_SIZE   255
+#define MAX_BATCH_BYTES (1024 * 1024)
 
 
 /* ------------------------------------------------------- Private methods */
 
 
-static bool _initaleDefiningBuffers(T R) {
-        ub2 dtype = 0;
+/* Describe the select-list and decide how each column is defined. Output
+ buffers are allocated later by _defineBuffers() */
+static OracleColumns_T _describeColumns(T R) {
         int deptlen;
         int sizelen = sizeof(deptlen);
         OCIParam* pard = NULL;
-        __attribute__((unused)) sword status;
+        OracleColumns_T columns;
+        NEW(columns);
+        columns->columnCount = R->columnCount;
+        columns->meta = CALLOC(R->columnCount, sizeof(struct column_meta_t));
         for (int i = 1; i <= R->columnCount; i++) {
+                ub2 dtype = 0;
+                ub2 width = 0;
+                ub4 char_semantics = 0;
+                struct column_meta_t *meta = &columns->meta[i-1];
                 deptlen = 0;
                 /* The next two statements describe the select-list item, dname, and
                  return its length */
                 R->lastError = OCIParamGet(R->stmt, OCI_HTYPE_STMT, R->err, (void **)&pard, i);
                 if (R->lastError != OCI_SUCCESS)
-                        return false;
+                        goto error;
                 R->lastError = OCIAttrGet(pard, OCI_DTYPE_PARAM, &deptlen, &sizelen, OCI_ATTR_DATA_SIZE, R->err);
                 if (R->lastError != OCI_SUCCESS) {
                         // cannot get column's size, cleaning and returning
                         OCIDescriptorFree(pard, OCI_DTYPE_PARAM);
-                        return false;
+                        goto error;
                 }
                 OCIAttrGet(pard, OCI_DTYPE_PARAM, &dtype, 0, OCI_ATTR_DATA_TYPE, R->err);
-                /* Use the retrieved length of dname to allocate an output buffer, and
-                 then define the output variable. */
+                meta->dataType = dtype;
+                meta->dataSize = deptlen;
+                // The column width reported by getColumnSize, in characters or bytes
+                meta->width = -1;
+                if (OCIAttrGet(pard, OCI_DTYPE_PARAM, &char_semantics, NULL, OCI_ATTR_CHAR_USED, R->err) == OCI_SUCCESS) {
+                        if (OCIAttrGet(pard, OCI_DTYPE_PARAM, &width, NULL, char_semantics ? OCI_ATTR_CHAR_SIZE : OCI_ATTR_DATA_SIZE, R->err) == OCI_SUCCESS)
+                                meta->width = width;
+                }
+                /* Use the retrieved length of dname as the size of an output
+                 value, including the terminating NUL of SQLT_STR. */
                 deptlen +=1;
-                R->columns[i-1].length = deptlen;
-                R->columns[i-1].isNull = 0;
                 switch(dtype)
                 {
                         case SQLT_BLOB:
-                                R->columns[i-1].buffer = NULL;
-                                status = OCIDescriptorAlloc((dvoid *)R->env, (dvoid **) &(R->columns[i-1].lob_loc),
-                                                            (ub4) OCI_DTYPE_LOB,
-                                                            (size_t) 0, (dvoid **) 0);
-                                R->lastError = OCIDefineByPos(R->stmt, &R->columns[i-1].def, R->err, i,
-                                                              &(R->columns[i-1].lob_loc), deptlen, SQLT_BLOB, &(R->columns[i-1].isNull), 0, 0, OCI_DEFAULT);
-                                break;
-                                
                         case SQLT_CLOB:
-                                R->columns[i-1].buffer = NULL;
-                                status = OCIDescriptorAlloc((dvoid *)R->env, (dvoid **) &(R->columns[i-1].lob_loc),
-                                                            (ub4) OCI_DTYPE_LOB,
-                                                            (size_t) 0, (dvoid **) 0);
-                                R->lastError = OCIDefineByPos(R->stmt, &R->columns[i-1].def, R->err, i,
-                                                              &(R->columns[i-1].lob_loc), deptlen, SQLT_CLOB, &(R->columns[i-1].isNull), 0, 0, OCI_DEFAULT);
+                                meta->type = dtype;
+                                meta->size = sizeof(OCILobLocator *);
                                 break;
                         case SQLT_DAT:
                         case SQLT_DATE:
                         case SQLT_TIMESTAMP:
                         case SQLT_TIMESTAMP_TZ:
                         case SQLT_TIMESTAMP_LTZ:
-                                R->columns[i-1].buffer = NULL;
-                                status = OCIDescriptorAlloc((dvoid *)R->env, (dvoid **) &(R->columns[i-1].date),
-                                                            (ub4) OCI_DTYPE_TIMESTAMP,
-                                                            (size_t) 0, (dvoid **) 0);
-                                R->lastError = OCIDefineByPos(R->stmt, &R->columns[i-1].def, R->err, i,
-                                                              &(R->columns[i-1].date), sizeof(R->columns[i-1].date), SQLT_TIMESTAMP, &(R->columns[i-1].isNull), 0, 0, OCI_DEFAULT);
+                                meta->type = SQLT_TIMESTAMP;
+                                meta->size = sizeof(OCIDateTime *);
                                 break;
                         default:
-                                R->columns[i-1].lob_loc = NULL;
-                                R->columns[i-1].buffer = ALLOC(deptlen + 1);
-                                R->lastError = OCIDefineByPos(R->stmt, &R->columns[i-1].def, R->err, i,
-                                                              R->columns[i-1].buffer, deptlen, SQLT_STR, &(R->columns[i-1].isNull), 0, 0, OCI_DEFAULT);
+                                meta->type = SQLT_STR;
+                                meta->size = deptlen;
                 }
                 {
                         char *col_name;
@@ -146,40 +168,137 @@ static bool _initaleDefiningBuffers(T R) {
                         char* tmp_buffer;
                         
                         R->lastError = OCIAttrGet(pard, OCI_DTYPE_PARAM, &col_name, &col_name_len, OCI_ATTR_NAME, R->err);
-                        if (R->lastError != OCI_SUCCESS)
+                        if (R->lastError != OCI_SUCCESS) {
+                                OCIDescriptorFree(pard, OCI_DTYPE_PARAM);
                                 continue;
+                        }
                         // column name could be non NULL terminated
                         // it is not allowed to do: col_name[col_name_len] = 0;
                         // so, copy the string
                         tmp_buffer = Str_ndup(col_name, col_name_len);
 #if defined(ORACLE_COLUMN_NAME_LOWERCASE) && ORACLE_COLUMN_NAME_LOWERCASE > 1
-                        R->columns[i-1].name = CALLOC(1, col_name_len+1);
-                        OCIMultiByteStrCaseConversion(R->env, R->columns[i-1].name, tmp_buffer, OCI_NLS_LOWERCASE);
+                        meta->name = CALLOC(1, col_name_len+1);
+                        OCIMultiByteStrCaseConversion(R->env, meta->name, tmp_buffer, OCI_NLS_LOWERCASE);
                         FREE(tmp_buffer);
 #else
-                        R->columns[i-1].name = tmp_buffer;
+                        meta->name = tmp_buffer;
 #endif /*COLLUMN_NAME_LOWERCASE*/
                 }
                 OCIDescriptorFree(pard, OCI_DTYPE_PARAM);
-                if (R->lastError != OCI_SUCCESS) {
+        }
+        return columns;
+error:
+        OracleResultSet_freeColumns(&columns);
+        return NULL;
+}
+
+
+/* Cached describe data is valid if each column has the same data type and size. A
+ schema change which keeps the number of columns would otherwise leave stale buffers */
+static bool _isValid(T R, OracleColumns_T columns) {
+        if (! columns || columns->columnCount != R->columnCount)
+                return false;
+        for (int i = 1; i <= R->columnCount; i++) {
+                ub2 dtype = 0;
+                int deptlen = 0;
+                OCIParam* pard = NULL;
+                if (OCIParamGet(R->stmt, OCI_HTYPE_STMT, R->err, (void **)&pard, i) != OCI_SUCCESS)
+                        return false;
+                OCIAttrGet(pard, OCI_DTYPE_PARAM, &dtype, 0, OCI_ATTR_DATA_TYPE, R->err);
+                OCIAttrGet(pard, OCI_DTYPE_PARAM, &deptlen, 0, OCI_ATTR_DATA_SIZE, R->err);
+                OCIDescriptorFree(pard, OCI_DTYPE_PARAM);
+                if (dtype != columns->meta[i - 1].dataType || deptlen != columns->meta[i - 1].dataSize)
                         return false;
+        }
+        return true;
+}
+
+
+static void _freeBuffers(column_t c) {
+        if (c->lob_loc) {
+                for (ub4 r = 0; r < c->rows; r++)
+                        if (c->lob_loc[r])
+                                OCIDescriptorFree(c->lob_loc[r], OCI_DTYPE_LOB);
+                FREE(c->lob_loc);
+        }
+        if (c->date) {
+                for (ub4 r = 0; r < c->rows; r++)
+                        if (c->date[r])
+                                OCIDescriptorFree((dvoid*)c->date[r], OCI_DTYPE_TIMESTAMP);
+                FREE(c->date);
+        }
+        FREE(c->buffer);
+        FREE(c->isNull);
+        c->capacity = 0;
+        c->rows = 0;
+}
+
+
+/* Number of rows fetched per OCIStmtFetch2. This is the fetch size, limited by
+ max rows and so the string buffers of a batch stay below MAX_BATCH_BYTES */
+static ub4 _batchSize(T R) {
+        ub4 rows = R->fetchSize > 0 ? R->fetchSize : 1;
+        if (R->maxRows > 0 && R->maxRows < rows)
+                rows = R->maxRows;
+        unsigned long rowBytes = 0;
+        for (int i = 0; i < R->columnCount; i++)
+                rowBytes += R->columns[i].size;
+        if (rowBytes > 0 && rows * rowBytes > MAX_BATCH_BYTES)
+                rows = (MAX_BATCH_BYTES / rowBytes) > 0 ? (ub4)(MAX_BATCH_BYTES / rowBytes) : 1;
+        return rows;
+}
+
+
+/* Define output buffers as arrays of rows values so one OCIStmtFetch2 fills a
+ batch of rows. Buffers are only redefined between batches */
+static bool _defineBuffers(T R, ub4 rows) {
+        for (int i = 0; i < R->columnCount; i++) {
+                column_t c = &R->columns[i];
+                _freeBuffers(c);
+                c->rows = rows;
+                c->isNull = CALLOC(rows, sizeof(sb2));
+                switch (c->type) {
+                        case SQLT_BLOB:
+                        case SQLT_CLOB:
+                                c->lob_loc = CALLOC(rows, sizeof(OCILobLocator *));
+                                for (ub4 r = 0; r < rows; r++)
+                                        OCIDescriptorAlloc((dvoid *)R->env, (dvoid **)&c->lob_loc[r], (ub4)OCI_DTYPE_LOB, (size_t)0, (dvoid **)0);
+                                R->lastError = OCIDefineByPos(R->stmt, &c->def, R->err, i + 1, c->lob_loc, c->size, c->type, c->isNull, 0, 0, OCI_DEFAULT);
+                                if (R->lastError == OCI_SUCCESS && R->lobPrefetch > 0) {
+                                        // Small LOBs and the length of all LOBs are returned with the fetch
+                                        boolean prefetchLength = TRUE;
+                                        OCIAttrSet(c->def, OCI_HTYPE_DEFINE, &R->lobPrefetch, 0, OCI_ATTR_LOBPREFETCH_SIZE, R->err);
+                                        OCIAttrSet(c->def, OCI_HTYPE_DEFINE, &prefetchLength, 0, OCI_ATTR_LOBPREFETCH_LENGTH, R->err);
+                                }
+                                break;
+                        case SQLT_TIMESTAMP:
+                                c->date = CALLOC(rows, sizeof(OCIDateTime *));
+                                for (ub4 r = 0; r < rows; r++)
+                                        OCIDescriptorAlloc((dvoid *)R->env, (dvoid **)&c->date[r], (ub4)OCI_DTYPE_TIMESTAMP, (size_t)0, (dvoid **)0);
+                                R->lastError = OCIDefineByPos(R->stmt, &c->def, R->err, i + 1, c->date, c->size, SQLT_TIMESTAMP, c->isNull, 0, 0, OCI_DEFAULT);
+                                break;
+                        default:
+                                c->buffer = ALLOC(rows * c->size);
+                                R->lastError = OCIDefineByPos(R->stmt, &c->def, R->err, i + 1, c->buffer, c->size, SQLT_STR, c->isNull, 0, 0, OCI_DEFAULT);
                 }
+                if (R->lastError != OCI_SUCCESS)
+                        return false;
         }
+        R->batchSize = rows;
         return true;
 }
 
+
 static bool _toString(T R, int i)
 {
         const char fmt[] = "IYYY-MM-DD HH24.MI.SS"; // "YYYY-MM-DD HH24:MI:SS TZR TZD"
-        
+        // The text buffer is allocated once and reused for all rows
+        if (! R->columns[i].buffer)
+                R->columns[i].buffer = ALLOC(DATE_STR_BUF_SIZE + 1);
         R->columns[i].length = DATE_STR_BUF_SIZE;
-        if (R->columns[i].buffer)
-                FREE(R->columns[i].buffer);
-        
-        R->columns[i].buffer = ALLOC(R->columns[i].length + 1);
         R->lastError = OCIDateTimeToText(R->usr,
                                          R->err,
-                                         R->columns[i].date,
+                                         R->columns[i].date[R->row],
                                          fmt, strlen(fmt),
                                          0,
                                          NULL, 0,
@@ -187,13 +306,31 @@ static bool _toString(T R, int i)
         return ((R->lastError == OCI_SUCCESS) || (R->lastError == OCI_SUCCESS_WITH_INFO));;
 }
 
+
+/* Read the fields of a date column directly from the OCIDateTime descriptor.
+ The year is the year literal as with Time_toDateTime() */
+static struct tm *_toDateTime(T R, int i, struct tm *tm) {
+        sb2 year = 0;
+        ub1 month = 0, day = 0, hour = 0, min = 0, sec = 0;
+        ub4 fsec = 0;
+        R->lastError = OCIDateTimeGetDate(R->usr, R->err, R->columns[i].date[R->row], &year, &month, &day);
+        if (R->lastError == OCI_SUCCESS)
+                R->lastError = OCIDateTimeGetTime(R->usr, R->err, R->columns[i].date[R->row], &hour, &min, &sec, &fsec);
+        if (R->lastError != OCI_SUCCESS)
+                THROW(SQLException, "%s", OraclePreparedStatement_getLastError(R->lastError, R->err));
+        *tm = (struct tm){.tm_year = year, .tm_mon = month - 1, .tm_mday = day, .tm_hour = hour, .tm_min = min, .tm_sec = sec};
+        return tm;
+}
+
+
 static void _setFetchSize(T R, int rows);
+static const void *_getBlob(T R, int columnIndex, int *size);
 
 
 /* ------------------------------------------------------------- Constructor */
 
 
-T OracleResultSet_new(Connection_T delegator, OCIStmt *stmt, OCIEnv *env, OCISession* usr, OCIError *err, OCISvcCtx *svc, int need_free) {
+T OracleResultSet_new(Connection_T delegator, OCIStmt *stmt, OCIEnv *env, OCISession* usr, OCIError *err, OCISvcCtx *svc, int need_free, OracleColumns_T *cache) {
         T R;
         assert(stmt);
         assert(env);
@@ -207,18 +344,43 @@ T OracleResultSet_new(Connection_T delegator, OCIStmt *stmt, OCIEnv *env, OCISes
         R->svc  = svc;
         R->usr  = usr;
         R->maxRows = Connection_getMaxRows(R->delegator);
+        R->lobPrefetch = LOB_PREFETCH_SIZE;
+        const char *lobPrefetch = URL_getParameter(Connection_getURL(R->delegator), "lob-prefetch");
+        if (lobPrefetch)
+                R->lobPrefetch = Str_parseInt(lobPrefetch);
         R->freeStatement = need_free;
         /* Get the number of columns in the select list */
         R->lastError = OCIAttrGet (R->stmt, OCI_HTYPE_STMT, &R->columnCount, NULL, OCI_ATTR_PARAM_COUNT, R->err);
         if (R->lastError != OCI_SUCCESS && R->lastError != OCI_SUCCESS_WITH_INFO)
                 DEBUG("_new: Error %d, '%s'\n", R->lastError, OraclePreparedStatement_getLastError(R->lastError,R->err));
         R->columns = CALLOC(R->columnCount, sizeof (struct column_t));
-        if (!_initaleDefiningBuffers(R)) {
+        // Describe data is kept by the prepared statement and reused as long as the select-list is unchanged
+        R->cache = cache;
+        if (cache && _isValid(R, *cache)) {
+                R->meta = *cache;
+        } else {
+                if (cache)
+                        OracleResultSet_freeColumns(cache);
+                R->meta = _describeColumns(R);
+                if (cache)
+                        *cache = R->meta;
+        }
+        if (! R->meta) {
                 DEBUG("_new: Error %d, '%s'\n", R->lastError, OraclePreparedStatement_getLastError(R->lastError,R->err));
                 R->currentRow = -1;
+        } else {
+                for (int i = 0; i < R->columnCount; i++) {
+                        R->columns[i].name = R->meta->meta[i].name;
+                        R->columns[i].type = R->meta->meta[i].type;
+                        R->columns[i].size = R->meta->meta[i].size;
+                }
         }
         if (R->currentRow != -1) {
                 _setFetchSize(R, Connection_getFetchSize(R->delegator));
+                if (!_defineBuffers(R, _batchSize(R))) {
+                        DEBUG("_new: Error %d, '%s'\n", R->lastError, OraclePreparedStatement_getLastError(R->lastError,R->err));
+                        R->currentRow = -1;
+                }
         }
         return R;
 }
@@ -230,15 +392,11 @@ T OracleResultSet_new(Connection_T delegator, OCIStmt *stmt, OCIEnv *env, OCISes
 static void _free(T *R) {
         assert(R && *R);
         if ((*R)->freeStatement)
-                OCIHandleFree((*R)->stmt, OCI_HTYPE_STMT);
-        for (int i = 0; i < (*R)->columnCount; i++) {
-                if ((*R)->columns[i].lob_loc)
-                        OCIDescriptorFree((*R)->columns[i].lob_loc, OCI_DTYPE_LOB);
-                if ((*R)->columns[i].date)
-                        OCIDescriptorFree((dvoid*)(*R)->columns[i].date, OCI_DTYPE_TIMESTAMP);
-                FREE((*R)->columns[i].buffer);
-                FREE((*R)->columns[i].name);
-        }
+                OCIStmtRelease((*R)->stmt, (*R)->err, NULL, 0, OCI_DEFAULT);
+        for (int i = 0; i < (*R)->columnCount; i++)
+                _freeBuffers(&(*R)->columns[i]);
+        if (! (*R)->cache)
+                OracleResultSet_freeColumns(&(*R)->meta);
         FREE((*R)->columns);
         FREE(*R);
 }
@@ -259,25 +417,10 @@ static const char *_getColumnName(T R, int column) {
 
 
 static long _getColumnSize(T R, int columnIndex) {
-        OCIParam* pard = NULL;
-        ub4 char_semantics = 0;
-        sb4 status;
-        ub2 col_width = 0;
         assert(R);
-        status = OCIParamGet(R->stmt, OCI_HTYPE_STMT, R->err, (void **)&pard, columnIndex);
-        if (status != OCI_SUCCESS)
+        if (! R->meta || columnIndex < 1 || columnIndex > R->columnCount)
                 return -1;
-        status = OCIAttrGet(pard, OCI_DTYPE_PARAM, &char_semantics, NULL, OCI_ATTR_CHAR_USED, R->err);
-        if (status != OCI_SUCCESS) {
-                OCIDescriptorFree(pard, OCI_DTYPE_PARAM);
-                return -1;
-        }
-        status = (char_semantics) ?
-        /* Retrieve the column width in characters */
-        OCIAttrGet(pard, OCI_DTYPE_PARAM, &col_width, NULL, OCI_ATTR_CHAR_SIZE, R->err) :
-        /* Retrieve the column width in bytes */
-        OCIAttrGet(pard, OCI_DTYPE_PARAM, &col_width, NULL, OCI_ATTR_DATA_SIZE, R->err);
-        return (status != OCI_SUCCESS) ? -1 : col_width;
+        return R->meta->meta[columnIndex - 1].width;
 }
 
 
@@ -301,72 +444,174 @@ static bool _next(T R) {
         assert(R);
         if ((R->currentRow < 0) || ((R->maxRows > 0) && (R->currentRow >= R->maxRows)))
                 return false;
-        R->lastError = OCIStmtFetch2(R->stmt, R->err, 1, OCI_FETCH_NEXT, 0, OCI_DEFAULT);
-        if (R->lastError == OCI_NO_DATA)
-                return false;
-        if (R->lastError != OCI_SUCCESS && R->lastError != OCI_SUCCESS_WITH_INFO)
-                THROW(SQLException, "%s", OraclePreparedStatement_getLastError(R->lastError, R->err));
-        if (R->lastError == OCI_SUCCESS_WITH_INFO)
-                DEBUG("_next Error %d, '%s'\n", R->lastError, OraclePreparedStatement_getLastError(R->lastError, R->err));
+        if (++R->row >= R->rows) {
+                if (R->lastBatch)
+                        return false;
+                // The previous batch is consumed, pick up a changed fetch size
+                ub4 batchSize = _batchSize(R);
+                if (batchSize != R->batchSize && !_defineBuffers(R, batchSize))
+                        THROW(SQLException, "%s", OraclePreparedStatement_getLastError(R->lastError, R->err));
+                R->lastError = OCIStmtFetch2(R->stmt, R->err, R->batchSize, OCI_FETCH_NEXT, 0, OCI_DEFAULT);
+                if (R->lastError != OCI_SUCCESS && R->lastError != OCI_SUCCESS_WITH_INFO && R->lastError != OCI_NO_DATA)
+                        THROW(SQLException, "%s", OraclePreparedStatement_getLastError(R->lastError, R->err));
+                if (R->lastError == OCI_SUCCESS_WITH_INFO)
+                        DEBUG("_next Error %d, '%s'\n", R->lastError, OraclePreparedStatement_getLastError(R->lastError, R->err));
+                // A partial batch is returned together with OCI_NO_DATA
+                R->lastBatch = (R->lastError == OCI_NO_DATA);
+                R->rows = 0;
+                R->row = 0;
+                OCIAttrGet(R->stmt, OCI_HTYPE_STMT, &R->rows, NULL, OCI_ATTR_ROWS_FETCHED, R->err);
+                if (R->rows == 0)
+                        return false;
+        }
         R->currentRow++;
-        return ((R->lastError == OCI_SUCCESS) || (R->lastError == OCI_SUCCESS_WITH_INFO));
+        return true;
 }
 
 
 static bool _isnull(T R, int columnIndex) {
         assert(R);
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
-        return R->columns[i].isNull != 0;
+        return R->columns[i].isNull[R->row] != 0;
 }
 
 
 static const char *_getString(T R, int columnIndex) {
         assert(R);
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
-        if (R->columns[i].isNull)
+        if (R->columns[i].isNull[R->row])
                 return NULL;
         if (R->columns[i].date) {
                 if (!_toString(R, i)) {
                         THROW(SQLException, "%s", OraclePreparedStatement_getLastError(R->lastError, R->err));
                 }
-        }
-        if (R->columns[i].buffer)
                 R->columns[i].buffer[R->columns[i].length] = 0;
+                return R->columns[i].buffer;
+        }
+        if (R->columns[i].type == SQLT_STR)
+                return R->columns[i].buffer + (R->row * R->columns[i].size);
+        // A LOB is read into the column buffer which always has room for a NUL after the value
+        int size;
+        _getBlob(R, columnIndex, &size);
+        R->columns[i].buffer[size] = 0;
         return R->columns[i].buffer;
 }
 
 
+static int _getColumnType(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        switch (R->columns[i].type) {
+                case SQLT_BLOB:
+                        return ResultSet_Blob;
+                case SQLT_CLOB:
+                        return ResultSet_Text;
+                case SQLT_TIMESTAMP:
+                        return ResultSet_Temporal;
+        }
+        // Numbers and character strings are both fetched as SQLT_STR
+        return ResultSet_Unknown;
+}
+
+
+static time_t _getTimestamp(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (R->columns[i].isNull[R->row])
+                return 0;
+        if (! R->columns[i].date) {
+                const char *s = _getString(R, columnIndex);
+                return STR_DEF(s) ? Time_toTimestamp(s) : 0;
+        }
+        struct tm tm;
+        _toDateTime(R, i, &tm);
+        tm.tm_year -= 1900;
+        return timegm(&tm);
+}
+
+
+static struct tm *_getDateTime(T R, int columnIndex, struct tm *tm) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (R->columns[i].isNull[R->row])
+                return tm;
+        if (! R->columns[i].date) {
+                const char *s = _getString(R, columnIndex);
+                if (STR_DEF(s))
+                        Time_toDateTime(s, tm);
+                return tm;
+        }
+        return _toDateTime(R, i, tm);
+}
+
+
+static int _readBlob(T R, int columnIndex, void *buffer, int size) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        column_t c = &R->columns[i];
+        if (c->isNull[R->row])
+                return 0;
+        if (c->readRow != R->currentRow) {
+                c->readRow = R->currentRow;
+                c->offset = 1;
+        }
+        if (! c->lob_loc) {
+                const char *s = _getString(R, columnIndex);
+                int length = (int)strlen(s) - (int)(c->offset - 1);
+                if (length <= 0)
+                        return 0;
+                if (length > size)
+                        length = size;
+                memcpy(buffer, s + c->offset - 1, length);
+                c->offset += length;
+                return length;
+        }
+        oraub8 read_bytes = size;
+        oraub8 read_chars = 0;
+        R->lastError = OCILobRead2(R->svc, R->err, c->lob_loc[R->row], &read_bytes, &read_chars, c->offset,
+                                   buffer, size, OCI_ONE_PIECE, NULL, NULL, 0, SQLCS_IMPLICIT);
+        if (R->lastError == OCI_NO_DATA)
+                return 0;
+        if (R->lastError != OCI_SUCCESS && R->lastError != OCI_SUCCESS_WITH_INFO)
+                THROW(SQLException, "%s", OraclePreparedStatement_getLastError(R->lastError, R->err));
+        // CLOB offsets are in characters
+        c->offset += (c->type == SQLT_CLOB) ? read_chars : read_bytes;
+        return (int)read_bytes;
+}
+
+
 static const void *_getBlob(T R, int columnIndex, int *size) {
         assert(R);
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
-        if (R->columns[i].isNull)
+        column_t c = &R->columns[i];
+        if (c->isNull[R->row])
                 return NULL;
-        if (R->columns[i].buffer)
-                FREE(R->columns[i].buffer);
-        oraub8 read_chars = 0;
-        oraub8 read_bytes = 0;
-        oraub8 total_bytes = 0;
-        R->columns[i].buffer = ALLOC(LOB_CHUNK_SIZE);
-        *size = 0;
-        ub1 piece = OCI_FIRST_PIECE;
+        if (c->type == SQLT_STR) {
+                const char *s = c->buffer + (R->row * c->size);
+                *size = (int)strlen(s);
+                return s;
+        }
+        if (! c->lob_loc)
+                THROW(SQLException, "Column %d is not a LOB", columnIndex);
+        // Read the LOB in large pieces into a buffer which is reused between rows
+        int n;
+        unsigned long total = 0;
+        c->readRow = 0;
         do {
-                read_bytes = 0;
-                read_chars = 0;
-                R->lastError = OCILobRead2(R->svc, R->err, R->columns[i].lob_loc, &read_bytes, &read_chars, 1,
-                                           R->columns[i].buffer + total_bytes, LOB_CHUNK_SIZE, piece, NULL, NULL, 0, SQLCS_IMPLICIT);
-                if (read_bytes) {
-                        total_bytes += read_bytes;
-                        piece = OCI_NEXT_PIECE;
-                        R->columns[i].buffer = RESIZE(R->columns[i].buffer, (long)(total_bytes + LOB_CHUNK_SIZE));
+                if (c->capacity - total < LOB_CHUNK_SIZE) {
+                        c->capacity = c->capacity ? c->capacity * 2 : LOB_CHUNK_SIZE;
+                        if (c->buffer)
+                                RESIZE(c->buffer, (long)c->capacity);
+                        else
+                                c->buffer = ALLOC((long)c->capacity);
                 }
-        } while (R->lastError == OCI_NEED_DATA);
-        if (R->lastError != OCI_SUCCESS && R->lastError != OCI_SUCCESS_WITH_INFO) {
-                FREE(R->columns[i].buffer);
-                R->columns[i].buffer = NULL;
-                THROW(SQLException, "%s", OraclePreparedStatement_getLastError(R->lastError, R->err));
-        }
-        *size = R->columns[i].length = (int)total_bytes;
-        return (const void *)R->columns[i].buffer;
+                n = _readBlob(R, columnIndex, c->buffer + total, (int)(c->capacity - total));
+                total += n;
+        } while (n > 0);
+        c->readRow = 0;
+        *size = (int)total;
+        c->length = total;
+        return (const void *)c->buffer;
 }
 
 
@@ -384,7 +629,24 @@ const struct Rop_T oraclerops = {
         .next           = _next,
         .isnull         = _isnull,
         .getString      = _getString,
-        .getBlob        = _getBlob
-        // getTimestamp and getDateTime is handled in ResultSet
+        .getColumnType  = _getColumnType,
+        .getBlob        = _getBlob,
+        .readBlob       = _readBlob,
+        .getTimestamp   = _getTimestamp,
+        .getDateTime    = _getDateTime
 };
 
+
+/* ------------------------------------------------------------ Class methods */
+
+
+void OracleResultSet_freeColumns(OracleColumns_T *columns) {
+        assert(columns);
+        if (*columns) {
+                for (int i = 0; i < (*columns)->columnCount; i++)
+                        FREE((*columns)->meta[i].name);
+                FREE((*columns)->meta);
+                FREE(*columns);
+        }
+}
+
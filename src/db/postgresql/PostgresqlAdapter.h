@@ -28,8 +28,9 @@
 #include <libpq-fe.h>
 
 #include "zdb.h"
+#include "Vector.h"
 
-ResultSetDelegate_T PostgresqlResultSet_new(Connection_T delegator, PGresult *res) __attribute__ ((visibility("hidden")));
+ResultSetDelegate_T PostgresqlResultSet_new(Connection_T delegator, PGresult *res, Vector_T pending) __attribute__ ((visibility("hidden")));
 PreparedStatementDelegate_T PostgresqlPreparedStatement_new(Connection_T delegator, PGconn *db, char *stmt, int parameterCount) __attribute__ ((visibility("hidden")));
 
 #endif
@@ -122,6 +122,44 @@ error:
 }
 
 
+/* A simple query may contain several statements. Read all results, as libpq
+ requires before the connection can be used again. The first error or else the
+ first result with rows is kept in C->res, later results with rows are collected
+ in pending. Like PQexec, stop at COPY which must be handled by the caller */
+static Vector_T _getResults(T C) {
+        Vector_T pending = NULL;
+        C->lastError = PGRES_EMPTY_QUERY;
+        for (PGresult *res; (res = PQgetResult(C->db));) {
+                ExecStatusType status = PQresultStatus(res);
+                if (C->lastError == PGRES_FATAL_ERROR || C->lastError == PGRES_BAD_RESPONSE) {
+                        PQclear(res);
+                } else if (C->lastError == PGRES_TUPLES_OK && status == PGRES_TUPLES_OK) {
+                        if (! pending)
+                                pending = Vector_new(4);
+                        Vector_push(pending, res);
+                } else if (C->lastError == PGRES_TUPLES_OK && status != PGRES_FATAL_ERROR && status != PGRES_BAD_RESPONSE) {
+                        PQclear(res);
+                } else {
+                        PQclear(C->res);
+                        C->res = res;
+                        C->lastError = status;
+                }
+                if (status == PGRES_COPY_IN || status == PGRES_COPY_OUT || status == PGRES_COPY_BOTH)
+                        break;
+        }
+        return pending;
+}
+
+
+static void _freePending(Vector_T *pending) {
+        if (*pending) {
+                while (! Vector_isEmpty(*pending))
+                        PQclear(Vector_pop(*pending));
+                Vector_free(pending);
+        }
+}
+
+
 /* -------------------------------------------------------- Delegate Methods */
 
 
@@ -236,10 +274,16 @@ static ResultSet_T _executeQuery(T C, const char *sql, va_list ap) {
         va_copy(ap_copy, ap);
         StringBuffer_vset(C->sb, sql, ap_copy);
         va_end(ap_copy);
-        C->res = PQexec(C->db, StringBuffer_toString(C->sb));
-        C->lastError = PQresultStatus(C->res);
+        C->res = NULL;
+        if (! PQsendQuery(C->db, StringBuffer_toString(C->sb))) {
+                C->res = PQmakeEmptyPGresult(C->db, PGRES_FATAL_ERROR);
+                C->lastError = PGRES_FATAL_ERROR;
+                return NULL;
+        }
+        Vector_T pending = _getResults(C);
         if (C->lastError == PGRES_TUPLES_OK)
-                return ResultSet_new(PostgresqlResultSet_new(C->delegator, C->res), (Rop_T)&postgresqlrops);
+                return ResultSet_new(PostgresqlResultSet_new(C->delegator, C->res, pending), (Rop_T)&postgresqlrops);
+        _freePending(&pending);
         return NULL;
 }
 
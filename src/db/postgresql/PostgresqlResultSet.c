@@ -50,7 +50,9 @@ struct T {
         int rowCount;
         int currentRow;
         int columnCount;
+        bool ownsResult;
         PGresult *res;
+        Vector_T pending;
         Connection_T delegator;
 };
 #define ISFIRSTOCTDIGIT(CH) ((CH) >= '0' && (CH) <= '3')
@@ -114,19 +116,26 @@ static inline const void *_unescape_bytea(uchar_t *s, int len, int *r) {
         return s;
 }
 
+
+static inline void _setResult(T R, PGresult *res) {
+        R->res = res;
+        R->currentRow = -1;
+        R->columnCount = PQnfields(R->res);
+        R->rowCount = PQntuples(R->res);
+}
+
+
 /* ------------------------------------------------------------- Constructor */
 
 
-T PostgresqlResultSet_new(Connection_T delegator, PGresult *res) {
+T PostgresqlResultSet_new(Connection_T delegator, PGresult *res, Vector_T pending) {
         T R;
         assert(delegator);
         NEW(R);
         R->delegator = delegator;
-        R->res = res;
+        R->pending = pending;
         R->maxRows = Connection_getMaxRows(delegator);
-        R->currentRow = -1;
-        R->columnCount = PQnfields(R->res);
-        R->rowCount = PQntuples(R->res);
+        _setResult(R, res);
         return R;
 }
 
@@ -136,6 +145,14 @@ T PostgresqlResultSet_new(Connection_T delegator, PGresult *res) {
 
 static void _free(T *R) {
         assert(R && *R);
+        // The first result is owned by the Connection or PreparedStatement, pending results by us
+        if ((*R)->ownsResult)
+                PQclear((*R)->res);
+        if ((*R)->pending) {
+                while (! Vector_isEmpty((*R)->pending))
+                        PQclear(Vector_remove((*R)->pending, 0));
+                Vector_free(&(*R)->pending);
+        }
         FREE(*R);
 }
 
@@ -186,6 +203,52 @@ static const char *_getString(T R, int columnIndex) {
 }
 
 
+static const char *_getSString(T R, int columnIndex, int *size) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (PQgetisnull(R->res, R->currentRow, i)) {
+                *size = 0;
+                return NULL;
+        }
+        *size = PQgetlength(R->res, R->currentRow, i);
+        return PQgetvalue(R->res, R->currentRow, i);
+}
+
+
+// Type OIDs from catalog/pg_type.h which is not installed with libpq
+static int _getColumnType(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        switch (PQftype(R->res, i)) {
+                case 20:   // int8
+                case 21:   // int2
+                case 23:   // int4
+                case 26:   // oid
+                        return ResultSet_Integer;
+                case 700:  // float4
+                case 701:  // float8
+                        return ResultSet_Real;
+                case 17:   // bytea
+                        return ResultSet_Blob;
+                case 1082: // date
+                case 1083: // time
+                case 1114: // timestamp
+                case 1184: // timestamptz
+                case 1266: // timetz
+                        return ResultSet_Temporal;
+                case 18:   // char
+                case 19:   // name
+                case 25:   // text
+                case 1042: // bpchar
+                case 1043: // varchar
+                case 1700: // numeric, exact and may not fit a double
+                        return ResultSet_Text;
+                default:
+                        return ResultSet_Unknown;
+        }
+}
+
+
 /*
  * As a "hack" to avoid extra allocation and complications by using PQunescapeBytea()
  * we instead unescape the buffer retrieved via PQgetvalue 'in-place'. This should
@@ -201,6 +264,73 @@ static const void *_getBlob(T R, int columnIndex, int *size) {
 }
 
 
+static bool _nextResult(T R) {
+        assert(R);
+        if (! R->pending || Vector_isEmpty(R->pending))
+                return false;
+        if (R->ownsResult)
+                PQclear(R->res);
+        _setResult(R, Vector_remove(R->pending, 0));
+        R->ownsResult = true;
+        return true;
+}
+
+
+/*
+ * The whole result is in client memory so a batch is decoded column by column
+ * with the column type looked up once. Values are in the text format and
+ * bytea is unescaped into a copy so the value in the result is left intact
+ */
+static int _fetchBatch(T R, int rows, ResultSet_Batch_T batch) {
+        assert(R);
+        int first = R->currentRow + 1;
+        int last = (R->maxRows && R->maxRows < R->rowCount) ? R->maxRows : R->rowCount;
+        int n = last - first < rows ? last - first : rows;
+        if (n <= 0)
+                return 0;
+        for (int i = 0; i < R->columnCount; i++) {
+                int type = _getColumnType(R, i + 1);
+                for (int row = first; row < first + n; row++) {
+                        if (PQgetisnull(R->res, row, i)) {
+                                ResultSet_Batch_addNull(batch, i + 1);
+                                continue;
+                        }
+                        const char *value = PQgetvalue(R->res, row, i);
+                        switch (type) {
+                                case ResultSet_Integer:
+                                        ResultSet_Batch_addLLong(batch, i + 1, Str_parseLLong(value));
+                                        break;
+                                case ResultSet_Real:
+                                        ResultSet_Batch_addDouble(batch, i + 1, Str_parseDouble(value));
+                                        break;
+                                case ResultSet_Blob:
+                                {
+                                        size_t size = 0;
+                                        uchar_t *blob = PQunescapeBytea((const uchar_t*)value, &size);
+                                        if (! blob)
+                                                THROW(SQLException, "Invalid bytea value");
+                                        TRY
+                                        {
+                                                ResultSet_Batch_addBytes(batch, i + 1, ResultSet_Blob, blob, (int)size);
+                                        }
+                                        FINALLY
+                                        {
+                                                PQfreemem(blob);
+                                        }
+                                        END_TRY;
+                                }
+                                        break;
+                                default:
+                                        ResultSet_Batch_addBytes(batch, i + 1, ResultSet_Text, value, PQgetlength(R->res, row, i));
+                                        break;
+                        }
+                }
+        }
+        R->currentRow = first + n - 1;
+        return n;
+}
+
+
 /* ------------------------------------------------------------------------- */
 
 
@@ -213,7 +343,11 @@ const struct Rop_T postgresqlrops = {
         .next           = _next,
         .isnull         = _isnull,
         .getString      = _getString,
-        .getBlob        = _getBlob
+        .getSString     = _getSString,
+        .getColumnType  = _getColumnType,
+        .getBlob        = _getBlob,
+        .nextResult     = _nextResult,
+        .fetchBatch     = _fetchBatch
         // get/setFetchSize is not applicable for Postgres or rather libpq
         // getTimestamp and getDateTime is handled in ResultSet
 };
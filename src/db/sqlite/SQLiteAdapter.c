@@ -25,12 +25,187 @@
 #include "Config.h"
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
 
 #include "Thread.h"
 #include "system/Time.h"
 #include "SQLiteAdapter.h"
 
 
+/*
+ * Lock waits. Connections in this process waiting for a lock on the same
+ * database file share a wait queue. A connection which releases its lock,
+ * when it is not in a transaction and no statement is being stepped, wakes
+ * the waiting connections, so a waiter gets the lock when it is released
+ * instead of after a random sleep. Since the lock may be held by another
+ * process, which cannot wake the queue, a waiter also tries again after a
+ * slice of up to 256 ms. Waits are bounded by a timeout.
+ */
+
+typedef struct SQLiteQueue_S {
+        char *path;
+        int refs;
+        int waiting;
+        long long generation;
+        Sem_T cond;
+        Mutex_T mutex;
+        struct SQLiteQueue_S *next;
+} *SQLiteQueue_T;
+
+static Once_T once_control = PTHREAD_ONCE_INIT;
+static Mutex_T queuesMutex;
+static SQLiteQueue_T queues = NULL;
+static atomic_int waiting = 0;
+// Set by the busy handler if it gave up, the lock wait is then not retried
+static __thread bool gaveUp = false;
+
+
+static void init_once(void) {
+        Mutex_init(queuesMutex);
+}
+
+
+static SQLiteQueue_T _findQueue(const char *path) {
+        for (SQLiteQueue_T q = queues; q; q = q->next)
+                if (Str_isEqual(q->path, path))
+                        return q;
+        return NULL;
+}
+
+
+// Wait until the lock is released in this process or until deadline
+static void _waitQueue(SQLiteQueue_T q, long long deadline) {
+        struct timespec wait = {.tv_sec = deadline / 1000, .tv_nsec = (deadline % 1000) * 1000000};
+        Mutex_lock(q->mutex);
+        long long generation = q->generation;
+        q->waiting++;
+        atomic_fetch_add(&waiting, 1);
+        while (generation == q->generation && Time_milli() < deadline)
+                Sem_timeWait(q->cond, q->mutex, wait);
+        atomic_fetch_sub(&waiting, 1);
+        q->waiting--;
+        Mutex_unlock(q->mutex);
+}
+
+
+// True if db holds no lock, it is not in a transaction and has no statement which is being stepped
+static inline bool _isIdle(sqlite3 *db) {
+        if (! sqlite3_get_autocommit(db))
+                return false;
+        for (sqlite3_stmt *stmt = sqlite3_next_stmt(db, NULL); stmt; stmt = sqlite3_next_stmt(db, stmt))
+                if (sqlite3_stmt_busy(stmt))
+                        return false;
+        return true;
+}
+
+
+// Wake the connections waiting for a lock on the database file of db if db released its lock
+static inline void _release(sqlite3 *db) {
+        if (atomic_load(&waiting) == 0 || ! _isIdle(db))
+                return;
+        const char *path = sqlite3_db_filename(db, "main");
+        if (! path || ! *path)
+                return;
+        LOCK(queuesMutex)
+        {
+                SQLiteQueue_T q = _findQueue(path);
+                if (q) {
+                        Mutex_lock(q->mutex);
+                        if (q->waiting) {
+                                q->generation++;
+                                Sem_broadcast(q->cond);
+                        }
+                        Mutex_unlock(q->mutex);
+                }
+        }
+        END_LOCK;
+}
+
+
+// SQLite busy handler, return non-zero to retry
+static int _busy(void *arg, int count) {
+        SQLiteLock_T *L = arg;
+        long long now = Time_milli();
+        if (count == 0)
+                L->started = now;
+        int timeout = SQLiteTimeout_lock(L->timeout);
+        if (now - L->started >= timeout) {
+                gaveUp = true;
+                ConnectionPool_addLockWaits(L->pool, 0, 0, 1);
+                return 0;
+        }
+        /* Wait at most 1, 2, 4 .. 256 ms before trying again if not woken. Without a
+         queue there is nothing to wake the connection and it sleeps at most 64 ms */
+        int slice = L->queue ? 8 : 6;
+        long long deadline = now + (1 << (count < slice ? count : slice));
+        if (deadline > L->started + timeout)
+                deadline = L->started + timeout;
+        if (L->queue)
+                _waitQueue(L->queue, deadline);
+        else
+                Time_usleep((deadline - now) * 1000);
+        ConnectionPool_addLockWaits(L->pool, count == 0, Time_milli() - now, 0);
+        return 1;
+}
+
+
+void SQLiteLock_init(SQLiteLock_T *L, sqlite3 *db, SQLiteTimeout_T *timeout, ConnectionPool_T pool) {
+        assert(L);
+        assert(db);
+        Thread_once(once_control, init_once);
+        *L = (SQLiteLock_T){.timeout = timeout, .pool = pool};
+        const char *path = sqlite3_db_filename(db, "main");
+        // A private in-memory or temporary database has no file to wait for
+        if (path && *path) {
+                LOCK(queuesMutex)
+                {
+                        if (! (L->queue = _findQueue(path))) {
+                                NEW(L->queue);
+                                L->queue->path = Str_dup(path);
+                                Mutex_init(L->queue->mutex);
+                                Sem_init(L->queue->cond);
+                                L->queue->next = queues;
+                                queues = L->queue;
+                        }
+                        L->queue->refs++;
+                }
+                END_LOCK;
+        }
+        sqlite3_busy_handler(db, _busy, L);
+}
+
+
+void SQLiteLock_release(sqlite3 *db) {
+        assert(db);
+        _release(db);
+}
+
+
+void SQLiteLock_destroy(SQLiteLock_T *L) {
+        assert(L);
+        if (! L->queue)
+                return;
+        LOCK(queuesMutex)
+        {
+                if (--L->queue->refs == 0) {
+                        for (SQLiteQueue_T *q = &queues; *q; q = &(*q)->next) {
+                                if (*q == L->queue) {
+                                        *q = L->queue->next;
+                                        break;
+                                }
+                        }
+                        Sem_destroy(L->queue->cond);
+                        Mutex_destroy(L->queue->mutex);
+                        FREE(L->queue->path);
+                        FREE(L->queue);
+                }
+        }
+        END_LOCK;
+        L->queue = NULL;
+}
+
+
 #if defined SQLITEUNLOCK && SQLITE_VERSION_NUMBER >= 3006012
 
 /*
@@ -40,37 +215,40 @@
 
 typedef struct UnlockNotification {
         int fired;
-        Sem_T cond;
-        Mutex_T mutex;
 } UnlockNotification_T;
 
+// Shared by all waiting threads, a notification is not worth a mutex and condition of its own
+static Once_T unlock_once = PTHREAD_ONCE_INIT;
+static Mutex_T unlockMutex;
+static Sem_T unlockCond;
+
+
+static void unlock_init_once(void) {
+        Mutex_init(unlockMutex);
+        Sem_init(unlockCond);
+}
+
 
 static inline void unlock_notify_cb(void **apArg, int nArg) {
-        for (int i = 0; i < nArg; i++) {
-                UnlockNotification_T *p = (UnlockNotification_T *)apArg[i];
-                Mutex_lock(p->mutex);
-                p->fired = 1;
-                Sem_signal(p->cond);
-                Mutex_unlock(p->mutex);
-        }
+        Mutex_lock(unlockMutex);
+        for (int i = 0; i < nArg; i++)
+                ((UnlockNotification_T *)apArg[i])->fired = 1;
+        Sem_broadcast(unlockCond);
+        Mutex_unlock(unlockMutex);
 }
 
 
 static inline int wait_for_unlock_notify(sqlite3 *db){
-        UnlockNotification_T un;
-        un.fired = 0;
-        Mutex_init(un.mutex);
-        Sem_init(un.cond);
+        UnlockNotification_T un = {.fired = 0};
+        Thread_once(unlock_once, unlock_init_once);
         int rc = sqlite3_unlock_notify(db, unlock_notify_cb, (void *)&un);
         assert(rc == SQLITE_LOCKED || rc == SQLITE_OK);
         if (rc == SQLITE_OK) {
-                Mutex_lock(un.mutex);
-                if (! un.fired)
-                        Sem_wait(un.cond, un.mutex);
-                Mutex_unlock(un.mutex);
+                Mutex_lock(unlockMutex);
+                while (! un.fired)
+                        Sem_wait(unlockCond, unlockMutex);
+                Mutex_unlock(unlockMutex);
         }
-        Sem_destroy(un.cond);
-        Mutex_destroy(un.mutex);
         return rc;
 }
 
@@ -82,6 +260,7 @@ static inline int sqlite3_blocking_exec(sqlite3 *db, const char *zSql, int (*cal
                 if (rc != SQLITE_OK)
                         break;
         }
+        _release(db);
         return rc;
 }
 
@@ -98,6 +277,9 @@ int zdb_sqlite3_step(sqlite3_stmt *pStmt) {
                 sqlite3_reset(pStmt);
 #endif
         }
+        // A statement which returned a row still holds its lock
+        if (rc != SQLITE_ROW)
+                _release(sqlite3_db_handle(pStmt));
         return rc;
 }
 
@@ -120,52 +302,70 @@ int zdb_sqlite3_exec(sqlite3 *db, const char *sql) {
 
 #else // NOT SQLITEUNLOCK
 
+// Thread local xorshift generator, random() takes a process wide lock
+static inline unsigned int _random(void) {
+        static __thread unsigned int x = 0;
+        if (x == 0)
+                x = (unsigned int)(Time_milli() ^ (uintptr_t)&x) | 1;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return x;
+}
+
 // Exponential backoff https://en.wikipedia.org/wiki/Exponential_backoff
 // Expected mean backoff time: (2^10 - 1)/2 × slot = 2.6 seconds
 static inline void _backoff(int step) {
         static int slot = 51 * 100; // µs
         switch (step) {
                 case 0:
-                        Time_usleep(slot * (random() % 2));
+                        Time_usleep(slot * (_random() % 2));
                         break;
                 case 1:
-                        Time_usleep(slot * (random() % 4));
+                        Time_usleep(slot * (_random() % 4));
                         break;
                 default:
                         // slot µs * R[0...2^step - 1]
-                        Time_usleep(slot * (random() % (1 << step)));
+                        Time_usleep(slot * (_random() % (1 << step)));
                         break;
         }
 }
 
 // MARK: - Backoff API
 
-// Backoff statement expression
-#define _exec_or_backoff(S) \
+// Backoff statement expression. A lock wait is not retried if the busy
+// handler of the connection already gave up waiting. A statement which
+// returned a row still holds its lock
+#define _exec_or_backoff(D, S) \
     ({ \
         int __status; \
         for (int __i = 0, __steps = 10; __i < __steps; __i++) { \
+            gaveUp = false; \
             __status = (S); \
             if ((__status != SQLITE_BUSY) && (__status != SQLITE_LOCKED)) \
                 break; \
+            if (gaveUp) \
+                break; \
             _backoff(__i); \
         } \
+        if (__status != SQLITE_ROW) \
+            _release(D); \
         __status; \
     })
 
 
 int zdb_sqlite3_step(sqlite3_stmt *pStmt) {
-        return _exec_or_backoff(sqlite3_step(pStmt));
+        return _exec_or_backoff(sqlite3_db_handle(pStmt), sqlite3_step(pStmt));
 }
 
 
 int zdb_sqlite3_prepare_v2(sqlite3 *db, const char *zSql, int nSql, sqlite3_stmt **ppStmt, const char **pz) {
-        return _exec_or_backoff(sqlite3_prepare_v2(db, zSql, nSql, ppStmt, pz));
+        return _exec_or_backoff(db, sqlite3_prepare_v2(db, zSql, nSql, ppStmt, pz));
 }
 
 
 int zdb_sqlite3_exec(sqlite3 *db, const char *sql) {
-        return _exec_or_backoff(sqlite3_exec(db, sql, NULL, NULL, NULL));
+        return _exec_or_backoff(db, sqlite3_exec(db, sql, NULL, NULL, NULL));
 }
 
 
@@ -29,12 +29,100 @@
 #include <sqlite3.h>
 
 #include "zdb.h"
+#include "system/Time.h"
+
+#define SQLITE_TIMEOUT_ERROR "Query timeout -- statement interrupted after exceeding the query timeout"
 
 int zdb_sqlite3_step(sqlite3_stmt *pStmt) __attribute__ ((visibility("hidden")));
 int zdb_sqlite3_prepare_v2(sqlite3 *db, const char *zSql, int nSql, sqlite3_stmt **ppStmt, const char **pz) __attribute__ ((visibility("hidden")));
 int zdb_sqlite3_exec(sqlite3 *db, const char *sql) __attribute__ ((visibility("hidden")));
 
-ResultSetDelegate_T SQLiteResultSet_new(Connection_T delegator, sqlite3_stmt *stmt, int keep) __attribute__ ((visibility("hidden")));
-PreparedStatementDelegate_T SQLitePreparedStatement_new(Connection_T delegator, sqlite3_stmt *stmt) __attribute__ ((visibility("hidden")));
+/* Query timeout of a connection, checked by a SQLite progress handler. The
+ deadline is restarted before each call which executes SQL */
+typedef struct SQLiteTimeout_T {
+        int ms;
+        long long deadline;
+} SQLiteTimeout_T;
+
+static inline void SQLiteTimeout_start(SQLiteTimeout_T *t) {
+        if (t)
+                t->deadline = t->ms > 0 ? Time_milli() + t->ms : 0;
+}
+
+/* Lock waits are bounded by the query timeout or, if not set, by SQLITE_LOCK_TIMEOUT */
+#define SQLITE_LOCK_TIMEOUT 5000 // ms
+static inline int SQLiteTimeout_lock(SQLiteTimeout_T *t) {
+        return t && t->ms > 0 ? t->ms : SQLITE_LOCK_TIMEOUT;
+}
+
+/* Lock waits of a connection, handled by a SQLite busy handler. Connections
+ in this process waiting for a lock on the same database file share a wait
+ queue and are woken when a connection releases its lock. Waits are
+ bounded by the query timeout and counted in the pool statistics */
+typedef struct SQLiteLock_T {
+        struct SQLiteQueue_S *queue;
+        SQLiteTimeout_T *timeout;
+        ConnectionPool_T pool;
+        long long started;
+} SQLiteLock_T;
+
+void SQLiteLock_init(SQLiteLock_T *L, sqlite3 *db, SQLiteTimeout_T *timeout, ConnectionPool_T pool) __attribute__ ((visibility("hidden")));
+/* Wake connections waiting for a lock held by db if db released it. Called after a statement is reset */
+void SQLiteLock_release(sqlite3 *db) __attribute__ ((visibility("hidden")));
+void SQLiteLock_destroy(SQLiteLock_T *L) __attribute__ ((visibility("hidden")));
+
+/* The ResultSet column type of a SQLite storage class */
+static inline int SQLiteResultSet_columnType(int storageClass) {
+        switch (storageClass) {
+                case SQLITE_NULL: return ResultSet_Null;
+                case SQLITE_INTEGER: return ResultSet_Integer;
+                case SQLITE_FLOAT: return ResultSet_Real;
+                case SQLITE_TEXT: return ResultSet_Text;
+                case SQLITE_BLOB: return ResultSet_Blob;
+        }
+        return ResultSet_Unknown;
+}
+
+/* URL path of an in-memory database, shared by the connections in a pool */
+#define SQLITE_MEMORY_PATH "/:memory:"
+
+typedef struct SQLitePool_S *SQLitePool_T;
+
+/* The outcome of a write executed by the writer connection of a SQLitePool_T */
+typedef struct SQLiteWrite_T {
+        int status;
+        long long changes;
+        long long lastRowId;
+        char error[STRLEN];
+} SQLiteWrite_T;
+
+sqlite3 *SQLiteConnection_open(URL_T url, const char *path, int flags, char **error) __attribute__ ((visibility("hidden")));
+/* Register the native SQL functions added to the pool with the connection */
+bool SQLiteConnection_addFunctions(sqlite3 *db, ConnectionPool_T pool, char **error) __attribute__ ((visibility("hidden")));
+
+SQLitePool_T SQLitePool_get(Connection_T delegator, char **error) __attribute__ ((visibility("hidden")));
+const char *SQLitePool_getMemory(SQLitePool_T P) __attribute__ ((visibility("hidden")));
+sqlite3 *SQLitePool_getWriter(SQLitePool_T P) __attribute__ ((visibility("hidden")));
+bool SQLitePool_isWriting(SQLitePool_T P, Connection_T delegator) __attribute__ ((visibility("hidden")));
+int SQLitePool_execute(SQLitePool_T P, Connection_T delegator, const char *sql, SQLiteTimeout_T *timeout, SQLiteWrite_T *result) __attribute__ ((visibility("hidden")));
+int SQLitePool_step(SQLitePool_T P, Connection_T delegator, sqlite3_stmt *stmt, SQLiteTimeout_T *timeout, SQLiteWrite_T *result) __attribute__ ((visibility("hidden")));
+bool SQLitePool_beginWrite(SQLitePool_T P, Connection_T delegator, const char *sql, SQLiteTimeout_T *timeout, SQLiteWrite_T *result) __attribute__ ((visibility("hidden")));
+bool SQLitePool_endWrite(SQLitePool_T P, Connection_T delegator, const char *sql, SQLiteWrite_T *result) __attribute__ ((visibility("hidden")));
+void SQLitePool_release(SQLitePool_T P, Connection_T delegator) __attribute__ ((visibility("hidden")));
+
+typedef struct SQLiteResultCache_S *SQLiteResultCache_T;
+
+SQLiteResultCache_T SQLiteResultCache_new(sqlite3 *db, int size, ConnectionPool_T pool) __attribute__ ((visibility("hidden")));
+void SQLiteResultCache_free(SQLiteResultCache_T *C) __attribute__ ((visibility("hidden")));
+/* Prepare sql and set cacheable if it only reads and calls no function which is not deterministic */
+int SQLiteResultCache_prepare(SQLiteResultCache_T C, const char *sql, int length, sqlite3_stmt **stmt, const char **tail, bool *cacheable) __attribute__ ((visibility("hidden")));
+ResultSet_T SQLiteResultCache_get(SQLiteResultCache_T C, Connection_T delegator, const char *sql) __attribute__ ((visibility("hidden")));
+/* Read all rows of stmt into the cache, the ResultSet returned owns stmt. On error stmt is finalized, status is set and
+ NULL is returned. NULL with status SQLITE_OK if stmt was not stepped. A result too large to cache is streamed from stmt */
+ResultSet_T SQLiteResultCache_put(SQLiteResultCache_T C, Connection_T delegator, const char *sql, sqlite3_stmt *stmt, SQLiteTimeout_T *timeout, int *status) __attribute__ ((visibility("hidden")));
+
+ResultSetDelegate_T SQLiteResultSet_new(Connection_T delegator, sqlite3_stmt *stmt, int keep, SQLiteTimeout_T *timeout) __attribute__ ((visibility("hidden")));
+ResultSetDelegate_T SQLiteResultSet_resume(Connection_T delegator, sqlite3_stmt *stmt, long long rows, SQLiteTimeout_T *timeout) __attribute__ ((visibility("hidden")));
+PreparedStatementDelegate_T SQLitePreparedStatement_new(Connection_T delegator, sqlite3_stmt *stmt, SQLitePool_T pool, SQLiteWrite_T *last, SQLiteTimeout_T *timeout) __attribute__ ((visibility("hidden")));
 
 #endif
@@ -26,6 +26,7 @@
 #include "Config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "StringBuffer.h"
 #include "SQLiteAdapter.h"
@@ -47,10 +48,18 @@ struct T {
         sqlite3 *db;
         int maxRows;
         int lastError;
+        bool wrote;
         StringBuffer_T sb;
+        SQLitePool_T pool;
+        SQLiteResultCache_T cache;
+        SQLiteWrite_T write;
+        SQLiteTimeout_T timeout;
+        SQLiteLock_T lock;
         Connection_T delegator;
 };
-static int kQueryTimeoutDelta = 5;
+static int kProgressSteps = 1000;
+// Text encoding bits of the flags given to sqlite3_create_function_v2()
+#define ENCODING_MASK (SQLITE_UTF8 | SQLITE_UTF16LE | SQLITE_UTF16BE | SQLITE_UTF16)
 extern const struct Rop_T sqlite3rops;
 extern const struct Pop_T sqlite3pops;
 
@@ -88,17 +97,21 @@ static int _options(URL_T url) {
 }
 
 
-static sqlite3 *_doConnect(Connection_T delegator, char **error) {
+// Open the database in the URL or, if path is not NULL, the database at path
+static sqlite3 *_doConnect(URL_T url, const char *path, int flags, char **error) {
         int status;
         sqlite3 *db;
-        URL_T url = Connection_getURL(delegator);
-        const char *path = URL_getPath(url);
+        if (! path)
+                path = URL_getPath(url);
         if (! path) {
                 *error = Str_dup("no database specified in URL");
                 return NULL;
         }
 #if SQLITE_VERSION_NUMBER >= 3005000
-        status = sqlite3_open_v2(path, &db, _options(url) , NULL);
+        int options = _options(url) | flags;
+        if (flags & SQLITE_OPEN_FULLMUTEX)
+                options &= ~SQLITE_OPEN_NOMUTEX;
+        status = sqlite3_open_v2(path, &db, options, NULL);
 #else
         status = sqlite3_open(path, &db);
 #endif
@@ -111,22 +124,65 @@ static sqlite3 *_doConnect(Connection_T delegator, char **error) {
 }
 
 
-static bool _setProperties(T C, char **error) {
-        URL_T url = Connection_getURL(C->delegator);
+static bool _setProperties(sqlite3 *db, URL_T url, StringBuffer_T sb, char **error) {
         const char **properties = URL_getParameterNames(url);
-        const char *handled_properties[] = {"serialized", "shared-cache", NULL};
+        const char *handled_properties[] = {"serialized", "shared-cache", "write-queue", "maintenance", "memory-replica", "replica-refresh", "result-cache", NULL};
         if (properties) {
-                StringBuffer_clear(C->sb);
+                StringBuffer_clear(sb);
                 for (int i = 0; properties[i]; i++) {
                         if (Str_member(properties[i], handled_properties)) {
                                 continue; // Handled in _doConnect, ignore
                         } else {
-                                StringBuffer_append(C->sb, "PRAGMA %s = %s; ", properties[i], URL_getParameter(url, properties[i]));
+                                StringBuffer_append(sb, "PRAGMA %s = %s; ", properties[i], URL_getParameter(url, properties[i]));
                         }
                 }
-                C->lastError = zdb_sqlite3_exec(C->db, StringBuffer_toString(C->sb));
-                if (C->lastError != SQLITE_OK) {
-                        *error = Str_cat("unable to set database pragmas -- %s", sqlite3_errmsg(C->db));
+                // The maintenance thread checkpoints the WAL instead of the writer committing
+                if (URL_getParameter(url, "maintenance") && ! URL_getParameter(url, "wal_autocheckpoint"))
+                        StringBuffer_append(sb, "PRAGMA wal_autocheckpoint = 0; ");
+                if (zdb_sqlite3_exec(db, StringBuffer_toString(sb)) != SQLITE_OK) {
+                        *error = Str_cat("unable to set database pragmas -- %s", sqlite3_errmsg(db));
+                        return false;
+                }
+        }
+        return true;
+}
+
+
+// The connection used for statements. Inside a write-queue transaction this is the pool's writer
+static inline sqlite3 *_db(T C) {
+        if (C->pool && SQLitePool_isWriting(C->pool, C->delegator))
+                return SQLitePool_getWriter(C->pool);
+        return C->db;
+}
+
+
+// Progress handler interrupting a statement which runs past the query timeout
+static int _checkTimeout(void *ctx) {
+        SQLiteTimeout_T *timeout = ctx;
+        return (timeout->deadline > 0 && Time_milli() > timeout->deadline);
+}
+
+
+/* ----------------------------------------------------- Protected methods */
+
+
+bool SQLiteConnection_addFunctions(sqlite3 *db, ConnectionPool_T pool, char **error) {
+        const ConnectionPool_Function *f;
+        for (int i = 0; (f = ConnectionPool_getFunction(pool, i)); i++) {
+                int flags = (f->flags & ENCODING_MASK) ? f->flags : f->flags | SQLITE_UTF8;
+                int status;
+                if (f->inverse) {
+#if SQLITE_VERSION_NUMBER >= 3025000
+                        status = sqlite3_create_window_function(db, f->name, f->arguments, flags, f->context, f->step, f->final, f->value, f->inverse, NULL);
+#else
+                        *error = Str_cat("unable to add window function '%s' -- requires SQLite 3.25 or later", f->name);
+                        return false;
+#endif
+                } else {
+                        status = sqlite3_create_function_v2(db, f->name, f->arguments, flags, f->context, f->function, f->step, f->final, NULL);
+                }
+                if (status != SQLITE_OK) {
+                        *error = Str_cat("unable to add function '%s' -- %s", f->name, sqlite3_errmsg(db));
                         return false;
                 }
         }
@@ -134,13 +190,32 @@ static bool _setProperties(T C, char **error) {
 }
 
 
+sqlite3 *SQLiteConnection_open(URL_T url, const char *path, int flags, char **error) {
+        sqlite3 *db = _doConnect(url, path, path ? flags | SQLITE_OPEN_URI : flags, error);
+        if (db) {
+                StringBuffer_T sb = StringBuffer_create(STRLEN);
+                if (! _setProperties(db, url, sb, error)) {
+                        sqlite3_close(db);
+                        db = NULL;
+                }
+                StringBuffer_free(&sb);
+        }
+        return db;
+}
+
+
 /* -------------------------------------------------------- Delegate Methods */
 
 
 static void _free(T *C) {
         assert(C && *C);
+        if ((*C)->pool)
+                SQLitePool_release((*C)->pool, (*C)->delegator);
+        if ((*C)->cache)
+                SQLiteResultCache_free(&(*C)->cache);
         while (sqlite3_close((*C)->db) == SQLITE_BUSY)
                 Time_usleep(10);
+        SQLiteLock_destroy(&(*C)->lock);
         StringBuffer_free(&((*C)->sb));
         FREE(*C);
 }
@@ -151,23 +226,52 @@ static T _new(Connection_T delegator, char **error) {
         assert(delegator);
         assert(error);
         sqlite3 *db;
-        if (! (db = _doConnect(delegator, error)))
+        SQLitePool_T shared = NULL;
+        URL_T url = Connection_getURL(delegator);
+        bool writeQueue = Str_parseBool(URL_getParameter(url, "write-queue"));
+        bool replica = Str_parseBool(URL_getParameter(url, "memory-replica"));
+        // State shared by the pool's connections: writer, maintenance thread or in-memory database
+        if (writeQueue || replica || URL_getParameter(url, "maintenance") || Str_isEqual(URL_getPath(url), SQLITE_MEMORY_PATH)) {
+                if (! (shared = SQLitePool_get(delegator, error)))
+                        return NULL;
+        }
+        // Writes are sent to the pool's writer connection, this connection is read-only
+        SQLitePool_T pool = writeQueue ? shared : NULL;
+        // Open the pool's in-memory database or replica if any
+        const char *path = shared ? SQLitePool_getMemory(shared) : NULL;
+        if (! (db = _doConnect(url, path, path ? SQLITE_OPEN_URI : 0, error)))
                 return NULL;
         NEW(C);
         C->db = db;
+        C->pool = pool;
         C->delegator = delegator;
-        // Set a minimal timeout to install a busy_timeout handler. Actual concurrency timeout is handled by
-        // SQLiteAdapter.h methods using either unlock notify or a backoff retry strategy
-        sqlite3_busy_timeout(C->db, kQueryTimeoutDelta);
+        // Lock waits are handled by a busy handler which wakes the connection when the lock is released,
+        // SQLITE_LOCKED is handled by SQLiteAdapter.h methods using either unlock notify or backoff retry
+        SQLiteLock_init(&C->lock, C->db, &C->timeout, Connection_getPool(delegator));
         C->sb = StringBuffer_create(STRLEN);
-        if (! _setProperties(C, error))
+        if (! _setProperties(C->db, url, C->sb, error) || ! SQLiteConnection_addFunctions(C->db, Connection_getPool(delegator), error)) {
+                _free(&C);
+        } else if ((pool || replica) && zdb_sqlite3_exec(C->db, "PRAGMA query_only = true;") != SQLITE_OK) {
+                *error = Str_cat("unable to make connection read-only -- %s", sqlite3_errmsg(C->db));
                 _free(&C);
+        } else if (URL_getParameter(url, "result-cache")) {
+                const char *size = URL_getParameter(url, "result-cache");
+                int entries = (int)strtol(size, NULL, 10);
+                if (entries <= 0) {
+                        *error = Str_cat("invalid result cache size '%s' -- expected number of entries", size);
+                        _free(&C);
+                } else if (! (C->cache = SQLiteResultCache_new(C->db, entries, Connection_getPool(delegator)))) {
+                        *error = Str_cat("unable to create result cache -- %s", sqlite3_errmsg(C->db));
+                        _free(&C);
+                }
+        }
         return C;
 }
 
 
 static bool _ping(T C) {
         assert(C);
+        C->wrote = false;
         C->lastError = zdb_sqlite3_exec(C->db, "select 1;");
         return (C->lastError == SQLITE_OK);
 }
@@ -175,9 +279,13 @@ static bool _ping(T C) {
 
 static void _setQueryTimeout(T C, int ms) {
         assert(C);
-        if (ms <= 0)
-                ms = kQueryTimeoutDelta; // Ensure a minimal timeout to install a busy_timeout handler
-        sqlite3_busy_timeout(C->db, ms);
+        // Bound execution time, lock waits are also bounded by the busy handler
+        C->timeout.ms = ms;
+        C->timeout.deadline = 0;
+        if (ms > 0)
+                sqlite3_progress_handler(C->db, kProgressSteps, _checkTimeout, &C->timeout);
+        else
+                sqlite3_progress_handler(C->db, 0, NULL, NULL);
 }
 
 
@@ -194,33 +302,53 @@ static bool _beginTransactionType(T C, TRANSACTION_TYPE type) {
         default:
             sql = "BEGIN TRANSACTION;";
     }
-    C->lastError = zdb_sqlite3_exec(C->db, sql);
+    C->wrote = false;
+    if (C->pool) {
+        C->wrote = true;
+        C->lastError = SQLitePool_beginWrite(C->pool, C->delegator, sql, &C->timeout, &C->write) ? SQLITE_OK : C->write.status;
+    } else {
+        C->lastError = zdb_sqlite3_exec(C->db, sql);
+    }
     return (C->lastError == SQLITE_OK);
 }
 
 
+static bool _endTransaction(T C, const char *sql) {
+        C->wrote = false;
+        if (C->pool) {
+                C->wrote = true;
+                C->lastError = SQLitePool_endWrite(C->pool, C->delegator, sql, &C->write) ? SQLITE_OK : C->write.status;
+        } else {
+                C->lastError = zdb_sqlite3_exec(C->db, sql);
+        }
+        return (C->lastError == SQLITE_OK);
+}
+
+
 static bool _commit(T C) {
         assert(C);
-        C->lastError = zdb_sqlite3_exec(C->db, "COMMIT TRANSACTION;");
-        return (C->lastError == SQLITE_OK);
+        return _endTransaction(C, "COMMIT TRANSACTION;");
 }
 
 
 static bool _rollback(T C) {
         assert(C);
-        C->lastError = zdb_sqlite3_exec(C->db, "ROLLBACK TRANSACTION;");
-        return (C->lastError == SQLITE_OK);
+        return _endTransaction(C, "ROLLBACK TRANSACTION;");
 }
 
 
 static long long _lastRowId(T C) {
         assert(C);
+        if (C->pool)
+                return C->write.lastRowId;
         return sqlite3_last_insert_rowid(C->db);
 }
 
 
 static long long _rowsChanged(T C) {
         assert(C);
+        if (C->pool)
+                return C->write.changes;
         return (long long)sqlite3_changes(C->db);
 }
 
@@ -231,7 +359,14 @@ static bool _execute(T C, const char *sql, va_list ap) {
         va_copy(ap_copy, ap);
         StringBuffer_vset(C->sb, sql, ap_copy);
         va_end(ap_copy);
-        C->lastError = zdb_sqlite3_exec(C->db, StringBuffer_toString(C->sb));
+        C->wrote = false;
+        if (C->pool) {
+                C->wrote = true;
+                C->lastError = SQLitePool_execute(C->pool, C->delegator, StringBuffer_toString(C->sb), &C->timeout, &C->write);
+        } else {
+                SQLiteTimeout_start(&C->timeout);
+                C->lastError = zdb_sqlite3_exec(C->db, StringBuffer_toString(C->sb));
+        }
         return (C->lastError == SQLITE_OK);
 }
 
@@ -244,9 +379,26 @@ static ResultSet_T _executeQuery(T C, const char *sql, va_list ap) {
         va_copy(ap_copy, ap);
         StringBuffer_vset(C->sb, sql, ap_copy);
         va_end(ap_copy);
-        C->lastError = zdb_sqlite3_prepare_v2(C->db, StringBuffer_toString(C->sb), StringBuffer_length(C->sb), &stmt, &tail);
-        if (C->lastError == SQLITE_OK)
-                return ResultSet_new(SQLiteResultSet_new(C->delegator, stmt, false), (Rop_T)&sqlite3rops);
+        C->wrote = false;
+        // Not inside a transaction, the data version does not change with the transaction's own writes
+        bool cache = C->cache && _db(C) == C->db && sqlite3_get_autocommit(C->db);
+        if (cache) {
+                ResultSet_T r = SQLiteResultCache_get(C->cache, C->delegator, StringBuffer_toString(C->sb));
+                if (r)
+                        return r;
+                C->lastError = SQLiteResultCache_prepare(C->cache, StringBuffer_toString(C->sb), StringBuffer_length(C->sb), &stmt, &tail, &cache);
+        } else {
+                C->lastError = zdb_sqlite3_prepare_v2(_db(C), StringBuffer_toString(C->sb), StringBuffer_length(C->sb), &stmt, &tail);
+        }
+        if (C->lastError == SQLITE_OK) {
+                if (cache) {
+                        ResultSet_T r = SQLiteResultCache_put(C->cache, C->delegator, StringBuffer_toString(C->sb), stmt, &C->timeout, &C->lastError);
+                        // Not run again on error, stmt is finalized
+                        if (r || C->lastError != SQLITE_OK)
+                                return r;
+                }
+                return ResultSet_new(SQLiteResultSet_new(C->delegator, stmt, false, &C->timeout), (Rop_T)&sqlite3rops);
+        }
         return NULL;
 }
 
@@ -259,17 +411,81 @@ static PreparedStatement_T _prepareStatement(T C, const char *sql, va_list ap) {
         va_copy(ap_copy, ap);
         StringBuffer_vset(C->sb, sql, ap_copy);
         va_end(ap_copy);
-        C->lastError = zdb_sqlite3_prepare_v2(C->db, StringBuffer_toString(C->sb), -1, &stmt, &tail);
+        // Read-only statements are prepared on this connection so they can be queried after the transaction
+        sqlite3 *db = C->db;
+        C->wrote = false;
+        C->lastError = zdb_sqlite3_prepare_v2(db, StringBuffer_toString(C->sb), -1, &stmt, &tail);
+        if (C->lastError == SQLITE_OK && C->pool && ! sqlite3_stmt_readonly(stmt)) {
+                // Write statements are prepared on the writer connection and executed via the write queue
+                sqlite3_finalize(stmt);
+                db = SQLitePool_getWriter(C->pool);
+                C->lastError = zdb_sqlite3_prepare_v2(db, StringBuffer_toString(C->sb), -1, &stmt, &tail);
+        }
         if (C->lastError == SQLITE_OK) {
-                return PreparedStatement_new(SQLitePreparedStatement_new(C->delegator, stmt), (Pop_T)&sqlite3pops);
+                return PreparedStatement_new(SQLitePreparedStatement_new(C->delegator, stmt, db != C->db ? C->pool : NULL, &C->write, &C->timeout), (Pop_T)&sqlite3pops);
         }
         return NULL;
 }
 
 
+// Read or write with incremental blob I/O. The error is kept in C->write, closing the blob resets the connection's error
+static int _blobIO(T C, sqlite3 *db, const char *table, const char *column, long long rowId, int offset, void *buffer, int size, bool write) {
+        sqlite3_blob *blob;
+        C->wrote = true;
+        *C->write.error = 0;
+        C->lastError = sqlite3_blob_open(db, "main", table, column, rowId, write, &blob);
+        if (C->lastError != SQLITE_OK) {
+                snprintf(C->write.error, sizeof(C->write.error), "%s", sqlite3_errmsg(db));
+                return -1;
+        }
+        int bytes = sqlite3_blob_bytes(blob);
+        int n = offset < bytes ? (size < bytes - offset ? size : bytes - offset) : 0;
+        if (write && n < size) {
+                C->lastError = SQLITE_ERROR;
+                snprintf(C->write.error, sizeof(C->write.error), "cannot write %d bytes at offset %d to a blob of %d bytes", size, offset, bytes);
+        } else if (n > 0) {
+                C->lastError = write ? sqlite3_blob_write(blob, buffer, n, offset) : sqlite3_blob_read(blob, buffer, n, offset);
+                if (C->lastError != SQLITE_OK)
+                        snprintf(C->write.error, sizeof(C->write.error), "%s", sqlite3_errmsg(db));
+        }
+        int status = sqlite3_blob_close(blob);
+        if (C->lastError == SQLITE_OK && (C->lastError = status) != SQLITE_OK)
+                snprintf(C->write.error, sizeof(C->write.error), "%s", sqlite3_errmsg(db));
+        return C->lastError == SQLITE_OK ? n : -1;
+}
+
+
+static int _readBlob(T C, const char *table, const char *column, long long rowId, int offset, void *buffer, int size) {
+        assert(C);
+        return _blobIO(C, _db(C), table, column, rowId, offset, buffer, size, false);
+}
+
+
+static bool _writeBlob(T C, const char *table, const char *column, long long rowId, int offset, const void *buffer, int size) {
+        assert(C);
+        if (! C->pool || SQLitePool_isWriting(C->pool, C->delegator))
+                return _blobIO(C, _db(C), table, column, rowId, offset, (void *)buffer, size, true) >= 0;
+        // With a write queue the blob is written on the writer connection in a transaction of its own
+        if (! _beginTransactionType(C, TRANSACTION_IMMEDIATE))
+                return false;
+        if (_blobIO(C, _db(C), table, column, rowId, offset, (void *)buffer, size, true) < 0) {
+                SQLiteWrite_T error = C->write;
+                _rollback(C);
+                C->write = error;
+                C->wrote = true;
+                return false;
+        }
+        return _commit(C);
+}
+
+
 static const char *_getLastError(T C) {
         assert(C);
-        return sqlite3_errmsg(C->db);
+        if (C->wrote)
+                return C->write.error;
+        if (C->lastError == SQLITE_INTERRUPT)
+                return SQLITE_TIMEOUT_ERROR;
+        return sqlite3_errmsg(_db(C));
 }
 
 
@@ -290,6 +506,8 @@ const struct Cop_T sqlite3cops = {
         .execute	        = _execute,
         .executeQuery	        = _executeQuery,
         .prepareStatement       = _prepareStatement,
+        .readBlob               = _readBlob,
+        .writeBlob              = _writeBlob,
         .getLastError	        = _getLastError
 };
 
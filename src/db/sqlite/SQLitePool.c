@@ -0,0 +1,700 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#include "Config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "Thread.h"
+#include "Vector.h"
+#include "system/Time.h"
+#include "SQLiteAdapter.h"
+
+
+/**
+ * SQLite state shared by all connections in a ConnectionPool.
+ *
+ * With the URL property `write-queue=true` the pool owns one writer
+ * connection served by a writer thread. Connections submit their writes
+ * to a queue and the writer thread executes all pending writes in one
+ * transaction, so writers never compete for the database lock and the
+ * pooled connections, which are read-only, never see SQLITE_BUSY. VACUUM
+ * and PRAGMA statements, which may not run in a transaction, are executed
+ * alone outside of a group.
+ *
+ * A Connection starting a transaction takes the writer lease and runs
+ * its statements directly on the writer connection until commit or
+ * rollback. Queued writes wait while the lease is held. Waits for the
+ * lease or for a queued write are bounded by the connection's query
+ * timeout, or SQLITE_LOCK_TIMEOUT, and fail with SQLITE_BUSY as a lock
+ * wait does without a write queue. A prepared
+ * statement which only reads is prepared on the pooled connection and
+ * does not see uncommitted changes of the transaction.
+ *
+ * With the URL property `maintenance=<seconds>` a maintenance thread with
+ * its own connection checkpoints the WAL at this interval, so writers no
+ * longer pay for automatic checkpoints. A passive checkpoint never waits
+ * for readers or writers. When the WAL has grown past the autocheckpoint
+ * limit and no connections are in use, the checkpoint is escalated to
+ * truncate the WAL, and the query planner statistics are updated and free
+ * pages released with incremental vacuum if the database has changed.
+ *
+ * With the URL property `memory-replica=true` the database file is copied
+ * at start into an in-memory database, using the memdb VFS, and pooled
+ * connections read from this replica. The pool keeps a connection open to
+ * the replica so it lives as long as the pool. With `replica-refresh=<seconds>`
+ * a refresh thread copies the file again when it has changed. The file is
+ * first copied into a private in-memory database so readers of the replica
+ * only wait for a copy from memory to memory.
+ *
+ * A `sqlite:///:memory:` URL gives an in-memory database shared by all
+ * connections in the pool. As for the replica, the pool keeps a connection
+ * open to the database, which is deleted when the pool stops.
+ *
+ * @file
+ */
+
+
+/* ----------------------------------------------------------- Definitions */
+
+
+typedef struct job_t {
+        const char *sql;
+        sqlite3_stmt *stmt;
+        bool done;
+        SQLiteWrite_T *result;
+} *job_t;
+#define T SQLitePool_T
+struct SQLitePool_S {
+        sqlite3 *db;
+        bool stop;
+        Vector_T queue;
+        Thread_T writer;
+        Mutex_T mutex;
+        Sem_T work;
+        Sem_T done;
+        Sem_T lease;
+        bool writing;
+        Connection_T owner;
+        ConnectionPool_T pool;
+        sqlite3 *maintenanceDb;
+        Thread_T maintenance;
+        Sem_T alarm;
+        int interval;
+        int walLimit;
+        int dataVersion;
+        sqlite3 *source;
+        sqlite3 *memory;
+        char memoryPath[64];
+        Thread_T refresher;
+        int refresh;
+        int sourceVersion;
+        ConnectionPool_Statistics statistics;
+};
+#define MAX_GROUP 256
+#define DEFAULT_WAL_LIMIT 1000 // SQLite's default wal_autocheckpoint
+#define VACUUM_PAGES 1000
+#define MAINTENANCE_BUSY_TIMEOUT 100
+
+
+/* ------------------------------------------------------- Private methods */
+
+
+static void _setResult(T P, int status, SQLiteWrite_T *result) {
+        result->status = status;
+        result->changes = sqlite3_changes(P->db);
+        result->lastRowId = sqlite3_last_insert_rowid(P->db);
+        *result->error = 0;
+        if (status != SQLITE_OK && status != SQLITE_DONE && status != SQLITE_ROW)
+                snprintf(result->error, sizeof(result->error), "%s", sqlite3_errmsg(P->db));
+}
+
+
+static int _run(T P, const char *sql, sqlite3_stmt *stmt, SQLiteWrite_T *result) {
+        int status;
+        if (sql) {
+                status = zdb_sqlite3_exec(P->db, sql);
+        } else {
+                status = zdb_sqlite3_step(stmt);
+        }
+        _setResult(P, status, result);
+        if (stmt)
+                sqlite3_reset(stmt);
+        return status;
+}
+
+
+static void _setBusy(SQLiteWrite_T *result) {
+        *result = (SQLiteWrite_T){.status = SQLITE_BUSY};
+        snprintf(result->error, sizeof(result->error), "%s", sqlite3_errstr(SQLITE_BUSY));
+}
+
+
+static inline struct timespec _timespec(long long milli) {
+        return (struct timespec){.tv_sec = milli / 1000, .tv_nsec = (milli % 1000) * 1000000};
+}
+
+
+// The owner is set and cleared by the lease holder and read by other threads
+static bool _isOwner(T P, Connection_T delegator) {
+        Mutex_lock(P->mutex);
+        bool owner = (P->owner == delegator);
+        Mutex_unlock(P->mutex);
+        return owner;
+}
+
+
+/* Take the write lease when neither a transaction nor the writer thread holds it.
+ Wait at most the lock timeout, as a lock wait without the write queue would */
+static bool _acquire(T P, Connection_T delegator, SQLiteTimeout_T *timeout, SQLiteWrite_T *result) {
+        long long start = Time_milli(), deadline = start + SQLiteTimeout_lock(timeout);
+        struct timespec wait = _timespec(deadline);
+        Mutex_lock(P->mutex);
+        bool waited = (P->owner || P->writing);
+        while ((P->owner || P->writing) && Time_milli() < deadline)
+                Sem_timeWait(P->lease, P->mutex, wait);
+        bool acquired = (! P->owner && ! P->writing);
+        if (acquired)
+                P->owner = delegator;
+        Mutex_unlock(P->mutex);
+        if (waited)
+                ConnectionPool_addLockWaits(P->pool, 1, Time_milli() - start, ! acquired);
+        if (! acquired)
+                _setBusy(result);
+        return acquired;
+}
+
+
+static void _release(T P) {
+        Mutex_lock(P->mutex);
+        P->owner = NULL;
+        Sem_broadcast(P->lease);
+        // Queued writes waited for the transaction to end
+        Sem_signal(P->work);
+        Mutex_unlock(P->mutex);
+}
+
+
+// VACUUM and some pragmas, such as journal_mode, cannot run in a transaction and are executed alone
+static bool _isStandalone(job_t job) {
+        const char *sql = job->sql ? job->sql : sqlite3_sql(job->stmt);
+        while (sql && isspace((unsigned char)*sql))
+                sql++;
+        return sql && (strncasecmp(sql, "VACUUM", 6) == 0 || strncasecmp(sql, "PRAGMA", 6) == 0);
+}
+
+
+/* Execute a group of queued writes in one transaction. Each write runs in
+ a savepoint so a failing write does not affect the others */
+static void _commitGroup(T P, job_t *jobs, int count) {
+        bool group = count > 1 && sqlite3_get_autocommit(P->db) && zdb_sqlite3_exec(P->db, "BEGIN IMMEDIATE TRANSACTION;") == SQLITE_OK;
+        for (int i = 0; i < count; i++) {
+                if (group)
+                        sqlite3_exec(P->db, "SAVEPOINT zdb_write;", NULL, NULL, NULL);
+                int status = _run(P, jobs[i]->sql, jobs[i]->stmt, jobs[i]->result);
+                if (group) {
+                        if (status != SQLITE_OK && status != SQLITE_DONE && status != SQLITE_ROW)
+                                sqlite3_exec(P->db, "ROLLBACK TO zdb_write;", NULL, NULL, NULL);
+                        sqlite3_exec(P->db, "RELEASE zdb_write;", NULL, NULL, NULL);
+                }
+        }
+        if (group) {
+                int status = zdb_sqlite3_exec(P->db, "COMMIT TRANSACTION;");
+                if (status != SQLITE_OK) {
+                        // Nothing in the group was written, fail all writes
+                        SQLiteWrite_T error;
+                        _setResult(P, status, &error);
+                        for (int i = 0; i < count; i++)
+                                *jobs[i]->result = error;
+                        sqlite3_exec(P->db, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
+                }
+        }
+}
+
+
+static void *_writer(void *args) {
+        T P = args;
+        job_t jobs[MAX_GROUP];
+        Mutex_lock(P->mutex);
+        while (! P->stop || ! Vector_isEmpty(P->queue)) {
+                // Queued writes wait while a transaction holds the lease
+                if (Vector_isEmpty(P->queue) || P->owner) {
+                        Sem_wait(P->work, P->mutex);
+                        continue;
+                }
+                int count = 0;
+                while (count < MAX_GROUP && ! Vector_isEmpty(P->queue)) {
+                        if (count > 0 && _isStandalone(Vector_get(P->queue, 0)))
+                                break;
+                        jobs[count++] = Vector_remove(P->queue, 0);
+                        if (_isStandalone(jobs[0]))
+                                break;
+                }
+                P->writing = true;
+                Mutex_unlock(P->mutex);
+                _commitGroup(P, jobs, count);
+                Mutex_lock(P->mutex);
+                P->writing = false;
+                for (int i = 0; i < count; i++)
+                        jobs[i]->done = true;
+                Sem_broadcast(P->done);
+                Sem_broadcast(P->lease);
+        }
+        Mutex_unlock(P->mutex);
+        return NULL;
+}
+
+
+static int _submit(T P, Connection_T delegator, const char *sql, sqlite3_stmt *stmt, SQLiteTimeout_T *timeout, SQLiteWrite_T *result) {
+        // The lease holder is inside a transaction on the writer connection
+        if (_isOwner(P, delegator))
+                return _run(P, sql, stmt, result);
+        struct job_t job = {.sql = sql, .stmt = stmt, .result = result};
+        long long start = Time_milli(), deadline = start + SQLiteTimeout_lock(timeout);
+        struct timespec wait = _timespec(deadline);
+        Mutex_lock(P->mutex);
+        Vector_push(P->queue, &job);
+        Sem_signal(P->work);
+        while (! job.done) {
+                // A write still queued when the timeout expires is withdrawn, once started it is waited for
+                int i = Vector_indexOf(P->queue, &job);
+                if (i < 0) {
+                        Sem_wait(P->done, P->mutex);
+                } else if (Time_milli() >= deadline) {
+                        Vector_remove(P->queue, i);
+                        break;
+                } else {
+                        Sem_timeWait(P->done, P->mutex, wait);
+                }
+        }
+        Mutex_unlock(P->mutex);
+        if (! job.done) {
+                ConnectionPool_addLockWaits(P->pool, 1, Time_milli() - start, 1);
+                _setBusy(result);
+        }
+        return result->status;
+}
+
+
+// Return the integer value of a pragma or -1 on error
+static int _pragma(sqlite3 *db, const char *sql) {
+        int value = -1;
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK) {
+                if (sqlite3_step(stmt) == SQLITE_ROW)
+                        value = sqlite3_column_int(stmt, 0);
+                sqlite3_finalize(stmt);
+        }
+        return value;
+}
+
+
+static bool _isIdle(T P) {
+        if (ConnectionPool_active(P->pool) > 0)
+                return false;
+        bool idle = true;
+        if (P->db) {
+                Mutex_lock(P->mutex);
+                idle = Vector_isEmpty(P->queue) && ! P->owner;
+                Mutex_unlock(P->mutex);
+        }
+        return idle;
+}
+
+
+static void _checkpoint(T P, bool idle) {
+        int frames = 0, checkpointed = 0;
+        long long start = Time_milli();
+        int status = sqlite3_wal_checkpoint_v2(P->maintenanceDb, NULL, SQLITE_CHECKPOINT_PASSIVE, &frames, &checkpointed);
+        // Only reset the WAL when no connection is in use, truncate waits for readers and blocks writers
+        if (status == SQLITE_OK && idle && frames > P->walLimit)
+                status = sqlite3_wal_checkpoint_v2(P->maintenanceDb, NULL, SQLITE_CHECKPOINT_TRUNCATE, &frames, &checkpointed);
+        long long elapsed = Time_milli() - start;
+        if (status != SQLITE_OK && status != SQLITE_BUSY) {
+                DEBUG("SQLite: WAL checkpoint failed -- %s\n", sqlite3_errmsg(P->maintenanceDb));
+                return;
+        }
+        // frames is -1 if the database is not in WAL mode
+        long long walSize = frames > 0 ? 32 + (long long)frames * (24 + _pragma(P->maintenanceDb, "PRAGMA page_size;")) : 0;
+        Mutex_lock(P->mutex);
+        P->statistics.checkpoints++;
+        P->statistics.checkpointTime = elapsed;
+        if (elapsed > P->statistics.checkpointMaxTime)
+                P->statistics.checkpointMaxTime = elapsed;
+        P->statistics.walFrames = frames > 0 ? frames : 0;
+        P->statistics.walSize = walSize;
+        Mutex_unlock(P->mutex);
+}
+
+
+// Update planner statistics and release free pages, only if the database changed since last time
+static void _optimize(T P) {
+        int dataVersion = _pragma(P->maintenanceDb, "PRAGMA data_version;");
+        if (dataVersion == P->dataVersion)
+                return;
+        // Tried again next time if the database is busy
+        if (zdb_sqlite3_exec(P->maintenanceDb, "PRAGMA optimize;") != SQLITE_OK)
+                return;
+        int vacuumed = 0;
+        if (_pragma(P->maintenanceDb, "PRAGMA auto_vacuum;") == 2) { // INCREMENTAL
+                int pages = _pragma(P->maintenanceDb, "PRAGMA freelist_count;");
+                if (pages > 0) {
+                        char sql[64];
+                        snprintf(sql, sizeof(sql), "PRAGMA incremental_vacuum(%d);", VACUUM_PAGES);
+                        if (zdb_sqlite3_exec(P->maintenanceDb, sql) == SQLITE_OK)
+                                vacuumed = pages - _pragma(P->maintenanceDb, "PRAGMA freelist_count;");
+                }
+        }
+        Mutex_lock(P->mutex);
+        P->statistics.optimizations++;
+        P->statistics.vacuumed += vacuumed;
+        Mutex_unlock(P->mutex);
+        // Our own changes above must not count as a change next time
+        P->dataVersion = _pragma(P->maintenanceDb, "PRAGMA data_version;");
+}
+
+
+// The statistics are updated by the maintenance and refresh threads, publish a copy taken under the lock
+static void _publish(T P) {
+        Mutex_lock(P->mutex);
+        ConnectionPool_Statistics statistics = P->statistics;
+        Mutex_unlock(P->mutex);
+        ConnectionPool_setStatistics(P->pool, &statistics);
+}
+
+
+// Wait the number of seconds or until the pool is stopped. Return false if stopped
+static bool _wait(T P, int seconds) {
+        struct timespec wait = {.tv_sec = Time_now() + seconds};
+        Mutex_lock(P->mutex);
+        if (! P->stop)
+                Sem_timeWait(P->alarm, P->mutex, wait);
+        bool running = ! P->stop;
+        Mutex_unlock(P->mutex);
+        return running;
+}
+
+
+static void *_maintenance(void *args) {
+        T P = args;
+        while (_wait(P, P->interval)) {
+                bool idle = _isIdle(P);
+                _checkpoint(P, idle);
+                if (idle)
+                        _optimize(P);
+                _publish(P);
+        }
+        return NULL;
+}
+
+
+static int _backup(sqlite3 *destination, sqlite3 *source) {
+        sqlite3_backup *backup = sqlite3_backup_init(destination, "main", source, "main");
+        if (! backup)
+                return sqlite3_errcode(destination);
+        int status = sqlite3_backup_step(backup, -1);
+        sqlite3_backup_finish(backup);
+        return status == SQLITE_DONE ? SQLITE_OK : status;
+}
+
+
+// Copy the database file into the replica via a staging in-memory database. VACUUM INTO
+// reads the file sequentially and writes a rollback journal database, a backup of a WAL
+// database would copy a header the memdb VFS cannot open
+static int _loadReplica(T P) {
+        sqlite3 *staging;
+        char path[64], sql[96];
+        snprintf(path, sizeof(path), "file:/zdb-staging-%p?vfs=memdb", (void *)P);
+        // Keep the staging database open, a memdb database is deleted with its last connection
+        int status = sqlite3_open_v2(path, &staging, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI, NULL);
+        if (status == SQLITE_OK) {
+                int version = _pragma(P->source, "PRAGMA data_version;");
+                snprintf(sql, sizeof(sql), "VACUUM INTO '%s';", path);
+                if ((status = zdb_sqlite3_exec(P->source, sql)) == SQLITE_OK) {
+                        // Readers of the replica get SQLITE_BUSY and back off during this copy
+                        if ((status = _backup(P->memory, staging)) == SQLITE_OK) {
+                                P->sourceVersion = version;
+                                Mutex_lock(P->mutex);
+                                P->statistics.refreshes++;
+                                Mutex_unlock(P->mutex);
+                        }
+                }
+        }
+        sqlite3_close(staging);
+        return status;
+}
+
+
+static void *_refresher(void *args) {
+        T P = args;
+        while (_wait(P, P->refresh)) {
+                if (_pragma(P->source, "PRAGMA data_version;") == P->sourceVersion)
+                        continue;
+                if (_loadReplica(P) != SQLITE_OK) {
+                        DEBUG("SQLite: refresh of in-memory replica failed, retrying in %d seconds\n", P->refresh);
+                        continue;
+                }
+                _publish(P);
+        }
+        return NULL;
+}
+
+
+/* ----------------------------------------------------- Shared state */
+
+
+// Open the pool's in-memory database and keep it open, a memdb database is deleted with
+// its last connection. A name starting with '/' is shared by all connections in the process
+static bool _openMemory(T P, const char *name, char **error) {
+#if SQLITE_VERSION_NUMBER >= 3036000
+        snprintf(P->memoryPath, sizeof(P->memoryPath), "file:/zdb-%s-%p?vfs=memdb", name, (void *)P);
+        int status = sqlite3_open_v2(P->memoryPath, &P->memory, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI | SQLITE_OPEN_FULLMUTEX, NULL);
+        if (status != SQLITE_OK) {
+                *error = Str_cat("unable to open in-memory database -- %s", sqlite3_errstr(status));
+                sqlite3_close(P->memory);
+                P->memory = NULL;
+                return false;
+        }
+        return true;
+#else
+        *error = Str_dup("a shared in-memory database requires SQLite 3.36 or later");
+        return false;
+#endif
+}
+
+
+// The pool's in-memory database for a :memory: URL, otherwise NULL for the database file in the URL
+static inline const char *_path(T P, URL_T url) {
+        return Str_isEqual(URL_getPath(url), SQLITE_MEMORY_PATH) ? P->memoryPath : NULL;
+}
+
+
+static bool _startWriter(T P, URL_T url, char **error) {
+        if (! (P->db = SQLiteConnection_open(url, _path(P, url), SQLITE_OPEN_FULLMUTEX, error)))
+                return false;
+        if (zdb_sqlite3_exec(P->db, "PRAGMA journal_mode = WAL;") != SQLITE_OK) {
+                *error = Str_cat("unable to set WAL mode for the write queue -- %s", sqlite3_errmsg(P->db));
+                sqlite3_close(P->db);
+                P->db = NULL;
+                return false;
+        }
+        // Queued writes may use the pool's functions
+        if (! SQLiteConnection_addFunctions(P->db, P->pool, error)) {
+                sqlite3_close(P->db);
+                P->db = NULL;
+                return false;
+        }
+        Thread_create(P->writer, _writer, P);
+        return true;
+}
+
+
+static bool _startMaintenance(T P, URL_T url, char **error) {
+        const char *interval = URL_getParameter(url, "maintenance");
+        if ((P->interval = (int)strtol(interval, NULL, 10)) <= 0) {
+                *error = Str_cat("invalid maintenance interval '%s' -- expected seconds", interval);
+                return false;
+        }
+        const char *walLimit = URL_getParameter(url, "wal_autocheckpoint");
+        P->walLimit = walLimit ? (int)strtol(walLimit, NULL, 10) : DEFAULT_WAL_LIMIT;
+        if (P->walLimit <= 0)
+                P->walLimit = DEFAULT_WAL_LIMIT;
+        if (! (P->maintenanceDb = SQLiteConnection_open(url, _path(P, url), 0, error)))
+                return false;
+        // Bound the wait for readers and writers when the checkpoint is escalated or on vacuum
+        sqlite3_busy_timeout(P->maintenanceDb, MAINTENANCE_BUSY_TIMEOUT);
+        P->dataVersion = -1;
+        Thread_create(P->maintenance, _maintenance, P);
+        return true;
+}
+
+
+static bool _startReplica(T P, URL_T url, char **error) {
+        if (_path(P, url)) {
+                *error = Str_dup("memory-replica requires a database file");
+                return false;
+        }
+        const char *refresh = URL_getParameter(url, "replica-refresh");
+        if (refresh && (P->refresh = (int)strtol(refresh, NULL, 10)) <= 0) {
+                *error = Str_cat("invalid replica refresh interval '%s' -- expected seconds", refresh);
+                return false;
+        }
+        if (! (P->source = SQLiteConnection_open(url, NULL, SQLITE_OPEN_FULLMUTEX | SQLITE_OPEN_URI, error)))
+                return false;
+        if (! _openMemory(P, "replica", error))
+                return false;
+        int status = _loadReplica(P);
+        if (status != SQLITE_OK) {
+                *error = Str_cat("unable to load the in-memory replica -- %s", sqlite3_errstr(status));
+                sqlite3_close(P->memory);
+                P->memory = NULL;
+                return false;
+        }
+        if (P->refresh > 0)
+                Thread_create(P->refresher, _refresher, P);
+        return true;
+}
+
+
+static void _free(void *state) {
+        T P = state;
+        Mutex_lock(P->mutex);
+        P->stop = true;
+        Sem_signal(P->work);
+        Sem_broadcast(P->alarm);
+        Mutex_unlock(P->mutex);
+        // A thread is running for each connection opened
+        if (P->db) {
+                Thread_join(P->writer);
+                while (sqlite3_close(P->db) == SQLITE_BUSY)
+                        Time_usleep(10);
+        }
+        if (P->maintenanceDb) {
+                Thread_join(P->maintenance);
+                sqlite3_close(P->maintenanceDb);
+        }
+        if (P->refresh > 0 && P->memory)
+                Thread_join(P->refresher);
+        sqlite3_close(P->source);
+        sqlite3_close(P->memory);
+        Vector_free(&P->queue);
+        Sem_destroy(P->alarm);
+        Sem_destroy(P->done);
+        Sem_destroy(P->work);
+        Sem_destroy(P->lease);
+        Mutex_destroy(P->mutex);
+        FREE(P);
+}
+
+
+static void *_new(ConnectionPool_T pool, char **error) {
+        T P;
+        URL_T url = ConnectionPool_getURL(pool);
+        NEW(P);
+        P->pool = pool;
+        P->queue = Vector_new(MAX_GROUP);
+        Mutex_init(P->mutex);
+        Sem_init(P->lease);
+        Sem_init(P->work);
+        Sem_init(P->done);
+        Sem_init(P->alarm);
+        // The in-memory database must exist before other connections are opened
+        if ((Str_isEqual(URL_getPath(url), SQLITE_MEMORY_PATH) && ! _openMemory(P, "memory", error)) ||
+            (Str_parseBool(URL_getParameter(url, "write-queue")) && ! _startWriter(P, url, error)) ||
+            (URL_getParameter(url, "maintenance") && ! _startMaintenance(P, url, error)) ||
+            (Str_parseBool(URL_getParameter(url, "memory-replica")) && ! _startReplica(P, url, error))) {
+                _free(P);
+                return NULL;
+        }
+        return P;
+}
+
+
+/* -------------------------------------------------------- Public methods */
+
+
+T SQLitePool_get(Connection_T delegator, char **error) {
+        assert(delegator);
+        return ConnectionPool_getSharedState(Connection_getPool(delegator), _new, _free, error);
+}
+
+
+const char *SQLitePool_getMemory(T P) {
+        assert(P);
+        return P->memory ? P->memoryPath : NULL;
+}
+
+
+sqlite3 *SQLitePool_getWriter(T P) {
+        assert(P);
+        return P->db;
+}
+
+
+bool SQLitePool_isWriting(T P, Connection_T delegator) {
+        assert(P);
+        return _isOwner(P, delegator);
+}
+
+
+int SQLitePool_execute(T P, Connection_T delegator, const char *sql, SQLiteTimeout_T *timeout, SQLiteWrite_T *result) {
+        assert(P);
+        assert(sql);
+        assert(result);
+        return _submit(P, delegator, sql, NULL, timeout, result);
+}
+
+
+int SQLitePool_step(T P, Connection_T delegator, sqlite3_stmt *stmt, SQLiteTimeout_T *timeout, SQLiteWrite_T *result) {
+        assert(P);
+        assert(stmt);
+        assert(result);
+        return _submit(P, delegator, NULL, stmt, timeout, result);
+}
+
+
+bool SQLitePool_beginWrite(T P, Connection_T delegator, const char *sql, SQLiteTimeout_T *timeout, SQLiteWrite_T *result) {
+        assert(P);
+        assert(sql);
+        assert(result);
+        if (! _isOwner(P, delegator) && ! _acquire(P, delegator, timeout, result))
+                return false;
+        if (_run(P, sql, NULL, result) == SQLITE_OK)
+                return true;
+        if (sqlite3_get_autocommit(P->db))
+                _release(P);
+        return false;
+}
+
+
+bool SQLitePool_endWrite(T P, Connection_T delegator, const char *sql, SQLiteWrite_T *result) {
+        assert(P);
+        assert(sql);
+        assert(result);
+        if (! _isOwner(P, delegator)) {
+                *result = (SQLiteWrite_T){.status = SQLITE_ERROR};
+                snprintf(result->error, sizeof(result->error), "cannot end transaction - no transaction is active");
+                return false;
+        }
+        bool success = (_run(P, sql, NULL, result) == SQLITE_OK);
+        // A failed commit may leave the transaction open
+        if (sqlite3_get_autocommit(P->db))
+                _release(P);
+        return success;
+}
+
+
+void SQLitePool_release(T P, Connection_T delegator) {
+        assert(P);
+        if (_isOwner(P, delegator)) {
+                if (! sqlite3_get_autocommit(P->db))
+                        sqlite3_exec(P->db, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
+                _release(P);
+        }
+}
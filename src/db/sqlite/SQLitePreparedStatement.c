@@ -49,6 +49,10 @@ struct T {
         sqlite3 *db;
         int lastError;
         sqlite3_stmt *stmt;
+        SQLitePool_T pool;
+        SQLiteWrite_T write;
+        SQLiteWrite_T *last;
+        SQLiteTimeout_T *timeout;
         Connection_T delegator;
 };
 extern const struct Rop_T sqlite3rops;
@@ -57,12 +61,15 @@ extern const struct Rop_T sqlite3rops;
 /* ------------------------------------------------------------- Constructor */
 
 
-T SQLitePreparedStatement_new(Connection_T delegator, sqlite3_stmt *stmt) {
+T SQLitePreparedStatement_new(Connection_T delegator, sqlite3_stmt *stmt, SQLitePool_T pool, SQLiteWrite_T *last, SQLiteTimeout_T *timeout) {
         T P;
         assert(stmt);
         NEW(P);
         P->delegator = delegator;
         P->stmt = stmt;
+        P->pool = pool;
+        P->last = last;
+        P->timeout = timeout;
         P->db = sqlite3_db_handle(stmt);
         P->lastError = SQLITE_OK;
         return P;
@@ -133,9 +140,25 @@ static void _setBlob(T P, int parameterIndex, const void *x, int size) {
 }
 
 
+static void _setZeroBlob(T P, int parameterIndex, int size) {
+        assert(P);
+        sqlite3_reset(P->stmt);
+        P->lastError = sqlite3_bind_zeroblob(P->stmt, parameterIndex, size);
+        if (P->lastError == SQLITE_RANGE)
+                THROW(SQLException, "Parameter index is out of range");
+}
+
+
 static void _execute(T P) {
         assert(P);
-        P->lastError = zdb_sqlite3_step(P->stmt);
+        if (P->pool) {
+                P->lastError = SQLitePool_step(P->pool, P->delegator, P->stmt, P->timeout, &P->write);
+                // For Connection_lastRowId() and Connection_rowsChanged()
+                *P->last = P->write;
+        } else {
+                SQLiteTimeout_start(P->timeout);
+                P->lastError = zdb_sqlite3_step(P->stmt);
+        }
         switch (P->lastError) {
                 case SQLITE_DONE:
                         P->lastError = sqlite3_reset(P->stmt);
@@ -144,9 +167,13 @@ static void _execute(T P) {
                         P->lastError = sqlite3_reset(P->stmt);
                         THROW(SQLException, "Select statement not allowed in PreparedStatement_execute()");
                         break;
+                case SQLITE_INTERRUPT:
+                        P->lastError = sqlite3_reset(P->stmt);
+                        THROW(SQLException, "Connection [%p] %s", P->delegator, SQLITE_TIMEOUT_ERROR);
+                        break;
                 default:
                         P->lastError = sqlite3_reset(P->stmt);
-                        THROW(SQLException, "Connection [%p] %s", P->delegator, sqlite3_errmsg(P->db));
+                        THROW(SQLException, "Connection [%p] %s", P->delegator, P->pool ? P->write.error : sqlite3_errmsg(P->db));
                         break;
         }
 }
@@ -154,8 +181,11 @@ static void _execute(T P) {
 
 static ResultSet_T _executeQuery(T P) {
         assert(P);
+        // Statements on the writer connection are only stepped by the writer thread outside a transaction
+        if (P->pool && ! SQLitePool_isWriting(P->pool, P->delegator))
+                THROW(SQLException, "Statement on the write-queue connection can only be queried inside a transaction");
         if (P->lastError == SQLITE_OK)
-                return ResultSet_new(SQLiteResultSet_new(P->delegator, P->stmt, true), (Rop_T)&sqlite3rops);
+                return ResultSet_new(SQLiteResultSet_new(P->delegator, P->stmt, true, P->timeout), (Rop_T)&sqlite3rops);
         THROW(SQLException, "Connection [%p] %s", P->delegator, sqlite3_errmsg(P->db));
         return NULL;
 }
@@ -163,6 +193,8 @@ static ResultSet_T _executeQuery(T P) {
 
 static long long _rowsChanged(T P) {
         assert(P);
+        if (P->pool)
+                return P->write.changes;
         return (long long)sqlite3_changes(P->db);
 }
 
@@ -185,6 +217,7 @@ const struct Pop_T sqlite3pops = {
         .setDouble      = _setDouble,
         .setTimestamp   = _setTimestamp,
         .setBlob        = _setBlob,
+        .setZeroBlob    = _setZeroBlob,
         .execute        = _execute,
         .executeQuery   = _executeQuery,
         .rowsChanged    = _rowsChanged,
@@ -0,0 +1,534 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+
+#include "Config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "system/Time.h"
+#include "SQLiteAdapter.h"
+
+
+/**
+ * A cache of query results for a SQLite connection, enabled with the URL
+ * property `result-cache=<entries>`.
+ *
+ * Results of read-only queries run with Connection_executeQuery() are
+ * stored with all their rows, keyed by the SQL text. Before a result is
+ * reused, the data version of the database file is checked. The version
+ * changes when this or any other connection, also in another process,
+ * commits a change, so a hit only costs this check. The data version does
+ * not change within a transaction of the connection, so the cache is not
+ * used while a transaction is active. A query calling a function which is
+ * not deterministic, such as random() or datetime('now'), or a function
+ * added to the pool without SQLITE_DETERMINISTIC, is not cached. Functions
+ * called are reported to an authorizer when the query is prepared. Results
+ * larger than MAX_ENTRY_SIZE are not cached, rows not read when the limit
+ * is reached are streamed from the statement. The statement which filled
+ * an entry is kept until its ResultSet is closed, for the query profile.
+ * The least recently used result is replaced when the cache is full.
+ *
+ * @file
+ */
+
+
+/* ------------------------------------------------------------- Definitions */
+
+
+typedef struct cell_t {
+        int type;
+        int size;
+        size_t offset;
+} cell_t;
+
+typedef struct entry_t {
+        char *sql;
+        int refs;
+        bool cached;
+        long long version[3];
+        int rows;
+        int columns;
+        size_t *names;
+        cell_t *cells;
+        char *data;
+        size_t length;
+        size_t capacity;
+} *entry_t;
+
+#define T SQLiteResultCache_T
+struct SQLiteResultCache_S {
+        sqlite3 *db;
+        bool preparing;
+        bool deterministic;
+        ConnectionPool_T pool;
+        sqlite3_stmt *dataVersion;
+        int size;
+        int count;
+        entry_t *entries;
+};
+
+#define MAX_ENTRY_SIZE (1024 * 1024)
+
+// Built-in functions which may return another value for the same arguments, date and time functions may read 'now'
+static const char *kVolatile[] = {"random", "randomblob", "changes", "total_changes", "last_insert_rowid",
+        "date", "time", "datetime", "julianday", "unixepoch", "strftime", "timediff",
+        "current_date", "current_time", "current_timestamp", NULL};
+
+extern const struct Rop_T sqlite3rops;
+extern const struct Rop_T sqlite3cacherops;
+static ResultSetDelegate_T _newResultSet(Connection_T delegator, entry_t entry, ResultSetDelegate_T stream);
+
+
+/* ------------------------------------------------------- Private methods */
+
+
+static void _release(entry_t *e) {
+        entry_t entry = *e;
+        if (--entry->refs == 0) {
+                FREE(entry->sql);
+                FREE(entry->names);
+                FREE(entry->cells);
+                FREE(entry->data);
+                FREE(entry);
+        }
+        *e = NULL;
+}
+
+
+// The version changes with any commit to the database, by this or another connection
+static bool _getVersion(T C, long long version[3]) {
+        // Reading data_version starts a read transaction which picks up changes by other connections
+        if (zdb_sqlite3_step(C->dataVersion) != SQLITE_ROW) {
+                sqlite3_reset(C->dataVersion);
+                return false;
+        }
+        version[0] = sqlite3_column_int64(C->dataVersion, 0);
+        sqlite3_reset(C->dataVersion);
+        SQLiteLock_release(C->db);
+#ifdef SQLITE_FCNTL_DATA_VERSION
+        unsigned int pagerVersion = 0;
+        sqlite3_file_control(C->db, "main", SQLITE_FCNTL_DATA_VERSION, &pagerVersion);
+        version[1] = pagerVersion;
+#else
+        version[1] = 0;
+#endif
+        // data_version does not change with commits by this connection
+        version[2] = sqlite3_total_changes(C->db);
+        return true;
+}
+
+
+static bool _isDeterministic(T C, const char *function) {
+        if (Str_member(function, kVolatile))
+                return false;
+        const ConnectionPool_Function *f;
+        for (int i = 0; (f = ConnectionPool_getFunction(C->pool, i)); i++) {
+                if (Str_isEqual(f->name, function))
+#ifdef SQLITE_DETERMINISTIC
+                        return (f->flags & SQLITE_DETERMINISTIC);
+#else
+                        return false;
+#endif
+        }
+        return true;
+}
+
+
+// Authorizer noting functions called by a statement prepared with SQLiteResultCache_prepare()
+static int _authorize(void *context, int action, const char *argument1, const char *argument2, const char *database, const char *trigger) {
+        T C = context;
+        if (C->preparing && action == SQLITE_FUNCTION && ! _isDeterministic(C, argument2))
+                C->deterministic = false;
+        return SQLITE_OK;
+}
+
+
+static bool _append(entry_t entry, const void *data, int size) {
+        if (entry->length + size + 1 > MAX_ENTRY_SIZE)
+                return false;
+        if (entry->length + size + 1 > entry->capacity) {
+                entry->capacity = (entry->length + size + 1) * 2;
+                if (entry->data)
+                        RESIZE(entry->data, (long)entry->capacity);
+                else
+                        entry->data = ALLOC((long)entry->capacity);
+        }
+        if (size > 0)
+                memcpy(entry->data + entry->length, data, size);
+        entry->data[entry->length + size] = 0;
+        entry->length += size + 1;
+        return true;
+}
+
+
+/* Read rows of stmt into a new entry. Status is SQLITE_DONE if all rows were
+ read and SQLITE_ROW if the entry is full, rows of the entry are complete and
+ stmt is on the row not stored. NULL on error and NULL with status SQLITE_OK
+ if stmt was not stepped */
+static entry_t _materialize(sqlite3_stmt *stmt, SQLiteTimeout_T *timeout, int *status) {
+        entry_t entry;
+        *status = SQLITE_OK;
+        if (sqlite3_column_count(stmt) == 0)
+                return NULL;
+        NEW(entry);
+        entry->refs = 1;
+        entry->columns = sqlite3_column_count(stmt);
+        // Column names are stored first
+        entry->names = CALLOC(entry->columns, sizeof(size_t));
+        for (int i = 0; i < entry->columns; i++) {
+                const char *name = sqlite3_column_name(stmt, i);
+                entry->names[i] = entry->length;
+                if (! _append(entry, name, (int)strlen(name))) {
+                        _release(&entry);
+                        return NULL;
+                }
+        }
+        int allocated = 0;
+        SQLiteTimeout_start(timeout);
+        while ((*status = zdb_sqlite3_step(stmt)) == SQLITE_ROW) {
+                if (entry->rows == allocated) {
+                        allocated = allocated ? allocated * 2 : 16;
+                        if (entry->cells)
+                                RESIZE(entry->cells, (long)allocated * entry->columns * sizeof(cell_t));
+                        else
+                                entry->cells = ALLOC((long)allocated * entry->columns * sizeof(cell_t));
+                }
+                cell_t *row = entry->cells + (long)entry->rows * entry->columns;
+                for (int i = 0; i < entry->columns; i++) {
+                        row[i].type = sqlite3_column_type(stmt, i);
+                        const void *value = row[i].type == SQLITE_BLOB ? sqlite3_column_blob(stmt, i) : sqlite3_column_text(stmt, i);
+                        row[i].size = sqlite3_column_bytes(stmt, i);
+                        row[i].offset = entry->length;
+                        if (! _append(entry, value, row[i].size))
+                                return entry;
+                }
+                entry->rows++;
+        }
+        if (*status == SQLITE_DONE)
+                return entry;
+        _release(&entry);
+        return NULL;
+}
+
+
+static void _remove(T C, int index) {
+        entry_t entry = C->entries[index];
+        entry->cached = false;
+        _release(&entry);
+        memmove(C->entries + index, C->entries + index + 1, (C->count - index - 1) * sizeof(entry_t));
+        C->count--;
+}
+
+
+/* ----------------------------------------------------- Protected methods */
+
+
+T SQLiteResultCache_new(sqlite3 *db, int size, ConnectionPool_T pool) {
+        T C;
+        assert(db);
+        assert(size > 0);
+        assert(pool);
+        NEW(C);
+        C->db = db;
+        C->size = size;
+        C->pool = pool;
+        C->entries = CALLOC(size, sizeof(entry_t));
+        if (zdb_sqlite3_prepare_v2(db, "PRAGMA data_version;", -1, &C->dataVersion, NULL) != SQLITE_OK) {
+                SQLiteResultCache_free(&C);
+                return NULL;
+        }
+        // Kept for the life of the connection, setting an authorizer expires all prepared statements
+        sqlite3_set_authorizer(db, _authorize, C);
+        return C;
+}
+
+
+void SQLiteResultCache_free(T *C) {
+        assert(C && *C);
+        sqlite3_set_authorizer((*C)->db, NULL, NULL);
+        while ((*C)->count > 0)
+                _remove(*C, (*C)->count - 1);
+        sqlite3_finalize((*C)->dataVersion);
+        FREE((*C)->entries);
+        FREE(*C);
+}
+
+
+int SQLiteResultCache_prepare(T C, const char *sql, int length, sqlite3_stmt **stmt, const char **tail, bool *cacheable) {
+        assert(C);
+        assert(sql);
+        C->preparing = true;
+        C->deterministic = true;
+        int status = zdb_sqlite3_prepare_v2(C->db, sql, length, stmt, tail);
+        C->preparing = false;
+        *cacheable = (status == SQLITE_OK && C->deterministic && sqlite3_stmt_readonly(*stmt) && ! **tail);
+        return status;
+}
+
+
+ResultSet_T SQLiteResultCache_get(T C, Connection_T delegator, const char *sql) {
+        assert(C);
+        assert(sql);
+        for (int i = 0; i < C->count; i++) {
+                entry_t entry = C->entries[i];
+                if (Str_isEqual(entry->sql, sql)) {
+                        long long version[3];
+                        if (! _getVersion(C, version) || memcmp(version, entry->version, sizeof(version)) != 0) {
+                                _remove(C, i);
+                                return NULL;
+                        }
+                        // Most recently used first
+                        memmove(C->entries + 1, C->entries, i * sizeof(entry_t));
+                        C->entries[0] = entry;
+                        return ResultSet_new(_newResultSet(delegator, entry, NULL), (Rop_T)&sqlite3cacherops);
+                }
+        }
+        return NULL;
+}
+
+
+ResultSet_T SQLiteResultCache_put(T C, Connection_T delegator, const char *sql, sqlite3_stmt *stmt, SQLiteTimeout_T *timeout, int *status) {
+        assert(C);
+        assert(sql);
+        assert(stmt);
+        assert(status);
+        long long version[3];
+        *status = SQLITE_OK;
+        // The version is read first, a change while the query runs is seen on the next lookup
+        if (! _getVersion(C, version))
+                return NULL;
+        entry_t entry = _materialize(stmt, timeout, status);
+        if (! entry) {
+                if (*status != SQLITE_OK)
+                        sqlite3_finalize(stmt);
+                return NULL;
+        }
+        if (*status == SQLITE_DONE) {
+                entry->sql = Str_dup(sql);
+                memcpy(entry->version, version, sizeof(version));
+                entry->cached = true;
+                if (C->count == C->size)
+                        _remove(C, C->count - 1);
+                memmove(C->entries + 1, C->entries, C->count * sizeof(entry_t));
+                C->entries[0] = entry;
+                C->count++;
+        }
+        *status = SQLITE_OK;
+        /* The rows read are returned from the entry and, if the result was too large to cache, the rest
+         is read from stmt. Closing stmt with the ResultSet reports the profile of the execution */
+        ResultSet_T r = ResultSet_new(_newResultSet(delegator, entry, SQLiteResultSet_resume(delegator, stmt, entry->rows, timeout)), (Rop_T)&sqlite3cacherops);
+        // The reference from materialize is kept by the cache
+        if (! entry->cached)
+                _release(&entry);
+        return r;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+
+/* A ResultSet reading rows from a cache entry. The entry is kept until the
+ ResultSet is closed, even if it is removed from the cache meanwhile. For a
+ result too large to cache, rows after those in the entry are read from a
+ SQLite ResultSet continuing the statement */
+
+#undef T
+#define T ResultSetDelegate_T
+struct T {
+        int maxRows;
+        int currentRow;
+        bool profile;
+        bool streaming;
+        entry_t entry;
+        cell_t *row;
+        T stream;
+        Connection_T delegator;
+};
+
+
+static T _newResultSet(Connection_T delegator, entry_t entry, T stream) {
+        T R;
+        NEW(R);
+        R->stream = stream;
+        R->delegator = delegator;
+        // A cache hit is reported here, an execution by stream
+        R->profile = ! stream && ConnectionPool_isProfiling(Connection_getPool(delegator));
+        R->entry = entry;
+        R->entry->refs++;
+        R->maxRows = Connection_getMaxRows(delegator);
+        return R;
+}
+
+
+static void _free(T *R) {
+        assert(R && *R);
+        if ((*R)->profile) {
+                ConnectionPool_Profile profile = {.sql = (*R)->entry->sql, .rows = (*R)->currentRow, .cached = true};
+                ConnectionPool_profile(Connection_getPool((*R)->delegator), &profile);
+        }
+        if ((*R)->stream)
+                sqlite3rops.free(&(*R)->stream);
+        _release(&(*R)->entry);
+        FREE(*R);
+}
+
+
+static int _getColumnCount(T R) {
+        assert(R);
+        return R->entry->columns;
+}
+
+
+static const char *_getColumnName(T R, int columnIndex) {
+        assert(R);
+        columnIndex--;
+        if (columnIndex < 0 || columnIndex >= R->entry->columns)
+                return NULL;
+        return R->entry->data + R->entry->names[columnIndex];
+}
+
+
+static inline cell_t *_cell(T R, int columnIndex) {
+        int i = checkAndSetColumnIndex(columnIndex, R->entry->columns);
+        if (! R->row)
+                THROW(SQLException, "No current row -- call ResultSet_next() first");
+        return R->row + i;
+}
+
+
+static long _getColumnSize(T R, int columnIndex) {
+        assert(R);
+        if (R->streaming)
+                return sqlite3rops.getColumnSize(R->stream, columnIndex);
+        return _cell(R, columnIndex)->size;
+}
+
+
+static bool _next(T R) {
+        assert(R);
+        if (R->streaming)
+                return sqlite3rops.next(R->stream);
+        if ((R->maxRows && R->currentRow >= R->maxRows) || R->currentRow >= R->entry->rows) {
+                R->row = NULL;
+                if (R->stream && (! R->maxRows || R->currentRow < R->maxRows)) {
+                        R->streaming = true;
+                        return sqlite3rops.next(R->stream);
+                }
+                return false;
+        }
+        R->row = R->entry->cells + (long)R->currentRow++ * R->entry->columns;
+        return true;
+}
+
+
+static bool _isnull(T R, int columnIndex) {
+        assert(R);
+        if (R->streaming)
+                return sqlite3rops.isnull(R->stream, columnIndex);
+        return _cell(R, columnIndex)->type == SQLITE_NULL;
+}
+
+
+static const char *_getString(T R, int columnIndex) {
+        assert(R);
+        if (R->streaming)
+                return sqlite3rops.getString(R->stream, columnIndex);
+        cell_t *cell = _cell(R, columnIndex);
+        return cell->type == SQLITE_NULL ? NULL : R->entry->data + cell->offset;
+}
+
+
+static const char *_getSString(T R, int columnIndex, int *size) {
+        assert(R);
+        if (R->streaming)
+                return sqlite3rops.getSString(R->stream, columnIndex, size);
+        cell_t *cell = _cell(R, columnIndex);
+        *size = cell->size;
+        return cell->type == SQLITE_NULL ? NULL : R->entry->data + cell->offset;
+}
+
+
+static int _getColumnType(T R, int columnIndex) {
+        assert(R);
+        if (R->streaming)
+                return sqlite3rops.getColumnType(R->stream, columnIndex);
+        return SQLiteResultSet_columnType(_cell(R, columnIndex)->type);
+}
+
+
+static const void *_getBlob(T R, int columnIndex, int *size) {
+        assert(R);
+        if (R->streaming)
+                return sqlite3rops.getBlob(R->stream, columnIndex, size);
+        cell_t *cell = _cell(R, columnIndex);
+        *size = cell->size;
+        return cell->type == SQLITE_NULL ? NULL : R->entry->data + cell->offset;
+}
+
+
+static time_t _getTimestamp(T R, int columnIndex) {
+        assert(R);
+        if (R->streaming)
+                return sqlite3rops.getTimestamp(R->stream, columnIndex);
+        cell_t *cell = _cell(R, columnIndex);
+        if (cell->type == SQLITE_INTEGER)
+                return (time_t)strtoll(R->entry->data + cell->offset, NULL, 10);
+        return Time_toTimestamp(cell->type == SQLITE_NULL ? NULL : R->entry->data + cell->offset);
+}
+
+
+static struct tm *_getDateTime(T R, int columnIndex, struct tm *tm) {
+        assert(R);
+        if (R->streaming)
+                return sqlite3rops.getDateTime(R->stream, columnIndex, tm);
+        cell_t *cell = _cell(R, columnIndex);
+        if (cell->type == SQLITE_INTEGER) {
+                time_t utc = (time_t)strtoll(R->entry->data + cell->offset, NULL, 10);
+                if (gmtime_r(&utc, tm)) tm->tm_year += 1900; // Use year literal
+        } else {
+                Time_toDateTime(cell->type == SQLITE_NULL ? NULL : R->entry->data + cell->offset, tm);
+        }
+        return tm;
+}
+
+
+const struct Rop_T sqlite3cacherops = {
+        .name           = "sqlite",
+        .free           = _free,
+        .getColumnCount = _getColumnCount,
+        .getColumnName  = _getColumnName,
+        .getColumnSize  = _getColumnSize,
+        .next           = _next,
+        .isnull         = _isnull,
+        .getString      = _getString,
+        .getSString     = _getSString,
+        .getColumnType  = _getColumnType,
+        .getBlob        = _getBlob,
+        .getTimestamp   = _getTimestamp,
+        .getDateTime    = _getDateTime
+};
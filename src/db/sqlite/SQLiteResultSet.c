@@ -48,18 +48,71 @@ struct T {
         sqlite3 *db;
         int keep;
         int maxRows;
+        bool profile;
+        bool pending;
+        long long rows;
         int lastError;
         int currentRow;
         int columnCount;
         sqlite3_stmt *stmt;
+        SQLiteTimeout_T *timeout;
         Connection_T delegator;
 };
 
 
+/* ------------------------------------------------------- Private methods */
+
+
+static const int _counters[] = {SQLITE_STMTSTATUS_FULLSCAN_STEP, SQLITE_STMTSTATUS_SORT, SQLITE_STMTSTATUS_AUTOINDEX, SQLITE_STMTSTATUS_VM_STEP};
+
+
+// Reset counters left by earlier executions of a prepared statement
+static void _resetProfile(T R) {
+        for (int i = 0; i < sizeof(_counters) / sizeof(_counters[0]); i++)
+                sqlite3_stmt_status(R->stmt, _counters[i], true);
+#ifdef HAVE_SQLITE3_STMT_SCANSTATUS
+        sqlite3_stmt_scanstatus_reset(R->stmt);
+#endif
+}
+
+
+static void _profile(T R) {
+        ConnectionPool_Profile profile = {
+                .sql = sqlite3_sql(R->stmt),
+                .rows = R->rows,
+                .fullscanSteps = sqlite3_stmt_status(R->stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, false),
+                .sorts = sqlite3_stmt_status(R->stmt, SQLITE_STMTSTATUS_SORT, false),
+                .autoindexes = sqlite3_stmt_status(R->stmt, SQLITE_STMTSTATUS_AUTOINDEX, false),
+                .vmSteps = sqlite3_stmt_status(R->stmt, SQLITE_STMTSTATUS_VM_STEP, false)
+        };
+#ifdef HAVE_SQLITE3_STMT_SCANSTATUS
+        sqlite3_int64 loops;
+        while (sqlite3_stmt_scanstatus(R->stmt, profile.scanCount, SQLITE_SCANSTAT_NLOOP, &loops) == 0)
+                profile.scanCount++;
+        ConnectionPool_Scan *scans = profile.scanCount ? CALLOC(profile.scanCount, sizeof(ConnectionPool_Scan)) : NULL;
+        for (int i = 0; i < profile.scanCount; i++) {
+                sqlite3_int64 rows;
+                sqlite3_stmt_scanstatus(R->stmt, i, SQLITE_SCANSTAT_NAME, &scans[i].name);
+                sqlite3_stmt_scanstatus(R->stmt, i, SQLITE_SCANSTAT_EXPLAIN, &scans[i].explain);
+                sqlite3_stmt_scanstatus(R->stmt, i, SQLITE_SCANSTAT_NLOOP, &loops);
+                sqlite3_stmt_scanstatus(R->stmt, i, SQLITE_SCANSTAT_NVISIT, &rows);
+                sqlite3_stmt_scanstatus(R->stmt, i, SQLITE_SCANSTAT_EST, &scans[i].estimate);
+                scans[i].loops = loops;
+                scans[i].rows = rows;
+        }
+        profile.scans = scans;
+#endif
+        ConnectionPool_profile(Connection_getPool(R->delegator), &profile);
+#ifdef HAVE_SQLITE3_STMT_SCANSTATUS
+        FREE(scans);
+#endif
+}
+
+
 /* ------------------------------------------------------------- Constructor */
 
 
-T SQLiteResultSet_new(Connection_T delegator, sqlite3_stmt *stmt, int keep) {
+T SQLiteResultSet_new(Connection_T delegator, sqlite3_stmt *stmt, int keep, SQLiteTimeout_T *timeout) {
         T R;
         assert(stmt);
         NEW(R);
@@ -67,8 +120,33 @@ T SQLiteResultSet_new(Connection_T delegator, sqlite3_stmt *stmt, int keep) {
         R->stmt = stmt;
         R->db = sqlite3_db_handle(stmt);
         R->keep = keep;
+        R->timeout = timeout;
+        R->maxRows = Connection_getMaxRows(delegator);
+        R->columnCount = sqlite3_column_count(R->stmt);
+        if ((R->profile = ConnectionPool_isProfiling(Connection_getPool(delegator))))
+                _resetProfile(R);
+        return R;
+}
+
+
+/* Continue reading stmt after rows already read by the caller. If the last
+ step returned SQLITE_ROW, that row is returned by the first call to next */
+T SQLiteResultSet_resume(Connection_T delegator, sqlite3_stmt *stmt, long long rows, SQLiteTimeout_T *timeout) {
+        T R;
+        assert(stmt);
+        NEW(R);
+        R->delegator = delegator;
+        R->stmt = stmt;
+        R->db = sqlite3_db_handle(stmt);
+        R->timeout = timeout;
         R->maxRows = Connection_getMaxRows(delegator);
         R->columnCount = sqlite3_column_count(R->stmt);
+        R->pending = sqlite3_stmt_busy(stmt);
+        R->rows = rows;
+        R->currentRow = (int)rows;
+        R->lastError = R->pending ? SQLITE_ROW : SQLITE_DONE;
+        // Counters are kept so the profile covers the whole execution
+        R->profile = ConnectionPool_isProfiling(Connection_getPool(delegator));
         return R;
 }
 
@@ -78,10 +156,14 @@ T SQLiteResultSet_new(Connection_T delegator, sqlite3_stmt *stmt, int keep) {
 
 static void _free(T *R) {
         assert(R && *R);
+        if ((*R)->profile)
+                _profile(*R);
         if ((*R)->keep)
                 sqlite3_reset((*R)->stmt);
         else
                 sqlite3_finalize((*R)->stmt);
+        // A ResultSet closed before its last row held a lock until now
+        SQLiteLock_release((*R)->db);
         FREE(*R);
 }
 
@@ -109,9 +191,20 @@ static long _getColumnSize(T R, int columnIndex) {
 
 static bool _next(T R) {
         assert(R);
+        // Stepping a statement again after SQLITE_DONE would restart it
+        if (R->lastError == SQLITE_DONE)
+                return false;
         if (R->maxRows && (R->currentRow++ >= R->maxRows))
                 return false;
+        if (R->pending) {
+                R->pending = false;
+                R->rows++;
+                return true;
+        }
+        SQLiteTimeout_start(R->timeout);
         R->lastError = zdb_sqlite3_step(R->stmt);
+        if (R->lastError == SQLITE_INTERRUPT)
+                THROW(SQLException, "%s", SQLITE_TIMEOUT_ERROR);
         if (R->lastError != SQLITE_ROW && R->lastError != SQLITE_DONE) {
 #ifdef HAVE_SQLITE3_ERRSTR
                 THROW(SQLException, "sqlite3_step -- %s", sqlite3_errstr(R->lastError));
@@ -119,7 +212,10 @@ static bool _next(T R) {
                 THROW(SQLException, "sqlite3_step -- error code: %d", R->lastError);
 #endif
         }
-        return (R->lastError == SQLITE_ROW);
+        if (R->lastError != SQLITE_ROW)
+                return false;
+        R->rows++;
+        return true;
 }
 
 
@@ -137,6 +233,57 @@ static const char *_getString(T R, int columnIndex) {
 }
 
 
+static const char *_getSString(T R, int columnIndex, int *size) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        const char *s = (const char*)sqlite3_column_text(R->stmt, i);
+        // After sqlite3_column_text() so the size is of the text value
+        *size = sqlite3_column_bytes(R->stmt, i);
+        return s;
+}
+
+
+// Integer and real values are read as is, only text is parsed
+static long long _getLLong(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        switch (sqlite3_column_type(R->stmt, i)) {
+                case SQLITE_NULL:
+                        return 0;
+                case SQLITE_INTEGER:
+                case SQLITE_FLOAT:
+                        return sqlite3_column_int64(R->stmt, i);
+        }
+        return Str_parseLLong((const char*)sqlite3_column_text(R->stmt, i));
+}
+
+
+static int _getInt(T R, int columnIndex) {
+        return (int)_getLLong(R, columnIndex);
+}
+
+
+static double _getDouble(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        switch (sqlite3_column_type(R->stmt, i)) {
+                case SQLITE_NULL:
+                        return 0.0;
+                case SQLITE_INTEGER:
+                case SQLITE_FLOAT:
+                        return sqlite3_column_double(R->stmt, i);
+        }
+        return Str_parseDouble((const char*)sqlite3_column_text(R->stmt, i));
+}
+
+
+static int _getColumnType(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        return SQLiteResultSet_columnType(sqlite3_column_type(R->stmt, i));
+}
+
+
 static const void *_getBlob(T R, int columnIndex, int *size) {
         assert(R);
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
@@ -170,6 +317,42 @@ static struct tm *_getDateTime(T R, int columnIndex, struct tm *tm) {
 }
 
 
+// Step through rows and read values by storage class without going through the getters
+static int _fetchBatch(T R, int rows, ResultSet_Batch_T batch) {
+        assert(R);
+        int n = 0;
+        while (n < rows && _next(R)) {
+                for (int i = 0; i < R->columnCount; i++) {
+                        switch (sqlite3_column_type(R->stmt, i)) {
+                                case SQLITE_NULL:
+                                        ResultSet_Batch_addNull(batch, i + 1);
+                                        break;
+                                case SQLITE_INTEGER:
+                                        ResultSet_Batch_addLLong(batch, i + 1, sqlite3_column_int64(R->stmt, i));
+                                        break;
+                                case SQLITE_FLOAT:
+                                        ResultSet_Batch_addDouble(batch, i + 1, sqlite3_column_double(R->stmt, i));
+                                        break;
+                                case SQLITE_BLOB:
+                                {
+                                        const void *blob = sqlite3_column_blob(R->stmt, i);
+                                        ResultSet_Batch_addBytes(batch, i + 1, ResultSet_Blob, blob, sqlite3_column_bytes(R->stmt, i));
+                                }
+                                        break;
+                                default:
+                                {
+                                        const void *text = sqlite3_column_text(R->stmt, i);
+                                        ResultSet_Batch_addBytes(batch, i + 1, ResultSet_Text, text, sqlite3_column_bytes(R->stmt, i));
+                                }
+                                        break;
+                        }
+                }
+                n++;
+        }
+        return n;
+}
+
+
 /* ------------------------------------------------------------------------- */
 
 
@@ -182,9 +365,15 @@ const struct Rop_T sqlite3rops = {
         .next           = _next,
         .isnull         = _isnull,
         .getString      = _getString,
+        .getSString     = _getSString,
+        .getInt         = _getInt,
+        .getLLong       = _getLLong,
+        .getDouble      = _getDouble,
+        .getColumnType  = _getColumnType,
         .getBlob        = _getBlob,
         .getTimestamp   = _getTimestamp,
-        .getDateTime    = _getDateTime
+        .getDateTime    = _getDateTime,
+        .fetchBatch     = _fetchBatch
         // get/setFetchSize is not applicable for SQLite
 };
 
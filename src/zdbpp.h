@@ -225,6 +225,10 @@ namespace zdb {
             return str ? std::optional<std::string_view>{str} : std::nullopt;
         }
         
+        constexpr std::optional<std::string_view> _to_optional(const char* str, int size) noexcept {
+            return str ? std::optional<std::string_view>{std::string_view(str, size)} : std::nullopt;
+        }
+        
         std::function<void(std::string_view)> g_abortHandler;
         
         void bridgeAbortHandler(const char* error) {
@@ -635,6 +639,19 @@ namespace zdb {
             except_wrapper(RETURN ResultSet_getColumnSize(t_, columnIndex));
         }
         
+        /**
+         * @brief Gets the designated column's SQL type.
+         *
+         * With SQLite the type is the storage class of the value in the current row.
+         *
+         * @param columnIndex The first column is 1, the second is 2, ...
+         * @return The column type or ResultSet_Unknown if the database does not report it.
+         * @throws sql_exception If columnIndex is outside the valid range.
+         */
+        [[nodiscard]] ResultSet_ColumnType columnType(int columnIndex) {
+            except_wrapper(RETURN ResultSet_getColumnType(t_, columnIndex));
+        }
+        
         /**
          * @brief Sets the number of rows to fetch from the database.
          *
@@ -673,6 +690,17 @@ namespace zdb {
          * @throws sql_exception If a database access error occurs.
          */
         bool next() { except_wrapper(RETURN ResultSet_next(t_)); }
+
+        /**
+         * @brief Moves to the next result of a query that returned several results.
+         *
+         * Results without rows are skipped. On success the cursor is positioned
+         * before the first row of the new result.
+         *
+         * @return true if advanced to the next result; false if there are no more results.
+         * @throws sql_exception If a database access error occurs.
+         */
+        bool nextResult() { except_wrapper(RETURN ResultSet_nextResult(t_)); }
         
         /// @}
         /// @name Columns
@@ -703,7 +731,10 @@ namespace zdb {
          * @throws sql_exception If a database access error occurs or columnIndex is invalid.
          */
         [[nodiscard]] std::optional<std::string_view> getString(int columnIndex) {
-            except_wrapper(RETURN _to_optional(ResultSet_getString(t_, columnIndex)));
+            int size = 0;
+            const char *s = nullptr;
+            except_wrapper(s = ResultSet_getSString(t_, columnIndex, &size));
+            return _to_optional(s, size);
         }
         
         /**
@@ -717,7 +748,10 @@ namespace zdb {
          * @throws sql_exception If a database access error occurs or columnName does not exist.
          */
         [[nodiscard]] std::optional<std::string_view> getString(const std::string& columnName) {
-            except_wrapper(RETURN _to_optional(ResultSet_getStringByName(t_, columnName.c_str())));
+            int size = 0;
+            const char *s = nullptr;
+            except_wrapper(s = ResultSet_getSStringByName(t_, columnName.c_str(), &size));
+            return _to_optional(s, size);
         }
         
         /**
@@ -820,6 +854,21 @@ namespace zdb {
             return std::span<const std::byte>(static_cast<const std::byte*>(blob), size);
         }
 
+        /**
+         * @brief Reads the next piece of the designated column's blob value.
+         *
+         * Each call continues where the previous call on the same column stopped.
+         * Use this to stream large values instead of getting them with getBlob().
+         *
+         * @param columnIndex The first column is 1, the second is 2, ...
+         * @param buffer The buffer to read into
+         * @return The number of bytes read into buffer, 0 when the whole value has been read.
+         * @throws sql_exception If a database access error occurs or columnIndex is invalid.
+         */
+        int readBlob(int columnIndex, std::span<std::byte> buffer) {
+            except_wrapper(RETURN ResultSet_readBlob(t_, columnIndex, buffer.data(), static_cast<int>(buffer.size())));
+        }
+
         /// @}
         /// @name Date and Time
         /// @{
@@ -947,6 +996,49 @@ namespace zdb {
         }
 
         /// @}
+        /// @name Batches
+        /// @{
+
+        /**
+         * @brief Fetches the next rows into contiguous column buffers.
+         *
+         * Use batchColumn() to access the values of a column.
+         *
+         * @param rows The maximum number of rows to fetch (1..INT_MAX).
+         * @return The number of rows fetched. 0 if there are no more rows.
+         * @throws sql_exception If a database access error occurs.
+         * @see ResultSet_fetchBatch
+         */
+        int fetchBatch(int rows) {
+            except_wrapper(RETURN ResultSet_fetchBatch(t_, rows));
+        }
+
+        /**
+         * @brief Gets a column of the batch fetched by fetchBatch().
+         *
+         * @param columnIndex The first column is 1, the second is 2, ...
+         * @return The column, valid until the next batch is fetched.
+         * @throws sql_exception If columnIndex is outside the valid range or no batch was fetched.
+         */
+        [[nodiscard]] const ResultSet_Column& batchColumn(int columnIndex) {
+            except_wrapper(RETURN *ResultSet_getBatchColumn(t_, columnIndex));
+        }
+
+        /**
+         * @brief Exports the batch fetched by fetchBatch() through the Arrow C Data Interface.
+         *
+         * The buffers are moved to `array`. The caller must call the release
+         * callback of both `schema` and `array`.
+         *
+         * @param schema Set to the schema of the batch.
+         * @param array Set to the data of the batch.
+         * @throws sql_exception If no batch was fetched or it was already exported.
+         */
+        void exportBatch(ArrowSchema& schema, ArrowArray& array) {
+            except_wrapper(ResultSet_exportBatch(t_, &schema, &array));
+        }
+
+        /// @}
 
     protected:
         friend class PreparedStatement;
@@ -1163,6 +1255,31 @@ namespace zdb {
             bindValuesHelper(1, std::forward<Args>(args)...);
         }
         
+        /**
+         * @brief Binds a blob value read from a callback when the statement is executed.
+         *
+         * @param parameterIndex The first parameter is 1, the second is 2,..
+         * @param source The callback producing the value in pieces
+         * @param context Context pointer given to source
+         * @throws sql_exception If a database error occurs or streaming is not supported
+         * @see PreparedStatement_setBlobStream()
+         */
+        void bindStream(int parameterIndex, PreparedStatement_BlobSource source, void *context) {
+            except_wrapper(PreparedStatement_setBlobStream(t_, parameterIndex, source, context));
+        }
+        
+        /**
+         * @brief Binds a blob of size zero bytes, to be written later with Connection::writeBlob().
+         *
+         * @param parameterIndex The first parameter is 1, the second is 2,..
+         * @param size The size of the blob in bytes
+         * @throws sql_exception If a database error occurs or zero blobs are not supported
+         * @see PreparedStatement_setZeroBlob()
+         */
+        void bindZeroBlob(int parameterIndex, int size) {
+            except_wrapper(PreparedStatement_setZeroBlob(t_, parameterIndex, size));
+        }
+        
         /// @}
         /// @name Functions
         /// @{
@@ -1187,6 +1304,46 @@ namespace zdb {
         [[nodiscard]] long long rowsChanged() noexcept {
             return PreparedStatement_rowsChanged(t_);
         }
+
+        /**
+         * @brief Adds the current set of parameters to the batch of this statement.
+         *
+         * On Oracle the values are copied and sent in one array execute by
+         * executeBatch(). Other databases execute the statement immediately.
+         *
+         * @throws sql_exception If a database access error occurs
+         */
+        void addBatch() {
+            except_wrapper(PreparedStatement_addBatch(t_));
+            store_.clear();
+        }
+
+        /**
+         * @brief Executes the batch of parameter sets added with addBatch().
+         * @return The number of rows changed by the batch
+         * @throws sql_exception If the batch as a whole could not be executed
+         */
+        long long executeBatch() {
+            except_wrapper(RETURN PreparedStatement_executeBatch(t_));
+        }
+
+        /**
+         * @brief Gets the number of rows that failed in the last batch.
+         * @return The number of failed rows
+         */
+        [[nodiscard]] int getBatchErrors() noexcept {
+            return PreparedStatement_getBatchErrors(t_);
+        }
+
+        /**
+         * @brief Gets a row error from the last batch.
+         * @param index The error to get, 0 <= index < getBatchErrors()
+         * @param row Set to the row in the batch that failed, the first row is 1
+         * @return The error message or nullptr if index is out of range
+         */
+        const char *getBatchError(int index, int &row) noexcept {
+            return PreparedStatement_getBatchError(t_, index, &row);
+        }
         
         /// @}
         /// @name Properties
@@ -1621,6 +1778,35 @@ namespace zdb {
                            );
         }
         
+        /**
+         * @brief Reads part of a blob value stored in a table.
+         * @param table The table name
+         * @param column The blob column name
+         * @param rowId The row to read from
+         * @param offset Offset in bytes into the blob value
+         * @param buffer The buffer to read into
+         * @return The number of bytes read, 0 at the end of the value
+         * @throws sql_exception If a database error occurs or blob I/O is not supported
+         * @see Connection_readBlob()
+         */
+        int readBlob(const std::string& table, const std::string& column, long long rowId, int offset, std::span<std::byte> buffer) {
+            except_wrapper(RETURN Connection_readBlob(t_, table.c_str(), column.c_str(), rowId, offset, buffer.data(), static_cast<int>(buffer.size())));
+        }
+        
+        /**
+         * @brief Writes part of a blob value stored in a table.
+         * @param table The table name
+         * @param column The blob column name
+         * @param rowId The row to write to
+         * @param offset Offset in bytes into the blob value
+         * @param buffer The bytes to write
+         * @throws sql_exception If a database error occurs or blob I/O is not supported
+         * @see Connection_writeBlob()
+         */
+        void writeBlob(const std::string& table, const std::string& column, long long rowId, int offset, std::span<const std::byte> buffer) {
+            except_wrapper(Connection_writeBlob(t_, table.c_str(), column.c_str(), rowId, offset, buffer.data(), static_cast<int>(buffer.size())));
+        }
+        
         /**
          * @brief Gets the last SQL error message.
          * @return The last error message as a string view.
@@ -1945,6 +2131,31 @@ namespace zdb {
             ConnectionPool_setReaper(t_, sweepInterval);
         }
         
+        /**
+         * @brief Adds a native SQL function to all connections in the pool.
+         *
+         * Only SQLite supports native functions. Must be called before start().
+         *
+         * @param function The function to add, callbacks use the SQLite function API
+         * @throws sql_exception If the pool is already started
+         * @see ConnectionPool_addFunction()
+         */
+        void addFunction(const ConnectionPool_Function& function) {
+            except_wrapper(ConnectionPool_addFunction(t_, &function));
+        }
+        
+        /**
+         * @brief Sets a function to receive execution counters for each query.
+         *
+         * Only SQLite collects query profiles. Pass nullptr to stop.
+         *
+         * @param profiler Called with the profile of a query when its ResultSet is closed
+         * @see ConnectionPool_setProfiler()
+         */
+        void setProfiler(void (*profiler)(const ConnectionPool_Profile *profile)) noexcept {
+            ConnectionPool_setProfiler(t_, profiler);
+        }
+        
         /// @}
         
         /**
@@ -12,6 +12,10 @@
 #include "Vector.h"
 #include "AssertException.h"
 
+#ifdef HAVE_LIBSQLITE3
+#include <sqlite3.h>
+#endif
+
 
 /**
  * libzdb connection pool unity tests. 
@@ -35,6 +39,73 @@ static void TabortHandler(const char *error) {
         exit(1);
 }
 
+#ifdef HAVE_LIBSQLITE3
+static void isEven(sqlite3_context *context, int argc, sqlite3_value **argv) {
+        sqlite3_result_int(context, sqlite3_value_int(argv[0]) % 2 == 0);
+}
+
+static void sumStep(sqlite3_context *context, int argc, sqlite3_value **argv) {
+        long long *sum = sqlite3_aggregate_context(context, sizeof(long long));
+        if (sum)
+                *sum += sqlite3_value_int64(argv[0]);
+}
+
+static void sumInverse(sqlite3_context *context, int argc, sqlite3_value **argv) {
+        long long *sum = sqlite3_aggregate_context(context, sizeof(long long));
+        if (sum)
+                *sum -= sqlite3_value_int64(argv[0]);
+}
+
+static void sumValue(sqlite3_context *context) {
+        long long *sum = sqlite3_aggregate_context(context, sizeof(long long));
+        sqlite3_result_int64(context, sum ? *sum : 0);
+}
+
+static void sumFinal(sqlite3_context *context) {
+        long long *sum = sqlite3_aggregate_context(context, 0);
+        sqlite3_result_int64(context, sum ? *sum * *(int *)sqlite3_user_data(context) : 0);
+}
+#endif
+
+static ConnectionPool_Profile lastProfile;
+static void queryProfiler(const ConnectionPool_Profile *profile) {
+        lastProfile = *profile;
+        lastProfile.sql = NULL;
+        lastProfile.scans = NULL;
+        if (strstr(profile->sql, "zild_profile"))
+                lastProfile.sql = "zild_profile";
+}
+
+static long long lockWaitDone;
+static void *lockWaitThread(void *args) {
+        ConnectionPool_T pool = args;
+        Connection_T con = ConnectionPool_getConnection(pool);
+        assert(con);
+        // Waits for the write lock held by the main thread
+        Connection_execute(con, "insert into zild_lock values (2);");
+        lockWaitDone = Time_milli();
+        Connection_close(con);
+        return NULL;
+}
+
+static void *writeQueueThread(void *args) {
+        ConnectionPool_T pool = args;
+        Connection_T con = ConnectionPool_getConnection(pool);
+        assert(con);
+        PreparedStatement_T p = Connection_prepareStatement(con, "insert into zild_t (name) values(?);");
+        for (int i = 0; i < 100; i++) {
+                if (i % 2) {
+                        Connection_execute(con, "insert into zild_t (name) values('%d');", i);
+                } else {
+                        PreparedStatement_setInt(p, 1, i);
+                        PreparedStatement_execute(p);
+                        assert(PreparedStatement_rowsChanged(p) == 1);
+                }
+        }
+        Connection_close(con);
+        return NULL;
+}
+
 static void testPool(const char *testURL) {
         URL_T url;
         char *schema;
@@ -202,6 +273,16 @@ static void testPool(const char *testURL) {
                 PreparedStatement_setInt(pre, 2, i + 1);
                 PreparedStatement_execute(pre);
                 printf("\tResult: prepared statement successfully executed\n");
+                // 3. Batch update, rows are sent in one round trip where supported
+                PreparedStatement_T batch = Connection_prepareStatement(con, "update zild_t set percent=? where id=?");
+                for (i = 1; i <= 3; i++) {
+                        PreparedStatement_setDouble(batch, 1, i + 0.5);
+                        PreparedStatement_setInt(batch, 2, i);
+                        PreparedStatement_addBatch(batch);
+                }
+                assert(PreparedStatement_executeBatch(batch) == 3);
+                assert(PreparedStatement_getBatchErrors(batch) == 0);
+                printf("\tResult: batch successfully executed\n");
                 Connection_close(con);
         }
         printf("=> Test5: OK\n\n");     
@@ -249,6 +330,32 @@ static void testPool(const char *testURL) {
                         assert(imagesize == 8192);
                 }
                 
+                // Stream the large blob in pieces
+                rset = Connection_executeQuery(con, "select image from zild_t where id=12;");
+                while (ResultSet_next(rset)) {
+                        char piece[1000];
+                        int n, total = 0;
+                        while ((n = ResultSet_readBlob(rset, 1, piece, sizeof(piece))) > 0) {
+                                if (total == 0)
+                                        assert(*piece == 'S');
+                                total += n;
+                        }
+                        assert(total == 8192);
+                }
+                // Reads on two columns continue independently
+                rset = Connection_executeQuery(con, "select image, image from zild_t where id=12;");
+                while (ResultSet_next(rset)) {
+                        char a[1000], b[1000];
+                        int n, total = 0;
+                        while ((n = ResultSet_readBlob(rset, 1, a, sizeof(a))) > 0) {
+                                assert(ResultSet_readBlob(rset, 2, b, sizeof(b)) == n);
+                                assert(memcmp(a, b, n) == 0);
+                                total += n;
+                        }
+                        assert(total == 8192);
+                        assert(ResultSet_readBlob(rset, 2, b, sizeof(b)) == 0);
+                }
+                
                 printf("\tResult: check isnull..");
                 rset = Connection_executeQuery(con, "select id, image from zild_t where id in(1,5,2);");
                 while (ResultSet_next(rset)) {
@@ -297,6 +404,101 @@ static void testPool(const char *testURL) {
                 assert(i==12);
                 printf("success\n");
                 
+                printf("\tResult: check column names..");
+                pre = Connection_prepareStatement(con, "select image, percent, name, id from zild_t where id=?;");
+                assert(pre);
+                // The column name index is kept by the prepared statement between executions
+                for (i = 1; i <= 3; i++) {
+                        PreparedStatement_setInt(pre, 1, i);
+                        rset = PreparedStatement_executeQuery(pre);
+                        assert(ResultSet_next(rset));
+                        assert(ResultSet_getIntByName(rset, "id") == i);
+                        assert(Str_isEqual(ResultSet_getStringByName(rset, "name"), ResultSet_getString(rset, 3)));
+                        assert(ResultSet_getDoubleByName(rset, "percent") == ResultSet_getDouble(rset, 2));
+                        int size;
+                        const char *name = ResultSet_getSStringByName(rset, "name", &size);
+                        assert(name && size == strlen(name));
+                }
+                printf("success\n");
+                
+                printf("\tResult: check next result..");
+                rset = Connection_executeQuery(con, "select id from zild_t where id=1;");
+                assert(ResultSet_next(rset));
+                assert(! ResultSet_nextResult(rset));
+                // Postgres can run several queries in one round trip
+                if (Str_startsWith(testURL, "postgres")) {
+                        rset = Connection_executeQuery(con, "select id from zild_t where id=1; select name, percent from zild_t where id < 3 order by id;");
+                        assert(ResultSet_next(rset));
+                        assert(ResultSet_getInt(rset, 1) == 1);
+                        assert(! ResultSet_next(rset));
+                        assert(ResultSet_nextResult(rset));
+                        assert(2 == ResultSet_getColumnCount(rset));
+                        assert(ResultSet_next(rset));
+                        assert(Str_isEqual("Fry", ResultSet_getString(rset, 1)));
+                        for (i = 1; ResultSet_next(rset); i++);
+                        assert(i == 2);
+                        assert(! ResultSet_nextResult(rset));
+                        // Columns of the next result are found by their own names
+                        rset = Connection_executeQuery(con, "select id, name from zild_t where id=1; select name as n, id as i from zild_t where id=2;");
+                        assert(ResultSet_next(rset));
+                        assert(ResultSet_getIntByName(rset, "id") == 1);
+                        assert(ResultSet_nextResult(rset));
+                        assert(ResultSet_next(rset));
+                        assert(ResultSet_getIntByName(rset, "i") == 2);
+                        assert(Str_isEqual(ResultSet_getStringByName(rset, "n"), ResultSet_getString(rset, 1)));
+                }
+                printf("success\n");
+                
+                printf("\tResult: check materialize..");
+                // Without a memory limit and with a limit where the rows are moved to a file
+                for (int limit = 0; limit <= 1024; limit += 1024) {
+                        rset = Connection_executeQuery(con, "select id, name, percent, image from zild_t order by id;");
+                        ResultSet_setMemoryLimit(rset, limit);
+                        assert(ResultSet_getMemoryLimit(rset) == limit);
+                        assert(ResultSet_getRowCount(rset) == -1);
+                        assert(ResultSet_next(rset));
+                        // Rows already read are not copied
+                        ResultSet_T copy = ResultSet_materialize(rset);
+                        // The copy does not depend on the connection
+                        Connection_clear(con);
+                        assert(ResultSet_getRowCount(copy) == 11 && ResultSet_getColumnCount(copy) == 4);
+                        assert(Str_isEqual(ResultSet_getColumnName(copy, 2), "name"));
+                        for (i = 2; ResultSet_next(copy); i++) {
+                                assert(ResultSet_getIntByName(copy, "id") == i);
+                                assert(ResultSet_getDouble(copy, 3) > 0);
+                        }
+                        assert(i == 13 && ! ResultSet_next(copy));
+                        assert(ResultSet_seek(copy, 1));
+                        assert(Str_isEqual(ResultSet_getString(copy, 2), "Leela"));
+                        assert(ResultSet_seek(copy, 11));
+                        assert(ResultSet_getInt(copy, 1) == 12);
+                        const char *image = ResultSet_getBlob(copy, 4, &imagesize);
+                        assert(imagesize == 8192 && *image == 'S');
+                        assert(! ResultSet_seek(copy, 12));
+                        ResultSet_rewind(copy);
+                        assert(ResultSet_next(copy) && ResultSet_getInt(copy, 1) == 2);
+                        // A materialized ResultSet shares the rows with a new cursor
+                        ResultSet_T shared = ResultSet_materialize(copy);
+                        assert(ResultSet_getRowCount(shared) == 11);
+                        assert(ResultSet_next(shared) && ResultSet_getInt(shared, 1) == 2);
+                        assert(ResultSet_next(shared) && ResultSet_getInt(shared, 1) == 3);
+                        ResultSet_close(&copy);
+                        assert(! copy);
+                        assert(ResultSet_seek(shared, 5) && ResultSet_getInt(shared, 1) == 6);
+                        ResultSet_close(&shared);
+                }
+                TRY
+                {
+                        ResultSet_seek(Connection_executeQuery(con, "select id from zild_t;"), 1);
+                        assert(false);
+                }
+                CATCH(SQLException)
+                {
+                        // Seek is only supported by a materialized ResultSet
+                }
+                END_TRY;
+                printf("success\n");
+                
                 // Test prefetch unless database is SQLite or Postgres for which prefetch is n/a
                 if (Str_startsWith(testURL, "mysql") || Str_startsWith(testURL, "oracle")) {
                         printf("\tResult: check fetch-size..");
@@ -625,6 +827,16 @@ static void testPool(const char *testURL) {
                                 assert(strlen(image) == (size_t)((i+1)*512));
                                 assert(strlen(string) == 4095);
                         }
+                        // A BIGINT UNSIGNED above LLONG_MAX is text, also when materialized and in a batch
+                        r = Connection_executeQuery(con, "select cast(18446744073709551615 as unsigned);");
+                        assert(ResultSet_getColumnType(r, 1) == ResultSet_Text);
+                        ResultSet_T copy = ResultSet_materialize(r);
+                        assert(ResultSet_next(copy));
+                        assert(Str_isEqual(ResultSet_getString(copy, 1), "18446744073709551615"));
+                        ResultSet_close(&copy);
+                        r = Connection_executeQuery(con, "select cast(18446744073709551615 as unsigned);");
+                        assert(ResultSet_fetchBatch(r, 10) == 1);
+                        assert(ResultSet_getBatchColumn(r, 1)->type == ResultSet_Text);
                         Connection_execute(con, "drop table zild_t;");
                         Connection_close(con);
                         ConnectionPool_stop(pool);
@@ -716,6 +928,632 @@ static void testPool(const char *testURL) {
         }
         printf("=> Test10: OK\n\n");
 
+        if (Str_startsWith(testURL, "sqlite")) {
+                printf("=> Test11: SQLite write queue\n");
+                {
+                        char queueURL[BSIZE];
+                        snprintf(queueURL, sizeof(queueURL), "%s%swrite-queue=true", testURL, strchr(testURL, '?') ? "&" : "?");
+                        url = URL_new(queueURL);
+                        pool = ConnectionPool_new(url);
+                        ConnectionPool_setMaxConnections(pool, 8);
+                        ConnectionPool_start(pool);
+                        Connection_T con = ConnectionPool_getConnection(pool);
+                        Connection_execute(con, "create table zild_t(id INTEGER PRIMARY KEY, name VARCHAR(255));");
+                        Thread_T threads[4];
+                        for (int i = 0; i < 4; i++)
+                                Thread_create(threads[i], writeQueueThread, pool);
+                        // Not grouped with the queued writes, VACUUM cannot run in a transaction
+                        Connection_execute(con, "vacuum;");
+                        for (int i = 0; i < 4; i++)
+                                Thread_join(threads[i]);
+                        ResultSet_T r = Connection_executeQuery(con, "select count(*) from zild_t;");
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getInt(r, 1) == 400);
+                        // Transactions run on the writer connection
+                        Connection_beginTransaction(con);
+                        Connection_execute(con, "delete from zild_t where id > 100;");
+                        r = Connection_executeQuery(con, "select count(*) from zild_t;");
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getInt(r, 1) == 100);
+                        Connection_rollback(con);
+                        r = Connection_executeQuery(con, "select count(*) from zild_t;");
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getInt(r, 1) == 400);
+                        // A query prepared inside a transaction can be run after it
+                        Connection_beginTransaction(con);
+                        PreparedStatement_T p = Connection_prepareStatement(con, "select count(*) from zild_t where id > ?;");
+                        Connection_commit(con);
+                        PreparedStatement_setInt(p, 1, 100);
+                        r = PreparedStatement_executeQuery(p);
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getInt(r, 1) == 300);
+                        assert(! ResultSet_next(r));
+                        // Waits for the lease held by a transaction time out as a lock wait does
+                        Connection_T other = ConnectionPool_getConnection(pool);
+                        Connection_setQueryTimeout(other, 500);
+                        Connection_beginTransaction(con);
+                        Connection_execute(con, "insert into zild_t(name) values('lease');");
+                        for (int i = 0; i < 2; i++) {
+                                volatile bool locked = false;
+                                long long start = Time_milli();
+                                TRY
+                                {
+                                        if (i == 0)
+                                                Connection_execute(other, "insert into zild_t(name) values('queued');");
+                                        else
+                                                Connection_beginTransaction(other);
+                                }
+                                CATCH(SQLException)
+                                {
+                                        locked = strstr(Exception_frame.message, "locked") != NULL;
+                                }
+                                END_TRY;
+                                assert(locked);
+                                assert(Time_milli() - start < 5000);
+                        }
+                        Connection_rollback(con);
+                        Connection_execute(other, "insert into zild_t(name) values('queued');");
+                        assert(Connection_rowsChanged(other) == 1);
+                        Connection_close(other);
+                        Connection_execute(con, "drop table zild_t;");
+                        Connection_close(con);
+                        ConnectionPool_stop(pool);
+                        ConnectionPool_free(&pool);
+                        URL_free(&url);
+                }
+                printf("=> Test11: OK\n\n");
+                printf("=> Test12: SQLite query timeout\n");
+                {
+                        url = URL_new(testURL);
+                        pool = ConnectionPool_new(url);
+                        ConnectionPool_start(pool);
+                        Connection_T con = ConnectionPool_getConnection(pool);
+                        Connection_setQueryTimeout(con, 100);
+                        volatile bool timedOut = false;
+                        long long start = Time_milli();
+                        TRY
+                        {
+                                ResultSet_T r = Connection_executeQuery(con, "with recursive c(x) as (select 1 union all select x + 1 from c) select count(*) from c;");
+                                ResultSet_next(r);
+                        }
+                        CATCH(SQLException)
+                        {
+                                timedOut = Str_startsWith(Exception_frame.message, "Query timeout");
+                        }
+                        END_TRY;
+                        assert(timedOut);
+                        assert(Time_milli() - start < 5000);
+                        // The connection is still usable
+                        ResultSet_T r = Connection_executeQuery(con, "select 1;");
+                        assert(ResultSet_next(r));
+                        Connection_close(con);
+                        ConnectionPool_stop(pool);
+                        ConnectionPool_free(&pool);
+                        URL_free(&url);
+                }
+                printf("=> Test12: OK\n\n");
+                printf("=> Test13: SQLite maintenance\n");
+                {
+                        char maintenanceURL[BSIZE];
+                        snprintf(maintenanceURL, sizeof(maintenanceURL), "%s%sjournal_mode=wal&maintenance=1", testURL, strchr(testURL, '?') ? "&" : "?");
+                        url = URL_new(maintenanceURL);
+                        pool = ConnectionPool_new(url);
+                        ConnectionPool_start(pool);
+                        Connection_T con = ConnectionPool_getConnection(pool);
+                        Connection_execute(con, "create table zild_m(id INTEGER PRIMARY KEY, name VARCHAR(255));");
+                        for (int i = 0; i < 1500; i++)
+                                Connection_execute(con, "insert into zild_m(name) values('%d');", i);
+                        Connection_close(con);
+                        // The WAL is truncated by a checkpoint and the database optimized when the pool is idle
+                        ConnectionPool_Statistics statistics = {};
+                        for (int i = 0; i < 50 && (statistics.checkpoints < 2 || statistics.walFrames > 0 || statistics.optimizations == 0); i++) {
+                                Time_usleep(100000);
+                                ConnectionPool_getStatistics(pool, &statistics);
+                        }
+                        assert(statistics.checkpoints > 0);
+                        assert(statistics.walFrames == 0);
+                        assert(statistics.optimizations > 0);
+                        con = ConnectionPool_getConnection(pool);
+                        Connection_execute(con, "drop table zild_m;");
+                        Connection_close(con);
+                        ConnectionPool_stop(pool);
+                        ConnectionPool_free(&pool);
+                        URL_free(&url);
+                }
+                printf("=> Test13: OK\n\n");
+                printf("=> Test14: SQLite in-memory replica\n");
+                if (! strstr(testURL, ":memory:")) {
+                        url = URL_new(testURL);
+                        ConnectionPool_T filePool = ConnectionPool_new(url);
+                        ConnectionPool_start(filePool);
+                        Connection_T con = ConnectionPool_getConnection(filePool);
+                        Connection_execute(con, "create table zild_r(id INTEGER PRIMARY KEY, name VARCHAR(255));");
+                        Connection_execute(con, "insert into zild_r(name) values('a'), ('b');");
+                        char replicaURL[BSIZE];
+                        snprintf(replicaURL, sizeof(replicaURL), "%s%smemory-replica=true&replica-refresh=1", testURL, strchr(testURL, '?') ? "&" : "?");
+                        URL_T rurl = URL_new(replicaURL);
+                        pool = ConnectionPool_new(rurl);
+                        ConnectionPool_start(pool);
+                        Connection_T reader = ConnectionPool_getConnection(pool);
+                        ResultSet_T r = Connection_executeQuery(reader, "select count(*) from zild_r;");
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getInt(r, 1) == 2);
+                        // The replica is read-only, unless writes go to the file through a write queue
+                        if (! strstr(testURL, "write-queue")) {
+                                volatile bool readOnly = false;
+                                TRY
+                                        Connection_execute(reader, "insert into zild_r(name) values('c');");
+                                CATCH(SQLException)
+                                        readOnly = true;
+                                END_TRY;
+                                assert(readOnly);
+                        }
+                        Connection_close(reader);
+                        // Changes to the file are picked up by the refresh thread
+                        Connection_execute(con, "insert into zild_r(name) values('c');");
+                        ConnectionPool_Statistics statistics = {};
+                        for (int i = 0; i < 50 && statistics.refreshes < 2; i++) {
+                                Time_usleep(100000);
+                                ConnectionPool_getStatistics(pool, &statistics);
+                        }
+                        assert(statistics.refreshes >= 2);
+                        reader = ConnectionPool_getConnection(pool);
+                        r = Connection_executeQuery(reader, "select count(*) from zild_r;");
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getInt(r, 1) == 3);
+                        Connection_close(reader);
+                        ConnectionPool_stop(pool);
+                        ConnectionPool_free(&pool);
+                        URL_free(&rurl);
+                        Connection_execute(con, "drop table zild_r;");
+                        Connection_close(con);
+                        ConnectionPool_stop(filePool);
+                        ConnectionPool_free(&filePool);
+                        URL_free(&url);
+                }
+                printf("=> Test14: OK\n\n");
+                printf("=> Test15: SQLite shared in-memory database\n");
+                {
+                        url = URL_new("sqlite:///:memory:");
+                        pool = ConnectionPool_new(url);
+                        ConnectionPool_start(pool);
+                        Connection_T con = ConnectionPool_getConnection(pool);
+                        Connection_T con2 = ConnectionPool_getConnection(pool);
+                        Connection_execute(con, "create table zild_t(id INTEGER PRIMARY KEY, name VARCHAR(255));");
+                        Connection_execute(con, "insert into zild_t(name) values('a'), ('b');");
+                        Connection_close(con);
+                        // All connections in the pool see the same database
+                        ResultSet_T r = Connection_executeQuery(con2, "select count(*) from zild_t;");
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getInt(r, 1) == 2);
+                        Connection_close(con2);
+                        ConnectionPool_stop(pool);
+                        ConnectionPool_free(&pool);
+                        URL_free(&url);
+                }
+                printf("=> Test15: OK\n\n");
+                printf("=> Test16: SQLite incremental blob I/O\n");
+                {
+                        url = URL_new(testURL);
+                        pool = ConnectionPool_new(url);
+                        ConnectionPool_start(pool);
+                        Connection_T con = ConnectionPool_getConnection(pool);
+                        Connection_execute(con, "create table zild_b(id INTEGER PRIMARY KEY, data BLOB);");
+                        PreparedStatement_T p = Connection_prepareStatement(con, "insert into zild_b(data) values(?);");
+                        PreparedStatement_setZeroBlob(p, 1, 100000);
+                        PreparedStatement_execute(p);
+                        long long id = Connection_lastRowId(con);
+                        char buffer[4096];
+                        for (int offset = 0; offset < 100000; offset += sizeof(buffer)) {
+                                int n = 100000 - offset < (int)sizeof(buffer) ? 100000 - offset : (int)sizeof(buffer);
+                                memset(buffer, 'a' + (offset / (int)sizeof(buffer)) % 26, n);
+                                Connection_writeBlob(con, "zild_b", "data", id, offset, buffer, n);
+                        }
+                        // The blob cannot grow
+                        volatile bool tooLarge = false;
+                        TRY
+                                Connection_writeBlob(con, "zild_b", "data", id, 99999, buffer, 2);
+                        CATCH(SQLException)
+                                tooLarge = true;
+                        END_TRY;
+                        assert(tooLarge);
+                        int n, total = 0;
+                        while ((n = Connection_readBlob(con, "zild_b", "data", id, total, buffer, 3000)) > 0) {
+                                assert(buffer[0] == 'a' + (total / 4096) % 26);
+                                total += n;
+                        }
+                        assert(total == 100000);
+                        // Later errors are not reported with the error of the blob I/O
+                        volatile bool reported = false;
+                        TRY
+                                Connection_execute(con, "insert into zild_b(nonexisting) values(1);");
+                        CATCH(SQLException)
+                                reported = strstr(Exception_frame.message, "nonexisting") != NULL;
+                        END_TRY;
+                        assert(reported);
+                        Connection_execute(con, "drop table zild_b;");
+                        Connection_close(con);
+                        ConnectionPool_stop(pool);
+                        ConnectionPool_free(&pool);
+                        URL_free(&url);
+                }
+                printf("=> Test16: OK\n\n");
+#ifdef HAVE_LIBSQLITE3
+                printf("=> Test17: SQLite native functions\n");
+                {
+                        url = URL_new(testURL);
+                        pool = ConnectionPool_new(url);
+                        int factor = 1;
+                        ConnectionPool_addFunction(pool, &(ConnectionPool_Function){.name = "is_even", .arguments = 1, .flags = SQLITE_DETERMINISTIC, .function = isEven});
+                        ConnectionPool_addFunction(pool, &(ConnectionPool_Function){.name = "total_of", .arguments = 1, .context = &factor, .step = sumStep, .final = sumFinal});
+                        ConnectionPool_addFunction(pool, &(ConnectionPool_Function){.name = "window_total", .arguments = 1, .step = sumStep, .final = sumValue, .value = sumValue, .inverse = sumInverse});
+                        ConnectionPool_start(pool);
+                        Connection_T con = ConnectionPool_getConnection(pool);
+                        ResultSet_T r = Connection_executeQuery(con, "with n(x) as (select 1 union all select x + 1 from n where x < 10) select count(*), total_of(x) from n where is_even(x);");
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getInt(r, 1) == 5);
+                        assert(ResultSet_getInt(r, 2) == 30);
+                        r = Connection_executeQuery(con, "with n(x) as (select 1 union all select x + 1 from n where x < 4) select window_total(x) over (order by x rows between 1 preceding and current row) from n;");
+                        int expected[] = {1, 3, 5, 7};
+                        for (int i = 0; i < 4; i++) {
+                                assert(ResultSet_next(r));
+                                assert(ResultSet_getInt(r, 1) == expected[i]);
+                        }
+                        // Functions must be added before start
+                        volatile bool started = false;
+                        TRY
+                                ConnectionPool_addFunction(pool, &(ConnectionPool_Function){.name = "late", .arguments = 0, .function = isEven});
+                        CATCH(SQLException)
+                                started = true;
+                        END_TRY;
+                        assert(started);
+                        Connection_close(con);
+                        ConnectionPool_stop(pool);
+                        ConnectionPool_free(&pool);
+                        URL_free(&url);
+                }
+                printf("=> Test17: OK\n\n");
+#endif
+
+                printf("=> Test18: SQLite result cache\n");
+                {
+                        char cacheURL[BSIZE];
+                        snprintf(cacheURL, sizeof(cacheURL), "%s%sresult-cache=4", testURL, strchr(testURL, '?') ? "&" : "?");
+                        url = URL_new(cacheURL);
+                        pool = ConnectionPool_new(url);
+                        ConnectionPool_start(pool);
+                        Connection_T con = ConnectionPool_getConnection(pool);
+                        Connection_T other = ConnectionPool_getConnection(pool);
+                        Connection_execute(con, "drop table if exists zild_cache;");
+                        Connection_execute(con, "create table zild_cache (id integer primary key, name text, data blob);");
+                        Connection_execute(con, "insert into zild_cache (name, data) values ('a', x'0102'), (null, null);");
+                        for (int i = 0; i < 3; i++) {
+                                ResultSet_T r = Connection_executeQuery(con, "select count(*), max(name) from zild_cache;");
+                                assert(ResultSet_getColumnCount(r) == 2);
+                                assert(ResultSet_next(r));
+                                assert(ResultSet_getInt(r, 1) == 2);
+                                assert(Str_isEqual(ResultSet_getString(r, 2), "a"));
+                                assert(! ResultSet_next(r));
+                        }
+                        ResultSet_T r = Connection_executeQuery(con, "select name, data from zild_cache order by id;");
+                        assert(ResultSet_next(r));
+                        int size;
+                        const void *data = ResultSet_getBlob(r, 2, &size);
+                        assert(size == 2 && memcmp(data, "\x01\x02", 2) == 0);
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_isnull(r, 1) && ResultSet_isnull(r, 2));
+                        // A write from another connection invalidates the cached result
+                        Connection_execute(other, "insert into zild_cache (name) values ('b');");
+                        r = Connection_executeQuery(con, "select count(*), max(name) from zild_cache;");
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getInt(r, 1) == 3);
+                        assert(Str_isEqual(ResultSet_getString(r, 2), "b"));
+                        // A batch from a cached result is filled through the getters
+                        for (int i = 0; i < 2; i++) {
+                                r = Connection_executeQuery(con, "select id, name, data from zild_cache order by id;");
+                                assert(ResultSet_fetchBatch(r, 10) == 3);
+                                const ResultSet_Column *id = ResultSet_getBatchColumn(r, 1);
+                                assert(id->type == ResultSet_Integer && ((int64_t*)id->values)[2] == 3);
+                                assert(ResultSet_getBatchColumn(r, 2)->type == ResultSet_Text && ResultSet_getBatchColumn(r, 2)->nullCount == 1);
+                                assert(ResultSet_getBatchColumn(r, 3)->type == ResultSet_Blob && ResultSet_getBatchColumn(r, 3)->nullCount == 2);
+                                assert(ResultSet_fetchBatch(r, 10) == 0);
+                        }
+                        // A query calling a function which is not deterministic is not cached
+                        r = Connection_executeQuery(con, "select random();");
+                        assert(ResultSet_next(r));
+                        long long random = ResultSet_getLLong(r, 1);
+                        r = Connection_executeQuery(con, "select random();");
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getLLong(r, 1) != random);
+                        // A query timeout is reported by executeQuery and the query is not run again
+                        Connection_setQueryTimeout(con, 200);
+                        volatile bool executed = false, timedOut = false;
+                        TRY
+                        {
+                                r = Connection_executeQuery(con, "with recursive c(x) as (select 1 union all select x + 1 from c) select count(*) from c;");
+                                executed = true;
+                                ResultSet_next(r);
+                        }
+                        CATCH(SQLException)
+                        {
+                                timedOut = Str_startsWith(Exception_frame.message, "Query timeout");
+                        }
+                        END_TRY;
+                        assert(timedOut && ! executed);
+                        Connection_setQueryTimeout(con, 0);
+                        // A result too large to cache is read on from the statement
+                        r = Connection_executeQuery(con, "with recursive c(x) as (select 1 union all select x + 1 from c where x < 20000) select x, hex(zeroblob(64)) from c;");
+                        int rows = 0;
+                        while (ResultSet_next(r)) {
+                                assert(ResultSet_getInt(r, 1) == ++rows);
+                                assert(ResultSet_getColumnSize(r, 2) == 128);
+                        }
+                        assert(rows == 20000);
+                        // A transaction sees its own writes and not rolled back writes after it
+                        for (int i = 0; i < 2; i++) {
+                                r = Connection_executeQuery(con, "select count(*) from zild_cache;");
+                                assert(ResultSet_next(r));
+                                assert(ResultSet_getInt(r, 1) == 3);
+                        }
+                        Connection_beginTransaction(con);
+                        Connection_execute(con, "insert into zild_cache (name) values ('c');");
+                        for (int i = 0; i < 2; i++) {
+                                r = Connection_executeQuery(con, "select count(*) from zild_cache;");
+                                assert(ResultSet_next(r));
+                                assert(ResultSet_getInt(r, 1) == 4);
+                        }
+                        Connection_rollback(con);
+                        r = Connection_executeQuery(con, "select count(*) from zild_cache;");
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getInt(r, 1) == 3);
+                        Connection_execute(con, "drop table zild_cache;");
+                        Connection_close(other);
+                        Connection_close(con);
+                        ConnectionPool_stop(pool);
+                        ConnectionPool_free(&pool);
+                        URL_free(&url);
+                }
+                printf("=> Test18: OK\n\n");
+
+                printf("=> Test19: SQLite query profile\n");
+                for (int cache = 0; cache < 2; cache++) {
+                        char cacheURL[BSIZE];
+                        snprintf(cacheURL, sizeof(cacheURL), "%s%sresult-cache=10", testURL, strchr(testURL, '?') ? "&" : "?");
+                        url = URL_new(cache ? cacheURL : testURL);
+                        pool = ConnectionPool_new(url);
+                        ConnectionPool_setProfiler(pool, queryProfiler);
+                        ConnectionPool_start(pool);
+                        Connection_T con = ConnectionPool_getConnection(pool);
+                        Connection_execute(con, "drop table if exists zild_profile;");
+                        Connection_execute(con, "create table zild_profile (id integer primary key, name text);");
+                        Connection_execute(con, "with n(x) as (select 1 union all select x + 1 from n where x < 100) insert into zild_profile (name) select x from n;");
+                        ResultSet_T r = Connection_executeQuery(con, "select id from zild_profile where name = '50';");
+                        assert(ResultSet_next(r));
+                        assert(! ResultSet_next(r));
+                        // The profile is reported when the ResultSet is closed
+                        assert(! lastProfile.sql);
+                        Connection_clear(con);
+                        assert(lastProfile.sql);
+                        assert(lastProfile.rows == 1);
+                        assert(lastProfile.fullscanSteps >= 99);
+                        assert(lastProfile.vmSteps > 0);
+                        assert(! lastProfile.cached);
+                        long long fullscanSteps = lastProfile.fullscanSteps;
+                        if (cache) {
+                                // A result read from the cache is reported without executing the query
+                                r = Connection_executeQuery(con, "select id from zild_profile where name = '50';");
+                                assert(ResultSet_next(r));
+                                Connection_clear(con);
+                                assert(lastProfile.cached);
+                                assert(lastProfile.rows == 1);
+                                assert(lastProfile.fullscanSteps == 0);
+                        }
+                        // Counters are per execution of a prepared statement
+                        PreparedStatement_T p = Connection_prepareStatement(con, "select id from zild_profile where name = ?;");
+                        for (int i = 1; i <= 3; i++) {
+                                PreparedStatement_setString(p, 1, "50");
+                                r = PreparedStatement_executeQuery(p);
+                                assert(ResultSet_next(r));
+                                assert(! ResultSet_next(r));
+                        }
+                        Connection_clear(con);
+                        assert(lastProfile.rows == 1);
+                        assert(lastProfile.fullscanSteps == fullscanSteps);
+                        assert(! lastProfile.cached);
+                        Connection_execute(con, "drop table zild_profile;");
+                        lastProfile.sql = NULL;
+                        Connection_close(con);
+                        ConnectionPool_stop(pool);
+                        ConnectionPool_free(&pool);
+                        URL_free(&url);
+                }
+                printf("=> Test19: OK\n\n");
+
+                printf("=> Test20: SQLite lock waits\n");
+                if (! strstr(testURL, ":memory:") && ! strstr(testURL, "write-queue")) {
+                        url = URL_new(testURL);
+                        pool = ConnectionPool_new(url);
+                        ConnectionPool_start(pool);
+                        Connection_T con = ConnectionPool_getConnection(pool);
+                        Connection_execute(con, "drop table if exists zild_lock;");
+                        Connection_execute(con, "create table zild_lock (id integer primary key);");
+                        Connection_beginTransactionType(con, TRANSACTION_IMMEDIATE);
+                        Connection_execute(con, "insert into zild_lock values (1);");
+                        Thread_T thread;
+                        Thread_create(thread, lockWaitThread, pool);
+                        Time_usleep(300000);
+                        long long committed = Time_milli();
+                        Connection_commit(con);
+                        Thread_join(thread);
+                        /* The waiting connection is woken when the lock is released. It
+                         would otherwise try again at the end of a slice from 255 to 511 ms */
+                        assert(lockWaitDone - committed < 50);
+                        ConnectionPool_Statistics statistics;
+                        ConnectionPool_getStatistics(pool, &statistics);
+                        assert(statistics.lockWaits == 1);
+                        assert(statistics.lockWaitTime >= 250);
+                        assert(statistics.lockTimeouts == 0);
+                        // A lock wait is bounded by the query timeout
+                        Connection_beginTransactionType(con, TRANSACTION_IMMEDIATE);
+                        Connection_T other = ConnectionPool_getConnection(pool);
+                        Connection_setQueryTimeout(other, 100);
+                        bool timedOut = false;
+                        TRY
+                                Connection_execute(other, "insert into zild_lock values (3);");
+                        CATCH(SQLException)
+                                timedOut = true;
+                        END_TRY;
+                        assert(timedOut);
+                        Connection_rollback(con);
+                        ConnectionPool_getStatistics(pool, &statistics);
+                        assert(statistics.lockTimeouts == 1);
+                        Connection_execute(con, "drop table zild_lock;");
+                        Connection_close(other);
+                        Connection_close(con);
+                        ConnectionPool_stop(pool);
+                        ConnectionPool_free(&pool);
+                        URL_free(&url);
+                }
+                printf("=> Test20: OK\n\n");
+
+                printf("=> Test21: SQLite native column values\n");
+                {
+                        url = URL_new(testURL);
+                        pool = ConnectionPool_new(url);
+                        ConnectionPool_start(pool);
+                        Connection_T con = ConnectionPool_getConnection(pool);
+                        ResultSet_T r = Connection_executeQuery(con, "select 9007199254740993, 2.5, '42', 'abc', x'00ff', null;");
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getColumnType(r, 1) == ResultSet_Integer);
+                        assert(ResultSet_getColumnType(r, 2) == ResultSet_Real);
+                        assert(ResultSet_getColumnType(r, 3) == ResultSet_Text);
+                        assert(ResultSet_getColumnType(r, 5) == ResultSet_Blob);
+                        assert(ResultSet_getColumnType(r, 6) == ResultSet_Null);
+                        // Read natively, a double has no exact value for this integer
+                        assert(ResultSet_getLLong(r, 1) == 9007199254740993LL);
+                        assert(ResultSet_getDouble(r, 2) == 2.5);
+                        assert(ResultSet_getInt(r, 2) == 2);
+                        // Text is parsed
+                        assert(ResultSet_getInt(r, 3) == 42);
+                        assert(ResultSet_getLLong(r, 6) == 0);
+                        int size;
+                        assert(Str_isEqual(ResultSet_getSString(r, 3, &size), "42") && size == 2);
+                        assert(! ResultSet_getSString(r, 6, &size) && size == 0);
+                        bool thrown = false;
+                        TRY
+                                ResultSet_getInt(r, 4);
+                        CATCH(SQLException)
+                                thrown = true;
+                        END_TRY;
+                        assert(thrown);
+                        thrown = false;
+                        TRY
+                                ResultSet_getColumnType(r, 7);
+                        CATCH(SQLException)
+                                thrown = true;
+                        END_TRY;
+                        assert(thrown);
+                        Connection_close(con);
+                        ConnectionPool_stop(pool);
+                        ConnectionPool_free(&pool);
+                        URL_free(&url);
+                }
+                printf("=> Test21: OK\n\n");
+                printf("=> Test22: SQLite batch fetch and Arrow export\n");
+                {
+                        url = URL_new(testURL);
+                        pool = ConnectionPool_new(url);
+                        ConnectionPool_start(pool);
+                        Connection_T con = ConnectionPool_getConnection(pool);
+                        ResultSet_T r = Connection_executeQuery(con, "with recursive s(x) as (select 1 union all select x + 1 from s where x < 1000) "
+                                                                "select x, x * 0.5, 'r' || x, case when x %% 3 = 0 then null else x end as m, "
+                                                                "case when x <= 2 then x else 'v' || x end, null, case when x <= 300 then x end from s;");
+                        int n, total = 0;
+                        long long sum = 0;
+                        while ((n = ResultSet_fetchBatch(r, 300)) > 0) {
+                                const ResultSet_Column *x = ResultSet_getBatchColumn(r, 1);
+                                const ResultSet_Column *half = ResultSet_getBatchColumn(r, 2);
+                                const ResultSet_Column *text = ResultSet_getBatchColumn(r, 3);
+                                const ResultSet_Column *m = ResultSet_getBatchColumn(r, 4);
+                                const ResultSet_Column *mixed = ResultSet_getBatchColumn(r, 5);
+                                const ResultSet_Column *none = ResultSet_getBatchColumn(r, 6);
+                                const ResultSet_Column *first = ResultSet_getBatchColumn(r, 7);
+                                assert(n == (total < 900 ? 300 : 100));
+                                assert(x->type == ResultSet_Integer && x->length == n && x->nullCount == 0 && ! x->validity);
+                                assert(half->type == ResultSet_Real);
+                                assert(text->type == ResultSet_Text && text->offsets[0] == 0);
+                                assert(m->type == ResultSet_Integer && m->validity);
+                                assert(none->type == ResultSet_Null && none->nullCount == n && ! none->values);
+                                // The type of the first batch is kept when later batches only have NULL
+                                assert(first->type == ResultSet_Integer && first->nullCount == (total ? n : 0) && first->values);
+                                assert(mixed->type == ResultSet_Text);
+                                for (int i = 0; i < n; i++) {
+                                        long long v = ((int64_t*)x->values)[i];
+                                        assert(v == total + i + 1);
+                                        assert(((double*)half->values)[i] == v * 0.5);
+                                        char s[32];
+                                        int len = snprintf(s, sizeof(s), "r%lld", v);
+                                        assert(text->offsets[i + 1] - text->offsets[i] == len);
+                                        assert(memcmp(text->data + text->offsets[i], s, len) == 0);
+                                        assert(((m->validity[i >> 3] >> (i & 7)) & 1) == (v % 3 != 0));
+                                        sum += v;
+                                }
+                                if (total == 0) {
+                                        // Integers are converted when text follows in the same column
+                                        assert(mixed->type == ResultSet_Text);
+                                        assert(mixed->offsets[1] == 1 && mixed->data[0] == '1' && mixed->data[1] == '2');
+                                }
+                                total += n;
+                        }
+                        assert(total == 1000 && sum == 500500);
+                        bool thrown = false;
+                        TRY
+                                ResultSet_getBatchColumn(r, 8);
+                        CATCH(SQLException)
+                                thrown = true;
+                        END_TRY;
+                        assert(thrown);
+                        // Export, the buffers are moved to the Arrow array
+                        r = Connection_executeQuery(con, "select 1 as id, null as name, null as data union all select 2, 'b', x'00ff' union all select 3, null, null;");
+                        // Batches continue from the cursor
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_fetchBatch(r, 10) == 2);
+                        struct ArrowSchema schema;
+                        struct ArrowArray array;
+                        ResultSet_exportBatch(r, &schema, &array);
+                        assert(Str_isEqual(schema.format, "+s") && schema.n_children == 3);
+                        assert(Str_isEqual(schema.children[0]->format, "l") && Str_isEqual(schema.children[0]->name, "id"));
+                        assert(Str_isEqual(schema.children[1]->format, "u") && Str_isEqual(schema.children[1]->name, "name"));
+                        assert(Str_isEqual(schema.children[2]->format, "z"));
+                        assert(array.length == 2 && array.n_children == 3);
+                        assert(array.children[0]->n_buffers == 2 && ((int64_t*)array.children[0]->buffers[1])[0] == 2);
+                        assert(array.children[1]->null_count == 1 && array.children[2]->null_count == 1);
+                        assert(((int32_t*)array.children[2]->buffers[1])[1] == 2 && ((uint8_t*)array.children[2]->buffers[2])[1] == 0xff);
+                        // A moved child is released on its own
+                        struct ArrowArray child = *array.children[0];
+                        array.children[0]->release = NULL;
+                        array.release(&array);
+                        assert(! array.release);
+                        assert(((int64_t*)child.buffers[1])[0] == 2);
+                        child.release(&child);
+                        schema.release(&schema);
+                        assert(! schema.release);
+                        thrown = false;
+                        TRY
+                                ResultSet_exportBatch(r, &schema, &array);
+                        CATCH(SQLException)
+                                thrown = true;
+                        END_TRY;
+                        assert(thrown);
+                        assert(ResultSet_fetchBatch(r, 10) == 0);
+                        Connection_close(con);
+                        ConnectionPool_stop(pool);
+                        ConnectionPool_free(&pool);
+                        URL_free(&url);
+                }
+                printf("=> Test22: OK\n\n");
+        }
+
 
         printf("============> Connection Pool Tests: OK\n\n");
 }